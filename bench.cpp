@@ -0,0 +1,348 @@
+/**
+ * \file bench.cpp
+ * Frame-time benchmark harness. Drives \c Renderer::render() on Dawn's Null
+ * backend with a synthetic clock and reports CPU frame time percentiles,
+ * allocations per frame and WebGPU calls per frame.
+ *
+ * Usage: \c DawnWasmTest_bench [frames [warm-up frames [instances]]]
+ *
+ * Extra instances of the triangle are scattered over three times the view's
+ * width and height (so most are culled). With \c RENDERER_GPU_CULLING set in
+ * the environment they are culled in a compute pass instead of on the CPU,
+ * then the same instances are culled on an adapter that runs shaders (Vulkan,
+ * including SwiftShader, with no swap chain) and compared with the CPU's
+ * result, since the Null backend skips compute passes.
+ */
+#include "RendererWindow.h"
+#include "Renderer.h"
+#include "TracingPlatform.h"
+#include "WireTransport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <dawn/dawn_proc.h>
+#include <dawn_native/DawnNative.h>
+
+#define BENCH_FRAMES 1000
+#define BENCH_WARMUP 100
+#define BENCH_TIMESTEP (1.0 / 60.0)
+#define BENCH_SPREAD 3.0f
+
+// =================== "Counters" =====================
+/**
+ * Heap allocations made through \c new and ImGui's allocator.
+ */
+static std::atomic<size_t> allocCount(0);
+
+/**
+ * Calls made through the WebGPU proc table.
+ */
+static std::atomic<size_t> wgpuCallCount(0);
+
+void* operator new(size_t size)
+{
+	allocCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+static void* countedImGuiAlloc(size_t size, void*)
+{
+	allocCount.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size);
+}
+
+static void countedImGuiFree(void* ptr, void*)
+{
+	free(ptr);
+}
+
+/**
+ * Wraps a single \c DawnProcTable entry, counting each call before forwarding
+ * it to the real implementation.
+ */
+template <auto Member, typename Proc = std::remove_reference_t<decltype(DawnProcTable{}.*Member)>>
+struct CountedProc;
+
+template <auto Member, typename Ret, typename... Args>
+struct CountedProc<Member, Ret (*)(Args...)>
+{
+	static inline Ret (*real)(Args...) = NULLPTR;
+
+	static Ret call(Args... args) {
+		wgpuCallCount.fetch_add(1, std::memory_order_relaxed);
+		return real(args...);
+	}
+
+	static void install(DawnProcTable& procs) {
+		real = procs.*Member;
+		procs.*Member = &call;
+	}
+};
+
+/**
+ * Every proc apart from the instance creation entry points.
+ */
+#define BENCH_COUNTED_PROCS(X) \
+	X(bindGroupReference) X(bindGroupRelease) X(bindGroupLayoutReference) X(bindGroupLayoutRelease) \
+	X(bufferDestroy) X(bufferGetConstMappedRange) X(bufferGetMappedRange) X(bufferMapAsync) \
+	X(bufferUnmap) X(bufferReference) X(bufferRelease) X(commandBufferReference) X(commandBufferRelease) \
+	X(commandEncoderBeginComputePass) X(commandEncoderBeginRenderPass) \
+	X(commandEncoderCopyBufferToBuffer) X(commandEncoderCopyBufferToTexture) \
+	X(commandEncoderCopyTextureToBuffer) X(commandEncoderCopyTextureToTexture) X(commandEncoderFinish) \
+	X(commandEncoderInjectValidationError) X(commandEncoderInsertDebugMarker) \
+	X(commandEncoderPopDebugGroup) X(commandEncoderPushDebugGroup) X(commandEncoderResolveQuerySet) \
+	X(commandEncoderWriteTimestamp) X(commandEncoderReference) X(commandEncoderRelease) \
+	X(computePassEncoderDispatch) X(computePassEncoderDispatchIndirect) X(computePassEncoderEndPass) \
+	X(computePassEncoderInsertDebugMarker) X(computePassEncoderPopDebugGroup) \
+	X(computePassEncoderPushDebugGroup) X(computePassEncoderSetBindGroup) \
+	X(computePassEncoderSetPipeline) X(computePassEncoderWriteTimestamp) X(computePassEncoderReference) \
+	X(computePassEncoderRelease) X(computePipelineGetBindGroupLayout) X(computePipelineReference) \
+	X(computePipelineRelease) X(deviceCreateBindGroup) X(deviceCreateBindGroupLayout) \
+	X(deviceCreateBuffer) X(deviceCreateCommandEncoder) X(deviceCreateComputePipeline) \
+	X(deviceCreateErrorBuffer) X(deviceCreatePipelineLayout) X(deviceCreateQuerySet) \
+	X(deviceCreateReadyComputePipeline) X(deviceCreateReadyRenderPipeline) \
+	X(deviceCreateRenderBundleEncoder) X(deviceCreateRenderPipeline) X(deviceCreateSampler) \
+	X(deviceCreateShaderModule) X(deviceCreateSwapChain) X(deviceCreateTexture) X(deviceGetDefaultQueue) \
+	X(deviceInjectError) X(deviceLoseForTesting) X(devicePopErrorScope) X(devicePushErrorScope) \
+	X(deviceSetDeviceLostCallback) X(deviceSetUncapturedErrorCallback) X(deviceTick) X(deviceReference) \
+	X(deviceRelease) X(fenceGetCompletedValue) X(fenceOnCompletion) X(fenceReference) X(fenceRelease) \
+	X(instanceCreateSurface) X(instanceReference) X(instanceRelease) X(pipelineLayoutReference) \
+	X(pipelineLayoutRelease) X(querySetDestroy) X(querySetReference) X(querySetRelease) \
+	X(queueCopyTextureForBrowser) X(queueCreateFence) X(queueSignal) X(queueSubmit) X(queueWriteBuffer) \
+	X(queueWriteTexture) X(queueReference) X(queueRelease) X(renderBundleReference) \
+	X(renderBundleRelease) X(renderBundleEncoderDraw) X(renderBundleEncoderDrawIndexed) \
+	X(renderBundleEncoderDrawIndexedIndirect) X(renderBundleEncoderDrawIndirect) \
+	X(renderBundleEncoderFinish) X(renderBundleEncoderInsertDebugMarker) \
+	X(renderBundleEncoderPopDebugGroup) X(renderBundleEncoderPushDebugGroup) \
+	X(renderBundleEncoderSetBindGroup) X(renderBundleEncoderSetIndexBuffer) \
+	X(renderBundleEncoderSetIndexBufferWithFormat) X(renderBundleEncoderSetPipeline) \
+	X(renderBundleEncoderSetVertexBuffer) X(renderBundleEncoderReference) X(renderBundleEncoderRelease) \
+	X(renderPassEncoderBeginOcclusionQuery) X(renderPassEncoderDraw) X(renderPassEncoderDrawIndexed) \
+	X(renderPassEncoderDrawIndexedIndirect) X(renderPassEncoderDrawIndirect) \
+	X(renderPassEncoderEndOcclusionQuery) X(renderPassEncoderEndPass) X(renderPassEncoderExecuteBundles) \
+	X(renderPassEncoderInsertDebugMarker) X(renderPassEncoderPopDebugGroup) \
+	X(renderPassEncoderPushDebugGroup) X(renderPassEncoderSetBindGroup) \
+	X(renderPassEncoderSetBlendColor) X(renderPassEncoderSetIndexBuffer) \
+	X(renderPassEncoderSetIndexBufferWithFormat) X(renderPassEncoderSetPipeline) \
+	X(renderPassEncoderSetScissorRect) X(renderPassEncoderSetStencilReference) \
+	X(renderPassEncoderSetVertexBuffer) X(renderPassEncoderSetViewport) \
+	X(renderPassEncoderWriteTimestamp) X(renderPassEncoderReference) X(renderPassEncoderRelease) \
+	X(renderPipelineGetBindGroupLayout) X(renderPipelineReference) X(renderPipelineRelease) \
+	X(samplerReference) X(samplerRelease) X(shaderModuleReference) X(shaderModuleRelease) \
+	X(surfaceReference) X(surfaceRelease) X(swapChainConfigure) X(swapChainGetCurrentTextureView) \
+	X(swapChainPresent) X(swapChainReference) X(swapChainRelease) X(textureCreateView) X(textureDestroy) \
+	X(textureReference) X(textureRelease) X(textureViewReference) X(textureViewRelease)
+
+/**
+ * Replaces the global WebGPU procs with counting wrappers around Dawn's (or
+ * around the wire client's, when running with \c RENDERER_WIRE).
+ */
+static void installCountingProcs()
+{
+	static DawnProcTable procs;
+	if (WireTransport* wire = WireTransport::getActive()) {
+		procs = wire->getProcs();
+	} else {
+		procs = dawn_native::GetProcs();
+	}
+#define X(name) CountedProc<&DawnProcTable::name>::install(procs);
+	BENCH_COUNTED_PROCS(X)
+#undef X
+	dawnProcSetProcs(&procs);
+}
+// =================== "Counters" END =====================
+
+/**
+ * Culls \a instances of the triangle in a compute pass on the first adapter
+ * that runs shaders, comparing the result with the CPU's (see
+ * \c Renderer::checkGpuCulling()). The native procs are installed for this,
+ * so it runs after the benchmark's renderer (and any wire transport) is done.
+ *
+ * \param[in] instances the benchmark's extra instances
+ * \return number of chunks that differ, or \c -1 if there's no such adapter (or the pass didn't run)
+ */
+static int checkGpuCulling(const std::vector<Transform>& instances)
+{
+	static dawn_native::Instance instance;
+	instance.DiscoverDefaultAdapters();
+	dawn_native::Adapter adapter;
+	wgpu::AdapterProperties properties;
+	std::vector<dawn_native::Adapter> adapters = instance.GetAdapters();
+	for (auto it = adapters.begin(); it != adapters.end() && !adapter; ++it) {
+		it->GetProperties(&properties);
+		if (static_cast<WGPUBackendType>(properties.backendType) != WGPUBackendType_Null) {
+			adapter = *it;
+		}
+	}
+	if (!adapter) {
+		return -1;
+	}
+	adapter.GetProperties(&properties);
+	printf("gpu culling check on: %s\n", properties.name);
+
+	static DawnProcTable procs;
+	procs = dawn_native::GetProcs();
+	dawnProcSetProcs(&procs);
+	WGPUDevice device = adapter.CreateDevice();
+	if (device == NULLPTR) {
+		return -1;
+	}
+	procs.deviceSetUncapturedErrorCallback(device, RendererWindow::print_wgpu_error, NULLPTR);
+
+	Renderer* renderer = new Renderer();
+	renderer->setDevice(device);
+	renderer->setQueue(wgpuDeviceGetDefaultQueue(device));
+	renderer->createPipelineAndBuffers();
+	renderer->resize(WINDOW_W, WINDOW_H);
+	if (!instances.empty()) {
+		renderer->addInstances(0, std::span<const Transform>(instances));
+	}
+	renderer->setGpuCulling(true);
+	int mismatches = renderer->checkGpuCulling();
+	delete renderer;
+	return mismatches;
+}
+
+/**
+ * Nearest-rank percentile of already sorted samples.
+ */
+static double percentile(const std::vector<double>& sorted, double pct)
+{
+	size_t rank = (size_t) (pct / 100.0 * sorted.size() + 0.5);
+	rank = std::min(std::max(rank, (size_t) 1), sorted.size());
+	return sorted[rank - 1];
+}
+
+/**
+ * Benchmark entry point.
+ */
+int main(int argc, char* argv[]) {
+	unsigned frames = (argc > 1) ? (unsigned) strtoul(argv[1], NULLPTR, 10) : BENCH_FRAMES;
+	unsigned warmup = (argc > 2) ? (unsigned) strtoul(argv[2], NULLPTR, 10) : BENCH_WARMUP;
+	unsigned instances = (argc > 3) ? (unsigned) strtoul(argv[3], NULLPTR, 10) : 0;
+	if (frames == 0) {
+		return 1;
+	}
+
+	RendererWindow* window = new RendererWindow();
+	auto wHnd = window->create();
+	auto device = window->createDevice(wHnd);
+	if (device == NULLPTR) {
+		puts("Failed to create a Null backend device");
+		return 1;
+	}
+	auto swapChain = window->createSwapChain(device);
+	installCountingProcs();
+	ImGui::SetAllocatorFunctions(countedImGuiAlloc, countedImGuiFree);
+
+	Renderer* renderer = new Renderer();
+	renderer->setDevice(device);
+	renderer->setQueue(wgpuDeviceGetDefaultQueue(device));
+	renderer->setSwapChain(swapChain);
+	renderer->setupImGui(window->getGLFWWindow());
+	renderer->createPipelineAndBuffers();
+	renderer->resize(WINDOW_W, WINDOW_H);
+
+	// scattered instances (a fixed seed keeping runs comparable)
+	std::vector<Transform> scattered(instances);
+	if (instances > 0) {
+		uint32_t seed = 1;
+		for (unsigned n = 0; n < instances; n++) {
+			Transform& t = scattered[n];
+			memset(t.matrix, 0, sizeof(t.matrix));
+			for (int c = 0; c < 2; c++) {
+				seed = seed * 1664525u + 1013904223u;
+				t.matrix[12 + c] = ((seed >> 8) / 16777216.0f - 0.5f) * 2.0f * BENCH_SPREAD;
+			}
+			t.matrix[0] = t.matrix[5] = 0.1f;
+			t.matrix[10] = t.matrix[15] = 1.0f;
+			t.color[0] = t.color[1] = t.color[2] = t.color[3] = 1.0f;
+		}
+		renderer->addInstances(0, std::span<const Transform>(scattered));
+	}
+	bool gpuCulling = getenv("RENDERER_GPU_CULLING") != NULLPTR;
+	renderer->setGpuCulling(gpuCulling);
+
+	std::vector<double> frameMs;
+	std::vector<size_t> frameAllocs;
+	std::vector<size_t> frameCalls;
+	frameMs.reserve(frames);
+	frameAllocs.reserve(frames);
+	frameCalls.reserve(frames);
+
+	double time = 0.0;
+	for (unsigned n = 0; n < warmup + frames; n++) {
+		size_t allocsBefore = allocCount.load(std::memory_order_relaxed);
+		size_t callsBefore  = wgpuCallCount.load(std::memory_order_relaxed);
+		auto start = std::chrono::steady_clock::now();
+
+		renderer->render(time);
+
+		auto end = std::chrono::steady_clock::now();
+		if (n >= warmup) {
+			frameMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+			frameAllocs.push_back(allocCount.load(std::memory_order_relaxed) - allocsBefore);
+			frameCalls.push_back(wgpuCallCount.load(std::memory_order_relaxed) - callsBefore);
+		}
+		// retiring the submitted work is Dawn's cost, not the frame's
+		wgpuDeviceTick(device);
+		time += BENCH_TIMESTEP;
+	}
+
+	double allocMean = 0.0;
+	double callMean  = 0.0;
+	for (unsigned n = 0; n < frames; n++) {
+		allocMean += frameAllocs[n];
+		callMean  += frameCalls[n];
+	}
+	allocMean /= frames;
+	callMean  /= frames;
+	std::sort(frameMs.begin(), frameMs.end());
+
+	printf("frames: %u (warm-up: %u)\n", frames, warmup);
+	printf("cpu frame time (ms): p50 %.4f p95 %.4f p99 %.4f max %.4f\n",
+		percentile(frameMs, 50), percentile(frameMs, 95), percentile(frameMs, 99), frameMs.back());
+	printf("allocations/frame: mean %.2f max %zu\n",
+		allocMean, *std::max_element(frameAllocs.begin(), frameAllocs.end()));
+	printf("webgpu calls/frame: mean %.2f max %zu\n",
+		callMean, *std::max_element(frameCalls.begin(), frameCalls.end()));
+
+	if (TracingPlatform::dump()) {
+		printf("trace written to: %s\n", getenv("RENDERER_TRACE"));
+	}
+
+	delete renderer;
+	window->destroy(wHnd);
+
+	if (gpuCulling) {
+		int mismatches = checkGpuCulling(scattered);
+		if (mismatches < 0) {
+			puts("gpu culling check: skipped (no adapter ran the culling pass)");
+		} else {
+			printf("gpu culling check: %d chunks differ from the cpu\n", mismatches);
+		}
+		return (mismatches > 0) ? 1 : 0;
+	}
+	return 0;
+}
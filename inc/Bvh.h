@@ -0,0 +1,92 @@
+/**
+ * \file Bvh.h
+ * Bounding volume hierarchy for frustum culling.
+ */
+#pragma once
+
+#include "defines.h"
+#include "VecMath.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Maximum number of objects per leaf.
+ */
+#define BVH_LEAF_SIZE 4
+
+/**
+ * Binary tree of axis-aligned boxes over a set of objects, each identified by
+ * its index into the boxes passed to \c #build(). Nodes are stored depth
+ * first (a node's left child directly follows it, with every descendant
+ * after it), and each covers a contiguous run of the object order, so a node
+ * wholly inside the frustum adds its objects without visiting its subtree.
+ * \n
+ * Objects that move are updated in place then \c #refit() enlarges (or
+ * shrinks) only the nodes above them, keeping the tree's structure. That
+ * degrades as objects drift far from where they were built, which a fresh
+ * \c #build() fixes.
+ */
+class Bvh {
+private:
+	struct Node {
+		float min[3];
+		float max[3];
+		uint32_t first;  // first object (in the order array) covered
+		uint32_t count;  // number of objects covered
+		uint32_t right;  // right child (zero for leaves)
+		uint32_t parent; // parent (the root being its own)
+	};
+	std::vector<Node> nodes;
+	std::vector<uint32_t> order;   // object indices, grouped by leaf
+	std::vector<uint32_t> leaves;  // leaf holding each object
+	std::vector<float> boxes;      // min then max xyz per object
+	std::vector<uint8_t> dirty;    // nodes needing a refit
+	uint32_t firstDirty = 0;       // lowest dirty node (or the node count if none)
+
+	uint32_t split(uint32_t first, uint32_t count, uint32_t parent);
+	void fit(Node& node) const;
+
+public:
+	Bvh() = default;
+
+	/**
+	 * Builds the tree from scratch.
+	 *
+	 * \param[in] mins minimum xyz of each object's box (\a count times three floats)
+	 * \param[in] maxs maximum xyz of each object's box
+	 * \param[in] count number of objects
+	 */
+	void build(const float* _NULLABLE mins, const float* _NULLABLE maxs, uint32_t count);
+
+	/**
+	 * Moves an object (taking effect on the next \c #refit()).
+	 *
+	 * \param[in] object object index
+	 * \param[in] min new box minimum (xyz)
+	 * \param[in] max new box maximum (xyz)
+	 */
+	void update(uint32_t object, const float* _NONNULL min, const float* _NONNULL max);
+
+	/**
+	 * Refits the nodes above objects moved since the last refit.
+	 */
+	void refit();
+
+	/**
+	 * Whether any object moved since the last \c #refit().
+	 */
+	inline bool needsRefit() const { return firstDirty < nodes.size(); }
+
+	/**
+	 * Appends the objects whose boxes are at least partly inside a frustum.
+	 *
+	 * \param[in] frustum planes to test against
+	 * \param[in,out] visible receives the visible objects' indices (in no particular order)
+	 */
+	void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	inline uint32_t getObjectCount() const { return (uint32_t) leaves.size(); }
+	inline uint32_t getNodeCount() const { return (uint32_t) nodes.size(); }
+};
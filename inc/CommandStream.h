@@ -0,0 +1,100 @@
+/**
+ * \file CommandStream.h
+ * Batched property updates written straight into memory by JavaScript.
+ */
+#pragma once
+
+#include "defines.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Bytes JavaScript can write per \c #CommandStream::flush() (a multiple of
+ * four).
+ */
+#ifndef COMMAND_STREAM_SIZE
+#define COMMAND_STREAM_SIZE (64 * 1024)
+#endif
+
+/**
+ * Command opcodes. Each command is a little-endian 32-bit opcode followed by
+ * its arguments, all 32-bit words (unsigned ints or floats, as listed).
+ */
+enum CommandOp : uint32_t {
+	CMD_SHOW_IMGUI = 1,       // u32 state (zero to hide)
+	CMD_SET_COLOR = 2,        // f32 r, g, b (as Renderer::setColor())
+	CMD_SET_VERTEX_COLOR = 3, // u32 vertex (0 to 2), f32 r, g, b
+	CMD_SET_CLEAR_COLOR = 4,  // f32 r, g, b, a
+	CMD_SET_SPEED = 5,        // f32 rotation speed
+	CMD_COUNT
+};
+
+/**
+ * Maximum number of argument words of any command.
+ */
+#define COMMAND_MAX_ARGS 4
+
+/**
+ * Decoded command (with only as many arguments filled in as the opcode has).
+ */
+struct Command {
+	CommandOp op;
+	union {
+		uint32_t u;
+		float f;
+	} args[COMMAND_MAX_ARGS];
+};
+
+/**
+ * Shared-memory command buffer replacing one JavaScript to WASM call per
+ * property update. JavaScript packs commands into the region at \c #data()
+ * (e.g. through a \c DataView or \c Uint32Array/\c Float32Array over
+ * \c HEAPU8) then makes a single \c #flush() call for the lot, which copies
+ * them aside so the region can be reused straight away. The renderer then
+ * applies everything flushed since its last frame in one pass.
+ */
+class CommandStream {
+private:
+	/**
+	 * Region written by JavaScript (words, so always 4-byte aligned).
+	 */
+	uint32_t staging[COMMAND_STREAM_SIZE / 4];
+
+	/**
+	 * Words of the commands flushed but not yet read by \c #next().
+	 */
+	std::vector<uint32_t> pending;
+	size_t read = 0;
+
+public:
+	CommandStream() = default;
+
+	inline uint8_t* _NONNULL data() { return reinterpret_cast<uint8_t*>(staging); }
+	inline size_t capacity() const { return sizeof(staging); }
+
+	/**
+	 * Accepts the first \a count commands written at \c #data(), stopping at
+	 * the first that's malformed (an unknown opcode or running off the end of
+	 * the region).
+	 *
+	 * \param[in] count number of commands written
+	 * \return number of commands accepted
+	 */
+	uint32_t flush(uint32_t count);
+
+	/**
+	 * Reads the next flushed command (in the order flushed), starting afresh
+	 * once all are read.
+	 *
+	 * \param[out] cmd receives the command
+	 * \return \c false if there are no more commands
+	 */
+	bool next(Command& cmd);
+
+	/**
+	 * Whether there are no flushed commands left to read.
+	 */
+	inline bool empty() const { return read >= pending.size(); }
+};
@@ -0,0 +1,111 @@
+/**
+ * \file FileCache.h
+ * Persistent on-disk cache for Dawn's compiled shaders and pipelines.
+ */
+#pragma once
+
+#include "MappedFile.h"
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+
+#include <dawn_platform/DawnPlatform.h>
+
+/**
+ * Default cap on the total size of cached values (in bytes). Once exceeded the
+ * least recently used entries are evicted.
+ */
+#ifndef FILE_CACHE_MAX_SIZE
+#define FILE_CACHE_MAX_SIZE (64 * 1024 * 1024)
+#endif
+
+/**
+ * Maximum number of entries tracked by the index.
+ */
+#ifndef FILE_CACHE_MAX_ENTRIES
+#define FILE_CACHE_MAX_ENTRIES 4096
+#endif
+
+/**
+ * File-backed implementation of Dawn's \c CachingInterface. Each value is
+ * stored in its own file (named from the key's hash, with the full key kept
+ * alongside to rule out collisions) and tracked in a memory-mapped index
+ * (an open-addressed hash table recording each entry's size and last use), so
+ * lookups of missing keys never touch the file system and the LRU state
+ * persists between runs without a separate load or save step.
+ * \n
+ * The cache is tied to the fingerprint Dawn passes in; a different fingerprint
+ * (e.g. after updating Dawn or the driver) empties it.
+ */
+class FileCache : public dawn_platform::CachingInterface {
+public:
+	/**
+	 * Header at the start of the index file.
+	 */
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t fingerprint; // hash of the Dawn fingerprint
+		uint64_t clock;       // incremented on each access, giving LRU order
+		uint64_t totalSize;   // sum of all entry sizes
+		uint32_t capacity;    // number of index slots
+		uint32_t count;       // number of used slots
+	};
+	/**
+	 * Index slot (a zero \c hash marks an empty slot).
+	 */
+	struct Entry {
+		uint64_t hash;
+		uint64_t size;
+		uint64_t lastUse;
+	};
+
+private:
+	std::string dir;
+	uint64_t maxSize;
+	MappedFile index;
+	std::mutex lock;
+
+public:
+	/**
+	 * Opens (or creates) the cache in a directory.
+	 *
+	 * \param[in] cacheDir directory holding the index and value files (created if needed)
+	 * \param[in] fingerprint Dawn's cache fingerprint
+	 * \param[in] fingerprintSize size of \a fingerprint in bytes
+	 * \param[in] maxSize cap on the total size of cached values
+	 */
+	FileCache(const char* _NONNULL cacheDir, const void* _NULLABLE fingerprint, size_t fingerprintSize, uint64_t maxSize = FILE_CACHE_MAX_SIZE);
+	~FileCache() OVERRIDE;
+
+	/**
+	 * Whether the index could be opened (if not, every load misses and stores
+	 * are ignored).
+	 */
+	inline bool isOpen() const { return index.isOpen(); }
+
+	size_t LoadData(const WGPUDevice device, const void* key, size_t keySize, void* valueOut, size_t valueSize) OVERRIDE;
+	void StoreData(const WGPUDevice device, const void* key, size_t keySize, const void* value, size_t valueSize) OVERRIDE;
+
+private:
+	Header* _NONNULL header();
+	Entry* _NONNULL entries();
+	/**
+	 * Finds the slot for \a hash: either the slot holding it or the empty slot
+	 * where it would be inserted.
+	 */
+	uint32_t find(uint64_t hash);
+	/**
+	 * Clears a slot, shifting back any following entries in the same probe run.
+	 */
+	void remove(uint32_t slot);
+	/**
+	 * Evicts least recently used entries until \a needed more bytes fit.
+	 */
+	void evict(uint64_t needed);
+	/**
+	 * Path of the file holding the value for \a hash.
+	 */
+	std::string path(uint64_t hash) const;
+};
@@ -0,0 +1,73 @@
+/**
+ * \file InputQueue.h
+ * Lock-free queue passing input events from the window to the renderer.
+ */
+#pragma once
+
+#include "defines.h"
+
+#include <stddef.h>
+#include <atomic>
+
+/**
+ * Number of events the queue holds (a power of two). Events arriving while
+ * it's full are dropped.
+ */
+#ifndef INPUT_QUEUE_SIZE
+#define INPUT_QUEUE_SIZE 1024
+#endif
+
+/**
+ * Input event, with mouse buttons and actions already converted to our
+ * constants (\c MOUSE_LEFT_BUTTON, \c ACTION_PRESSED, etc.).
+ */
+struct InputEvent {
+	enum Type {
+		MOUSE_BUTTON, // button, action, x, y
+		MOUSE_MOVE,   // x, y
+		MOUSE_SCROLL, // x, y (scroll offsets)
+		KEY,          // button (key code), action
+		CHAR,         // button (Unicode code point)
+		RESIZE,       // button (width), action (height)
+	} type;
+	int button;
+	int action;
+	double x;
+	double y;
+};
+
+/**
+ * Single-producer/single-consumer queue of \c InputEvent: the window's event
+ * loop pushes on one thread while the renderer pops on another, each side
+ * only ever advancing its own index.
+ */
+class InputQueue {
+private:
+	InputEvent events[INPUT_QUEUE_SIZE];
+	std::atomic<size_t> head = 0; // next to pop (consumer)
+	std::atomic<size_t> tail = 0; // next to push (producer)
+
+public:
+	/**
+	 * Adds an event (called only by the producer thread).
+	 *
+	 * \param[in] event event to add
+	 * \return \c false if the queue was full (and the event dropped)
+	 */
+	bool push(const InputEvent& event);
+
+	/**
+	 * Removes the oldest event (called only by the consumer thread).
+	 *
+	 * \param[out] event receives the event
+	 * \return \c false if the queue was empty
+	 */
+	bool pop(InputEvent& event);
+
+	/**
+	 * Whether there are no events to pop (called only by the consumer thread).
+	 */
+	inline bool empty() const {
+		return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+	}
+};
@@ -0,0 +1,65 @@
+/**
+ * \file MappedFile.h
+ * Memory-mapped file access.
+ */
+#pragma once
+
+#include "defines.h"
+
+#include <stddef.h>
+
+/**
+ * A file mapped into memory (read-only or read-write). Not available in web
+ * builds (which have no file system), where \c #open() always fails.
+ */
+class MappedFile {
+private:
+	void* _NULLABLE ptr = NULLPTR;
+	size_t len = 0;
+#ifdef _WIN32
+	void* _NULLABLE file = NULLPTR;
+	void* _NULLABLE mapping = NULLPTR;
+#else
+	int fd = -1;
+#endif
+
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/**
+	 * Maps an existing file read-only.
+	 *
+	 * \param[in] path file to open
+	 * \return \c true if the file was opened and mapped (empty files fail)
+	 */
+	bool open(const char* _NONNULL path);
+
+	/**
+	 * Maps a file read-write, creating it or resizing it to \a size bytes as
+	 * needed (new bytes are zero).
+	 *
+	 * \param[in] path file to open or create
+	 * \param[in] size size of the file (and mapping) in bytes
+	 * \return \c true if the file was opened and mapped
+	 */
+	bool create(const char* _NONNULL path, size_t size);
+
+	/**
+	 * Writes any modified pages back to the file.
+	 */
+	void flush();
+
+	/**
+	 * Unmaps and closes the file.
+	 */
+	void close();
+
+	inline void* _NULLABLE data() { return ptr; }
+	inline const void* _NULLABLE data() const { return ptr; }
+	inline size_t size() const { return len; }
+	inline bool isOpen() const { return ptr != NULLPTR; }
+};
@@ -0,0 +1,297 @@
+/**
+ * \file Mesh.h
+ * Vertex/index buffers with configurable (and optionally quantized) layouts.
+ */
+#pragma once
+
+#include "defines.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <webgpu/webgpu.h>
+
+class Renderer;
+
+/**
+ * Vertex attributes a mesh can have, each at a fixed shader location (see
+ * \c #VertexLayout::getShaderLocation()).
+ */
+enum MeshAttrib {
+	MESH_POSITION, // 2 or 3 components
+	MESH_COLOR,    // 3 or 4 components (RGB or RGBA)
+	MESH_NORMAL,   // 3 components
+	MESH_TEXCOORD, // 2 components
+	MESH_ATTRIB_COUNT
+};
+
+/**
+ * How an attribute is stored. The normalized formats are read by the shader
+ * as floats in \c [0, 1] (unsigned) or \c [-1, 1] (signed): positions are
+ * remapped to fit their bounds (see \c #Mesh::getDequantize()), the others
+ * are stored as-is, clamped to the range.
+ */
+enum MeshEncoding {
+	MESH_FLOAT,   // 32-bit floats (1 to 4 components)
+	MESH_UNORM16, // 16-bit normalized (2 or 4 components)
+	MESH_SNORM16,
+	MESH_UNORM8,  // 8-bit normalized (always 4 components)
+	MESH_SNORM8,
+};
+
+/**
+ * Maximum number of vertex buffers a mesh uses (one per attribute when split).
+ */
+#define MESH_MAX_STREAMS MESH_ATTRIB_COUNT
+
+/**
+ * Meshes with at most this many vertices get 16-bit indices.
+ */
+#define MESH_MAX_INDEX16_VERTICES 0x10000
+
+/**
+ * Maximum number of levels of detail per mesh (see \c #MeshLod).
+ */
+#define MESH_MAX_LODS 4
+
+/**
+ * Where and how each attribute of a mesh is stored: either interleaved in a
+ * single vertex buffer or split into one buffer per attribute. Formats are
+ * widened as needed so every attribute starts on a four byte boundary (which
+ * WebGPU requires) and strides are multiples of four.
+ */
+class VertexLayout {
+private:
+	bool interleaved;
+	uint32_t streamCount = 0;
+	uint32_t mask = 0;
+	uint32_t strides[MESH_MAX_STREAMS] = {};
+	uint8_t components[MESH_ATTRIB_COUNT] = {};
+	MeshEncoding encodings[MESH_ATTRIB_COUNT] = {};
+	WGPUVertexAttributeDescriptor attributes[MESH_ATTRIB_COUNT] = {};
+	uint32_t streams[MESH_ATTRIB_COUNT] = {};
+
+	/**
+	 * Buffer layouts (and their attributes) built from the above by
+	 * \c #getBufferLayouts().
+	 */
+	mutable WGPUVertexBufferLayoutDescriptor buffers[MESH_MAX_STREAMS] = {};
+	mutable WGPUVertexAttributeDescriptor packed[MESH_ATTRIB_COUNT] = {};
+
+public:
+	/**
+	 * Creates an empty layout.
+	 *
+	 * \param[in] interleaved \c true for a single vertex buffer, \c false for one per attribute
+	 */
+	VertexLayout(bool interleaved = true);
+
+	/**
+	 * Adds an attribute, after any added before it (attributes already in the
+	 * layout are left as they are).
+	 *
+	 * \param[in] attrib attribute to add
+	 * \param[in] encoding how it's stored
+	 * \param[in] components number of source components (1 to 4)
+	 * \return this layout
+	 */
+	VertexLayout& add(MeshAttrib attrib, MeshEncoding encoding, uint32_t components);
+
+	inline bool has(MeshAttrib attrib) const { return (mask & (1u << attrib)) != 0; }
+	inline bool isInterleaved() const { return interleaved; }
+	inline uint32_t getStreamCount() const { return streamCount; }
+	inline uint32_t getStride(uint32_t stream) const { return strides[stream]; }
+	inline uint32_t getStream(MeshAttrib attrib) const { return streams[attrib]; }
+	inline uint32_t getOffset(MeshAttrib attrib) const { return (uint32_t) attributes[attrib].offset; }
+	inline uint32_t getComponents(MeshAttrib attrib) const { return components[attrib]; }
+	inline MeshEncoding getEncoding(MeshAttrib attrib) const { return encodings[attrib]; }
+	inline WGPUVertexFormat getFormat(MeshAttrib attrib) const { return attributes[attrib].format; }
+
+	/**
+	 * Bytes per vertex across all streams.
+	 */
+	uint32_t getVertexSize() const;
+
+	/**
+	 * Buffer layouts for a render pipeline, in stream order (so a mesh's
+	 * streams are bound to slots zero onwards). Valid until the layout is
+	 * changed or destroyed.
+	 *
+	 * \return \c #getStreamCount() buffer layouts
+	 */
+	const WGPUVertexBufferLayoutDescriptor* _NONNULL getBufferLayouts() const;
+
+	/**
+	 * Shader location each attribute is bound to (locations two to six being
+	 * taken by the renderer's per-instance attributes).
+	 *
+	 * \param[in] attrib attribute
+	 * \return shader location
+	 */
+	static uint32_t getShaderLocation(MeshAttrib attrib);
+};
+
+/**
+ * One level of detail of a mesh: a range of its indices drawing a simplified
+ * version over the same vertices (see \c #MeshOptimizer::generateLods()).
+ * Level zero is the full detail mesh.
+ */
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error; // furthest the simplified surface strays from the full detail (in source position units)
+};
+
+/**
+ * Source data for \c #Mesh::create(), as floats, with only positions
+ * required (and components per vertex as given by the layout).
+ */
+struct MeshData {
+	const float* _NULLABLE attribs[MESH_ATTRIB_COUNT];
+	uint32_t vertexCount;
+	const uint32_t* _NULLABLE indices; // triangle list (or null to draw the vertices in order)
+	uint32_t indexCount;
+	const MeshLod* _NULLABLE lods; // ranges of the indices per level of detail (or null for a single level of every index)
+	uint32_t lodCount;
+};
+
+/**
+ * Vertex and index buffers for a mesh, described by a \c VertexLayout.
+ * Created either from floats, encoded here, or from data already in the
+ * layout's format (e.g. loaded from disk or written by JavaScript), uploaded
+ * as-is.
+ */
+class Mesh {
+private:
+	VertexLayout layout;
+	WGPUBuffer _NULLABLE streams[MESH_MAX_STREAMS] = {};
+	WGPUBuffer _NULLABLE indexBuf = NULLPTR;
+	WGPUIndexFormat indexFormat = WGPUIndexFormat_Uint32;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount  = 0;
+
+	/**
+	 * Index ranges of each level of detail, all in the one index buffer
+	 * (\c #indexCount being level zero's).
+	 */
+	MeshLod lods[MESH_MAX_LODS] = {};
+	uint32_t lodCount = 0;
+
+	/**
+	 * Maps normalized positions back to their bounds (scale then offset).
+	 */
+	float dequantScale[3]  = {1.0f, 1.0f, 1.0f};
+	float dequantOffset[3] = {0.0f, 0.0f, 0.0f};
+
+	/**
+	 * Bounds of the stored positions (min then max xyz, before dequantizing).
+	 */
+	float bounds[6] = {};
+
+public:
+	Mesh() = default;
+	Mesh(Mesh&& other) noexcept;
+	Mesh& operator=(Mesh&& other) noexcept;
+	~Mesh();
+
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+
+	/**
+	 * Encodes the source data in \a layout's formats then uploads it, with
+	 * 16-bit indices if there are few enough vertices. Every level of detail's
+	 * indices go in the same buffer.
+	 *
+	 * \param[in] renderer renderer owning the device and queue
+	 * \param[in] data source attributes (those in \a layout), indices and levels of detail
+	 * \param[in] layout formats to store the attributes in
+	 * \return \c false if \a data lacks positions or an attribute in \a layout, or a level of detail is outside the indices
+	 */
+	bool create(Renderer& renderer, const MeshData& data, const VertexLayout& layout);
+
+	/**
+	 * Uploads data already encoded in \a layout's formats straight from
+	 * memory (with no intermediate copies).
+	 *
+	 * \param[in] renderer renderer owning the device and queue
+	 * \param[in] layout layout of \a vertexData
+	 * \param[in] vertexData one pointer per stream, each to \a vertexCount vertices of the stream's stride
+	 * \param[in] vertexCount number of vertices
+	 * \param[in] indices index data (with 16-bit indices padded to an even count, since queue writes are in multiples of four bytes)
+	 * \param[in] indexCount number of indices
+	 * \param[in] format format of \a indices
+	 * \param[in] dequantize optional scale then offset (six floats) to map normalized positions back to their bounds
+	 * \param[in] lods optional ranges of \a indices per level of detail (already checked to be within them)
+	 * \param[in] lodCount number of levels in \a lods (at most \c #MESH_MAX_LODS, or zero for a single level of every index)
+	 */
+	void upload(Renderer& renderer, const VertexLayout& layout, const void* _NONNULL const* _NONNULL vertexData, uint32_t vertexCount,
+		const void* _NONNULL indices, uint32_t indexCount, WGPUIndexFormat format, const float* _NULLABLE dequantize = NULLPTR,
+		const MeshLod* _NULLABLE lods = NULLPTR, uint32_t lodCount = 0);
+
+	/**
+	 * Releases the GPU buffers.
+	 */
+	void release();
+
+	/**
+	 * Binds the vertex streams to slots zero onwards, and the index buffer.
+	 *
+	 * \param[in] pass pass to bind to
+	 */
+	void bind(WGPURenderPassEncoder _NONNULL pass) const;
+
+	/**
+	 * Column-major matrix mapping normalized positions back to their bounds
+	 * (identity for float positions), to be applied before the model matrix.
+	 *
+	 * \param[out] matrix receives the 16 floats
+	 */
+	void getDequantize(float* _NONNULL matrix) const;
+
+	/**
+	 * Box enclosing the positions as stored (so normalized for quantized
+	 * positions, needing the \c #getDequantize() matrix applied along with
+	 * the model matrix). Positions without a \c z are flat at zero.
+	 *
+	 * \param[out] min receives the minimum xyz
+	 * \param[out] max receives the maximum xyz
+	 */
+	void getBounds(float* _NONNULL min, float* _NONNULL max) const;
+
+	inline const VertexLayout& getLayout() const { return layout; }
+	inline uint32_t getVertexCount() const { return vertexCount; }
+	inline uint32_t getIndexCount() const { return indexCount; }
+	inline uint32_t getLodCount() const { return lodCount; }
+	inline const MeshLod& getLod(uint32_t lod) const { return lods[lod]; }
+	inline WGPUIndexFormat getIndexFormat() const { return indexFormat; }
+	inline bool isQuantized() const { return layout.getEncoding(MESH_POSITION) != MESH_FLOAT; }
+
+	/**
+	 * Encodes float data in \a layout's formats (as \c #create() does, but
+	 * into memory, e.g. to be written to a file and later passed to
+	 * \c #upload()).
+	 *
+	 * \param[in] data source attributes (those in \a layout)
+	 * \param[in] layout formats to store the attributes in
+	 * \param[out] streamData receives each stream's vertices (\c #MESH_MAX_STREAMS vectors)
+	 * \param[out] dequantize receives the scale then offset (six floats) mapping normalized positions back to their bounds
+	 * \return \c false if \a data lacks positions or an attribute in \a layout
+	 */
+	static bool encodeVertices(const MeshData& data, const VertexLayout& layout, std::vector<uint8_t>* _NONNULL streamData,
+		float* _NONNULL dequantize);
+
+	/**
+	 * Creates an index buffer, narrowing to 16-bit indices if \a vertexCount
+	 * allows and padding to the four byte multiple queue writes need.
+	 *
+	 * \param[in] renderer renderer owning the device and queue
+	 * \param[in] indices index data
+	 * \param[in] indexCount number of indices
+	 * \param[in] vertexCount number of vertices indexed
+	 * \param[out] format receives the chosen index format
+	 * \return new index buffer
+	 */
+	static WGPUBuffer _NONNULL createIndexBuffer(Renderer& renderer, const uint32_t* _NONNULL indices, uint32_t indexCount,
+		uint32_t vertexCount, WGPUIndexFormat& format);
+};
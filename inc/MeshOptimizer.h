@@ -0,0 +1,185 @@
+/**
+ * \file MeshOptimizer.h
+ * Index and vertex reordering for faster drawing of large meshes.
+ */
+#pragma once
+
+#include "defines.h"
+#include "Mesh.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * Post-transform vertex cache size optimized for (FIFO, in vertices). Sixteen
+ * is a good fit for most GPUs, erring on the small side being the safe bet.
+ */
+#define MESH_OPT_CACHE_SIZE 16
+
+/**
+ * Fraction of the previous level's triangles each level of detail aims for.
+ */
+#define MESH_OPT_LOD_RATIO 0.5f
+
+/**
+ * Levels of detail keeping more than this fraction of the previous level's
+ * triangles (where the rest of the mesh is borders, which are kept) aren't
+ * worth their indices, ending the chain.
+ */
+#define MESH_OPT_LOD_MIN_SAVING 0.8f
+
+/**
+ * Float mesh data owned in memory (which \c MeshData only points to), as
+ * loaded and before it's encoded into a \c Mesh.
+ */
+struct MeshSource {
+	std::vector<float> attribs[MESH_ATTRIB_COUNT];
+	uint32_t components[MESH_ATTRIB_COUNT] = {};
+	std::vector<uint32_t> indices;
+	std::vector<MeshLod> lods; // ranges of the indices per level of detail (empty for a single level)
+	uint32_t vertexCount = 0;
+
+	/**
+	 * Pointers to the data, valid while the vectors are unchanged.
+	 */
+	MeshData getData() const;
+};
+
+/**
+ * Reorders meshes arriving in arbitrary triangle and vertex order (scans,
+ * CAD exports, etc.) so that fewer vertices are transformed, fewer pixels
+ * shaded and vertex fetches hit memory in order. The stages are meant to run
+ * in the order of \c #optimize(), each keeping the previous one's gains.
+ */
+namespace MeshOptimizer {
+	/**
+	 * Reorders triangles for post-transform vertex cache hits, using Sander
+	 * et al.'s \e Tipsify (fanning around each vertex in turn while its
+	 * neighbours are still likely cached).
+	 *
+	 * \param[in,out] indices triangle list to reorder
+	 * \param[in] indexCount number of indices (a multiple of three)
+	 * \param[in] vertexCount number of vertices indexed
+	 * \param[in] cacheSize cache size to optimize for
+	 */
+	void optimizeVertexCache(uint32_t* _NONNULL indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = MESH_OPT_CACHE_SIZE);
+
+	/**
+	 * Reorders clusters of triangles (as left by \c #optimizeVertexCache(),
+	 * split wherever the cache starts cold) so those facing outwards from the
+	 * mesh's centre are drawn first, occluding more of the rest. Triangles
+	 * within each cluster stay in order, so the cache efficiency is kept.
+	 *
+	 * \param[in,out] indices triangle list to reorder
+	 * \param[in] indexCount number of indices (a multiple of three)
+	 * \param[in] positions vertex positions
+	 * \param[in] components number of floats per position (2 or 3)
+	 * \param[in] vertexCount number of vertices indexed
+	 * \param[in] cacheSize cache size the clusters were formed with
+	 */
+	void optimizeOverdraw(uint32_t* _NONNULL indices, size_t indexCount, const float* _NONNULL positions, uint32_t components,
+		uint32_t vertexCount, uint32_t cacheSize = MESH_OPT_CACHE_SIZE);
+
+	/**
+	 * Renumbers the vertices in the order they're first indexed, so vertex
+	 * fetches walk memory sequentially, dropping any never indexed.
+	 *
+	 * \param[in,out] mesh mesh whose vertices and indices to reorder
+	 * \return new number of vertices
+	 */
+	uint32_t optimizeVertexFetch(MeshSource& mesh);
+
+	/**
+	 * Simplifies a triangle list by collapsing edges onto one of their own
+	 * vertices, cheapest first as measured by Garland and Heckbert's quadric
+	 * error metric (the squared distance from the planes of the triangles
+	 * merged into each vertex). Only the indices change, so the result draws
+	 * from the same vertices. Vertices on borders (including seams, where
+	 * vertices are split) never move, nor do collapses flip triangles.
+	 *
+	 * \param[in,out] indices triangle list to simplify (the result being written at the start)
+	 * \param[in] indexCount number of indices (a multiple of three)
+	 * \param[in] positions vertex positions
+	 * \param[in] components number of floats per position (2 or 3)
+	 * \param[in] vertexCount number of vertices indexed
+	 * \param[in] targetCount number of indices to stop at (or above, if nothing more can collapse)
+	 * \param[out] error receives the error of the costliest collapse (the root mean square distance of the vertex kept from the planes merged into it, in position units)
+	 * \return number of indices left
+	 */
+	size_t simplify(uint32_t* _NONNULL indices, size_t indexCount, const float* _NONNULL positions, uint32_t components,
+		uint32_t vertexCount, size_t targetCount, float* _NULLABLE error = NULLPTR);
+
+	/**
+	 * Appends simplified levels of detail to a mesh's indices, each with
+	 * about \c #MESH_OPT_LOD_RATIO of the previous one's triangles, until
+	 * \a lodCount levels (or \c #MESH_MAX_LODS) or simplifying stops paying.
+	 * Each level's error includes those of the levels it was simplified from.
+	 *
+	 * \param[in,out] mesh mesh to add levels to (its \c lods then covering the indices)
+	 * \param[in] lodCount number of levels wanted (including the full detail)
+	 */
+	void generateLods(MeshSource& mesh, uint32_t lodCount);
+
+	/**
+	 * Runs every stage in turn (vertex cache, overdraw then vertex fetch),
+	 * reordering each level of detail's triangles separately.
+	 *
+	 * \param[in,out] mesh mesh to optimize
+	 */
+	void optimize(MeshSource& mesh);
+
+	/**
+	 * Average cache miss ratio (transformed vertices per triangle, from 0.5
+	 * at best to 3 at worst) for a FIFO cache, to measure the above.
+	 *
+	 * \param[in] indices triangle list
+	 * \param[in] indexCount number of indices
+	 * \param[in] vertexCount number of vertices indexed
+	 * \param[in] cacheSize cache size to simulate
+	 * \return vertices transformed per triangle
+	 */
+	float getACMR(const uint32_t* _NONNULL indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize = MESH_OPT_CACHE_SIZE);
+
+	/**
+	 * Runs \c #generateLods() then \c #optimize() on a worker thread (or,
+	 * on the web without thread support, immediately on construction).
+	 */
+	class Job {
+	private:
+		MeshSource mesh;
+		uint32_t lodCount;
+		std::thread worker;
+		std::atomic<bool> finished = false;
+
+	public:
+		/**
+		 * Starts optimizing \a mesh.
+		 *
+		 * \param[in] mesh mesh to take ownership of
+		 * \param[in] lodCount number of levels of detail to generate (including the full detail)
+		 */
+		explicit Job(MeshSource&& mesh, uint32_t lodCount = 1);
+
+		/**
+		 * Waits for the worker to finish.
+		 */
+		~Job();
+
+		Job(const Job&) = delete;
+		Job& operator=(const Job&) = delete;
+
+		/**
+		 * Whether the mesh is optimized (after which \c #getMesh() may be
+		 * called).
+		 */
+		inline bool isFinished() const { return finished.load(std::memory_order_acquire); }
+
+		/**
+		 * The optimized mesh (only once \c #isFinished()).
+		 */
+		inline MeshSource& getMesh() { return mesh; }
+	};
+}
@@ -0,0 +1,119 @@
+/**
+ * \file MirroredBuffer.h
+ * GPU buffer with a CPU-side copy and dirty range tracking.
+ */
+#pragma once
+
+#include "defines.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <webgpu/webgpu.h>
+
+class Renderer;
+
+/**
+ * Dirty ranges closer than this (in bytes) are merged into a single upload,
+ * trading a few redundant bytes for fewer \c wgpuQueueWriteBuffer() calls.
+ */
+#define MIRRORED_BUFFER_MERGE_GAP 64
+
+/**
+ * A GPU buffer mirrored in CPU memory. Writes go to the mirror, recording the
+ * modified byte ranges, and \c #flush() uploads only the merged dirty spans
+ * (so rewriting unchanged data every frame costs a compare, not an upload).
+ */
+class MirroredBuffer {
+private:
+	/**
+	 * Half-open byte range \c [begin, end).
+	 */
+	struct Range {
+		size_t begin;
+		size_t end;
+	};
+
+	WGPUBuffer _NULLABLE buffer = NULLPTR;
+	WGPUBufferUsage usage = WGPUBufferUsage_None;
+	std::vector<uint8_t> mirror;
+	std::vector<Range> dirty;
+
+	void markDirty(size_t begin, size_t end);
+
+public:
+	MirroredBuffer() = default;
+	MirroredBuffer(MirroredBuffer&& other) noexcept;
+	MirroredBuffer& operator=(MirroredBuffer&& other) noexcept;
+	~MirroredBuffer();
+
+	MirroredBuffer(const MirroredBuffer&) = delete;
+	MirroredBuffer& operator=(const MirroredBuffer&) = delete;
+
+	/**
+	 * Creates the GPU buffer (through \c Renderer::createBuffer()) and its mirror.
+	 *
+	 * \param[in] renderer renderer owning the device and queue
+	 * \param[in] data optional initial contents (or \c null to zero fill)
+	 * \param[in] size number of bytes (rounded up to a multiple of four)
+	 * \param[in] usage type of buffer
+	 */
+	void create(Renderer& renderer, const void* _NULLABLE data, size_t size, WGPUBufferUsage usage);
+
+	/**
+	 * Grows the buffer to at least \a size bytes (at least doubling, to keep
+	 * repeated growth amortised), preserving the contents. Growing recreates
+	 * the GPU buffer so anything bound to the old one must be rebound.
+	 *
+	 * \param[in] renderer renderer owning the device and queue
+	 * \param[in] size minimum number of bytes required
+	 * \return \c true if the GPU buffer was recreated
+	 */
+	bool reserve(Renderer& renderer, size_t size);
+
+	/**
+	 * Releases the GPU buffer and mirror.
+	 */
+	void release();
+
+	/**
+	 * Copies \a data into the mirror, marking only the bytes that changed as
+	 * dirty.
+	 *
+	 * \param[in] offset byte offset into the buffer
+	 * \param[in] data source data
+	 * \param[in] size number of bytes in \a data
+	 * \return \c false if the range is outside the buffer (nothing being written)
+	 */
+	bool write(size_t offset, const void* _NONNULL data, size_t size);
+
+	/**
+	 * Returns the mirror for in-place modification, marking the whole range as
+	 * dirty.
+	 *
+	 * \param[in] offset byte offset into the buffer
+	 * \param[in] size number of bytes that will be modified
+	 * \return pointer to the mirror at \a offset (or null if the range is outside the buffer)
+	 */
+	void* _NULLABLE modify(size_t offset, size_t size);
+
+	/**
+	 * Marks the whole buffer as dirty, for when the GPU buffer was written by
+	 * other means (a compute pass, etc.) so the mirror no longer matches it.
+	 */
+	void invalidate();
+
+	/**
+	 * Uploads the merged dirty spans (aligned to four bytes) and clears them.
+	 *
+	 * \param[in] queue queue to write through
+	 * \return number of bytes uploaded
+	 */
+	size_t flush(WGPUQueue _NONNULL queue);
+
+	inline WGPUBuffer _NULLABLE getBuffer() { return buffer; }
+	inline size_t getSize() { return mirror.size(); }
+	inline const uint8_t* _NULLABLE getData() { return mirror.data(); }
+	inline bool isDirty() { return !dirty.empty(); }
+};
@@ -0,0 +1,95 @@
+/**
+ * \file PipelineCache.h
+ * Render pipeline (and shader module) cache keyed on the descriptor contents.
+ */
+#pragma once
+
+#include "defines.h"
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <webgpu/webgpu.h>
+
+/**
+ * Returns existing render pipelines for descriptors describing the same state,
+ * compiling only on a miss. The key covers the pipeline layout, shader stages,
+ * vertex layout, topology, rasterisation, depth-stencil, blend and colour
+ * formats; objects in the key (layouts and modules) are identified by handle
+ * and referenced for as long as the cache holds the pipeline, so a handle can
+ * never be recycled into a false hit.
+ *
+ * Shader modules created through \c #getShaderModule() are deduplicated by
+ * source, so the same source always yields the same module (and therefore
+ * pipeline hits).
+ *
+ * Returned pipelines and modules are owned by the cache.
+ */
+class PipelineCache {
+private:
+	/**
+	 * Flattened descriptor contents, compared in full on a hash match.
+	 */
+	typedef std::vector<uint64_t> Key;
+
+	struct KeyHash {
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry {
+		WGPURenderPipeline _NONNULL pipeline;
+		std::vector<WGPUShaderModule> modules; // referenced modules (released with the entry)
+		WGPUPipelineLayout _NULLABLE layout;   // referenced layout (released with the entry)
+	};
+
+	WGPUDevice _NULLABLE device = NULLPTR;
+	std::unordered_map<Key, Entry, KeyHash> pipelines;
+	std::unordered_map<std::string, WGPUShaderModule> shaders;
+
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+
+	static Key createKey(const WGPURenderPipelineDescriptor& desc);
+
+public:
+	PipelineCache() = default;
+	~PipelineCache();
+
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+
+	inline void setDevice(WGPUDevice _NULLABLE device) { this->device = device; }
+
+	/**
+	 * Returns the WGSL shader module for \a code, compiling it on first use.
+	 *
+	 * \param[in] code WGSL shader source
+	 * \param[in] label optional shader name (only used on creation)
+	 */
+	WGPUShaderModule _NULLABLE getShaderModule(const std::string& code, const char* _NULLABLE label = NULLPTR);
+
+	/**
+	 * Returns the render pipeline for \a desc, creating it on a miss.
+	 *
+	 * \param[in] desc full pipeline description
+	 */
+	WGPURenderPipeline _NULLABLE getRenderPipeline(const WGPURenderPipelineDescriptor& desc);
+
+	/**
+	 * Releases every cached pipeline and shader module.
+	 */
+	void clear();
+
+	/**
+	 * Pipeline lookups served from the cache.
+	 */
+	inline uint32_t getHits() { return hits; }
+
+	/**
+	 * Pipeline lookups that needed a compile.
+	 */
+	inline uint32_t getMisses() { return misses; }
+	inline size_t getSize() { return pipelines.size(); }
+};
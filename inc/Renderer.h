@@ -1,18 +1,75 @@
 #pragma once
 
+#include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 #include <webgpu/webgpu.h>
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_wgpu.h"
 #include "defines.h"
+#include "Bvh.h"
+#include "CommandStream.h"
+#include "InputQueue.h"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "MirroredBuffer.h"
+#include "PipelineCache.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include "UniformRing.h"
 
 #include <GLFW/glfw3.h>
 
+/**
+ * Mesh ID returned when a mesh couldn't be added (zero being the triangle's).
+ */
+#define RENDERER_INVALID_MESH 0xFFFFFFFFu
+
+/**
+ * Per-instance attributes (the second, instance-stepped, vertex stream).
+ */
+struct Transform
+{
+	/**
+	 * Column-major model matrix.
+	 */
+	float matrix[16];
+
+	/**
+	 * RGBA colour multiplied with the vertex colours.
+	 */
+	float color[4];
+};
+
 class Renderer
 {
 private:
+	/**
+	 * All instances of one mesh, drawn with a single instanced draw call (per
+	 * level of detail).
+	 */
+	struct InstanceBatch
+	{
+		MirroredBuffer buffer; // per-instance attribute stream (array of Transform)
+		uint32_t count = 0;
+		Mesh mesh; // vertex/index buffers (empty for the triangle, which has its own)
+		WGPURenderPipeline pipeline = nullptr; // pipeline for the mesh's layout (owned by the cache)
+		MirroredBuffer visible; // instances passing the frustum test, compacted from the above (what's drawn, in ranges per chunk and level when culled on the GPU)
+		uint32_t visibleCount = 0;
+		uint32_t lodCounts[MESH_MAX_LODS] = {}; // visible instances per level of detail (consecutive, finest first)
+		std::vector<uint8_t> lods; // level of detail each instance was last drawn at (see selectLods())
+		bool compacted = false; // whether the visible instances were compacted (else all are drawn from the buffer)
+		uint32_t firstObject = 0; // BVH object of the first instance (the rest following in order)
+		bool culled = false; // whether the instances are in the BVH (the mesh's bounds being known)
+		MirroredBuffer chunks;   // bounds and instance range of each chunk (culled on the GPU, see encodeCulling())
+		MirroredBuffer drawArgs; // indirect draw arguments per chunk and level of detail (instance counts written by the GPU)
+		uint32_t chunkCount = 0;
+		uint32_t cullLods = 1; // levels of detail (so draw arguments) per chunk
+		WGPUBindGroup cullGroup = nullptr; // culling pass bindings (instances, chunks, visible instances and arguments)
+	};
 	
 	/**
 	 * Current rotation angle (in degrees, updated per frame).
@@ -26,20 +83,151 @@ private:
 	ImVec4 vertex3 = ImVec4(0.0f, 0.0f, 1.00f, 1.00f);
 	float speed = 0.0f;
 
-	WGPURenderPipeline pipeline;
-	WGPUBuffer vertBuf; // vertex buffer with triangle position and colours
+	/**
+	 * Current render target size (as last passed to \c #resize()).
+	 */
+	int width = 0;
+	int height = 0;
+
+	/**
+	 * Input from a threaded window (see \c #processInput()).
+	 */
+	InputQueue input;
+
+	/**
+	 * Property updates batched by JavaScript (see \c #applyCommands()).
+	 */
+	CommandStream commands;
+
+	/**
+	 * Whether ImGui gets its input, display size and timing from its GLFW
+	 * backend (otherwise they're filled in by \c #renderImGui() and
+	 * \c #processInput()).
+	 */
+	bool imguiGlfw = false;
+
+	/**
+	 * Time passed to the previous \c #render() and the time since then (used
+	 * only without the GLFW backend, where time is in seconds).
+	 */
+	double lastTime = 0.0;
+	float frameTime = 1.0f / 60.0f;
+
+	/**
+	 * Set when something changed that the next frame needs to show, then
+	 * turned into a few frames to render (see \c #needsRedraw()).
+	 */
+	bool dirty = true;
+	unsigned settleFrames = 0;
+
+	/**
+	 * Frame rate and ImGui stats as shown in the panel, only refreshed every
+	 * \c #STATS_INTERVAL (otherwise the panel changes each frame and ImGui's
+	 * draw data can't be replayed).
+	 */
+	float statsAge = 0.0f;
+	float statsFramerate = 0.0f;
+	unsigned statsReplayed = 0;
+
+	PipelineCache pipelines;
+	WGPUPipelineLayout pipelineLayout; // shared by every mesh's pipeline
+	MirroredBuffer vertices; // vertex buffer with triangle position and colours (uploaded only when changed)
 	WGPUBuffer indxBuf; // index buffer
-	WGPUBuffer uRotBuf; // uniform buffer (containing the rotation angle)
-	WGPUBindGroup bindGroup;
+	WGPUIndexFormat indxFormat;
+	WGPUBindGroupLayout uniformLayout; // layout of the uniform bind group (kept to recreate it when the ring grows)
+	WGPUBindGroup bindGroup; // uniform bind group (bound with a dynamic offset into the ring)
+
+	/**
+	 * Instances per mesh ID (mesh \c 0 being the triangle).
+	 */
+	std::vector<InstanceBatch> batches;
+
+	/**
+	 * Transform hierarchy positioning mesh instances (copied to the instance
+	 * buffers as world matrices change, see \c #updateScene()).
+	 */
+	Scene scene;
+
+	/**
+	 * View-projection matrix (column-major), applied after the triangle's
+	 * rotation (see \c #setViewProjection()).
+	 */
+	float viewProj[16];
+
+	/**
+	 * Bounds of every instance, culled against the view each frame (see
+	 * \c #cullInstances()). Rebuilt when instances are added or removed, and
+	 * refit as scene nodes move.
+	 */
+	Bvh bvh;
+	bool bvhStale = true;
+	std::vector<uint32_t> objectBatches; // mesh ID of each BVH object
+	std::vector<float> objectBounds;     // scratch for rebuilding
+	std::vector<uint32_t> visibleObjects;
+	uint32_t visibleTotal = 0;
+	uint64_t visibleTriangles = 0;
+
+	/**
+	 * Culling in a compute pass instead (see \c #setGpuCulling()), with the
+	 * pipeline created on first use and the view last culled against kept.
+	 */
+	bool gpuCulling = false;
+	bool chunksStale = true;
+	WGPUComputePipeline cullPipeline = nullptr;
+	WGPUBindGroupLayout cullGroupLayout = nullptr;
+	float cullView[16];
+
+	/**
+	 * Memory handed out by \c #allocGeometry() and not yet committed (indexed
+	 * by ID minus one, with null entries free for reuse).
+	 */
+	struct GeometryRegion
+	{
+		uint8_t* data;
+		size_t size;
+	};
+	std::vector<GeometryRegion> geometry;
+
+	/**
+	 * Meshes being optimized on worker threads (see \c #addMeshOptimized()),
+	 * their batches waiting for the GPU buffers until \c #finishMeshes().
+	 */
+	struct PendingMesh
+	{
+		uint32_t meshId;
+		VertexLayout layout;
+		std::unique_ptr<MeshOptimizer::Job> job;
+	};
+	std::vector<PendingMesh> pendingMeshes;
+
+	/**
+	 * Uniform data for the frame (uploaded once per frame).
+	 */
+	UniformRing uniforms;
 
 	WGPUDevice device;
 	WGPUQueue queue;
-	WGPUSwapChain swapchain;
+	WGPUSwapChain swapchain = nullptr; // none when only culling (see checkGpuCulling())
 
 	std::string triangle_vert_wgsl;
 	std::string triangle_frag_wgsl;
+	std::string cull_comp_wgsl;
 
 	void setupShaders();
+	void createUniformBindGroup();
+	void growUniforms();
+	void processInput();
+	void applyCommands();
+	void finishMeshes();
+	void updateScene();
+	void rebuildBvh();
+	void cullInstances(const float4x4& view);
+	bool selectLods(InstanceBatch& batch, const uint32_t* objects, const float4x4& view);
+	void createCullPipeline();
+	void rebuildChunks();
+	void encodeCulling(WGPUCommandEncoder encoder, uint32_t frustumOffset);
+	void flushBuffers();
+	uint32_t addBatch(Mesh&& mesh, const VertexLayout& layout);
 
 public:
 	Renderer();
@@ -52,14 +240,23 @@ public:
 	inline WGPUDevice getDevice() { return device; }
 	inline WGPUQueue getQueue() { return queue; }
 	inline WGPUSwapChain getSwapChain() { return swapchain; }
+	inline InputQueue& getInput() { return input; }
+	inline CommandStream& getCommands() { return commands; }
+	inline Scene& getScene() { return scene; }
 
 	void setupImGui(GLFWwindow* window);
 	void renderImGui();	
 	void showImGui(bool state);
 	void setColor(float r, float g, float b);
+	void setViewProjection(const float* matrix);
+	void setGpuCulling(bool enabled);
+	inline bool isGpuCulling() { return gpuCulling; }
+	int checkGpuCulling();
 
 	WGPUSwapChain resize(int width, int height);
 	bool render(double time);
+	bool needsRedraw();
+	inline void markDirty() { dirty = true; }
 	
 	void mouseClicked(int button, int action, int x, int y);
 	void keyPressed(int keyCode, int action);
@@ -67,5 +264,19 @@ public:
 	WGPUShaderModule createShader(const char* const code, const char* label = nullptr);
 	WGPUBuffer createBuffer(const void* data, size_t size, WGPUBufferUsage usage);
 	void createPipelineAndBuffers();	
+	WGPURenderPipeline getPipeline(const VertexLayout& layout);
+
+	uint32_t addMesh(const MeshData& data, const VertexLayout& layout, uint32_t lodCount = 1);
+	uint32_t addMeshOptimized(MeshSource&& source, const VertexLayout& layout, uint32_t lodCount = 1);
+	uint32_t addScene(const SceneFile& scene);
+	bool addInstances(uint32_t meshId, std::span<const Transform> instances);
+	void clearInstances(uint32_t meshId);
+	uint32_t addNode(uint32_t parent, uint32_t meshId);
+
+	uint32_t allocGeometry(size_t size);
+	uint8_t* getGeometry(uint32_t id);
+	size_t getGeometrySize(uint32_t id);
+	uint32_t commitGeometry(uint32_t id, uint32_t vertexCount, uint32_t indexCount);
+	void freeGeometry(uint32_t id);
 };
 
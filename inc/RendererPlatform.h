@@ -0,0 +1,36 @@
+/**
+ * \file RendererPlatform.h
+ * Dawn platform hooks for native builds.
+ */
+#pragma once
+
+#include "FileCache.h"
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+/**
+ * Default directory for the persistent shader cache (relative to the working
+ * directory), overridden by \c RENDERER_CACHE_DIR in the environment (where an
+ * empty value disables the cache).
+ */
+#ifndef RENDERER_CACHE_DIR
+#define RENDERER_CACHE_DIR "dawn_cache"
+#endif
+
+/**
+ * Platform installed on the Dawn instance (via \c Instance::SetPlatform()),
+ * supplying a \c FileCache so that backend shader compilation results persist
+ * between launches.
+ */
+class RendererPlatform : public dawn_platform::Platform {
+private:
+	std::unique_ptr<FileCache> cache;
+	std::vector<uint8_t> cachePrint; // fingerprint the cache was opened with
+
+public:
+	RendererPlatform() = default;
+
+	dawn_platform::CachingInterface* GetCachingInterface(const void* fingerprint, size_t fingerprintSize) OVERRIDE;
+};
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "defines.h"
+#include "InputQueue.h"
 #include <stdio.h>
 
 #include "imgui/imgui.h"
@@ -33,6 +34,11 @@ typedef void (*MouseHandler) (int, int, int, int);
 typedef void (*KeyHandler) (int, int);
 typedef void (*ResizeHandler) (int, int);
 
+/**
+ * Function prototype for the on-demand rendering query. See \c #onDemand().
+ */
+typedef bool (*RedrawQuery) ();
+
 class RendererWindow {
 private:
 	
@@ -47,6 +53,8 @@ private:
 	static MouseHandler _NULLABLE mouseClickHandlerClb;
 	static ResizeHandler _NULLABLE resizeHandlerClb;
 	static KeyHandler _NULLABLE keyHandlerClb;
+	static InputQueue* _NULLABLE inputQueue;
+	static RedrawQuery _NULLABLE redrawQueryClb;
 
 public:
 	/**
@@ -85,6 +93,43 @@ public:
 	 */
 	void loop(Handle _NONNULL wHnd, RenderFunc _NULLABLE func = NULLPTR);	
 
+	/**
+	 * Opts into running the redraw function on a separate render thread, with
+	 * the window's event loop staying on the calling thread. Input is then
+	 * pushed to \a queue (for the renderer to consume on the render thread)
+	 * instead of calling the mouse, key and resize handlers.
+	 *
+	 * \note Call before \c #loop(); the redraw function then owns rendering and
+	 * presenting (and any ImGui calls) since nothing else runs on its thread.
+	 *
+	 * \param[in] queue queue receiving input events
+	 * \return \c true if the platform supports a render thread (otherwise nothing changes)
+	 */
+	bool threaded(InputQueue* _NONNULL queue);
+
+	/**
+	 * Opts into rendering only on demand: before each frame \c #loop() asks
+	 * \a func whether anything would change, and if not waits (without
+	 * using the CPU) for input, \c #wake() or a change to be reported. Native
+	 * windows wait on GLFW events, web windows suspend the animation frame
+	 * loop.
+	 *
+	 * \note Input handled by the redraw function itself (ImGui's GLFW backend
+	 * polling the cursor, for example) still wakes the loop, with the next
+	 * frame then rendered regardless of \a func.
+	 *
+	 * \param[in] func returns \c true if the next frame needs rendering (or \c null to render every frame)
+	 */
+	void onDemand(RedrawQuery _NULLABLE func);
+
+	/**
+	 * Wakes a loop waiting for on-demand rendering, so that it asks the
+	 * \c #onDemand() function again. Needed for changes made from outside
+	 * the window's event handling (JavaScript calls, other threads, etc.),
+	 * and safe to call from any thread on native builds.
+	 */
+	static void wake();
+
 	WGPUDevice _NULLABLE createDevice(Handle _NONNULL window, WGPUBackendType type = WGPUBackendType_Force32);
 	WGPUSwapChain _NULLABLE createSwapChain(WGPUDevice _NONNULL device);
 	
@@ -0,0 +1,123 @@
+/**
+ * \file Scene.h
+ * Transform hierarchy stored as flat arrays.
+ */
+#pragma once
+
+#include "defines.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Parent of root nodes.
+ */
+#define SCENE_NO_PARENT UINT32_MAX
+
+/**
+ * Node hierarchy with each property in its own array (structure of arrays)
+ * and every node stored after its parent, so world matrices are brought up to
+ * date in a single forward pass with no tree walking: a node is recomputed if
+ * it or its parent changed, and the pass starts at the first changed node.
+ * Nodes are identified by their index, with \c #sortByDepth() additionally
+ * grouping them level by level (siblings together) once a hierarchy is built.
+ * \n
+ * Each node can be tied to a mesh instance, which the renderer updates
+ * whenever the node's world matrix changes (see \c #getChanged()).
+ */
+class Scene {
+private:
+	std::vector<uint32_t> parents;
+	std::vector<float> translations; // x, y, z per node
+	std::vector<float> rotations;    // quaternion x, y, z, w per node
+	std::vector<float> scales;       // x, y, z per node
+	std::vector<float> worlds;       // column-major 4x4 per node
+	std::vector<uint8_t> dirty;      // local transform changed since the last update
+	std::vector<uint32_t> meshes;    // mesh instanced (zero for none)
+	std::vector<uint32_t> instances; // index of the instance in the mesh's batch
+
+	/**
+	 * Lowest dirty node (or \c #size() if none), where updating starts.
+	 */
+	uint32_t firstDirty = 0;
+
+	/**
+	 * Nodes whose world matrix changed in the last \c #update().
+	 */
+	std::vector<uint32_t> changed;
+
+	inline void markDirty(uint32_t node) {
+		dirty[node] = 1;
+		if (node < firstDirty) {
+			firstDirty = node;
+		}
+	}
+
+public:
+	Scene() = default;
+
+	/**
+	 * Preallocates space for \a count nodes.
+	 */
+	void reserve(size_t count);
+
+	/**
+	 * Removes every node.
+	 */
+	void clear();
+
+	/**
+	 * Adds a node with an identity transform.
+	 *
+	 * \param[in] parent existing node to attach to (or \c #SCENE_NO_PARENT for a root)
+	 * \param[in] mesh mesh the node positions an instance of (zero for none)
+	 * \param[in] instance index of the instance within the mesh's batch
+	 * \return index of the node (or \c #SCENE_NO_PARENT if \a parent doesn't exist)
+	 */
+	uint32_t add(uint32_t parent = SCENE_NO_PARENT, uint32_t mesh = 0, uint32_t instance = 0);
+
+	void setTranslation(uint32_t node, float x, float y, float z);
+	void setRotation(uint32_t node, float x, float y, float z, float w);
+	void setScale(uint32_t node, float x, float y, float z);
+
+	inline size_t size() const { return parents.size(); }
+	inline uint32_t getParent(uint32_t node) const { return parents[node]; }
+	inline uint32_t getMesh(uint32_t node) const { return meshes[node]; }
+	inline uint32_t getInstance(uint32_t node) const { return instances[node]; }
+	inline const float* _NONNULL getTranslation(uint32_t node) const { return &translations[node * 3]; }
+	inline const float* _NONNULL getRotation(uint32_t node) const { return &rotations[node * 4]; }
+	inline const float* _NONNULL getScale(uint32_t node) const { return &scales[node * 3]; }
+
+	/**
+	 * Column-major world matrix, as of the last \c #update().
+	 */
+	inline const float* _NONNULL getWorld(uint32_t node) const { return &worlds[node * 16]; }
+
+	/**
+	 * Whether any node changed since the last \c #update().
+	 */
+	inline bool needsUpdate() const { return firstDirty < parents.size(); }
+
+	/**
+	 * Recomputes the world matrices of changed nodes and their descendants.
+	 *
+	 * \return number of world matrices recomputed
+	 */
+	uint32_t update();
+
+	/**
+	 * Nodes whose world matrix was recomputed by the last \c #update(), in
+	 * index order.
+	 */
+	inline const std::vector<uint32_t>& getChanged() const { return changed; }
+
+	/**
+	 * Reorders the nodes by depth (roots first, then their children, and so
+	 * on, keeping siblings in order), so each level's nodes are contiguous.
+	 * Node indices change, as given by \a remap.
+	 *
+	 * \param[out] remap receives each old node's new index (or \c null if not needed)
+	 */
+	void sortByDepth(std::vector<uint32_t>* _NULLABLE remap = NULLPTR);
+};
@@ -0,0 +1,160 @@
+/**
+ * \file SceneFile.h
+ * Binary scene container, uploaded to the GPU straight from memory.
+ */
+#pragma once
+
+#include "defines.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Alignment of every table and blob in a scene file (from the file's start).
+ */
+#define SCENE_FILE_ALIGN 16
+
+/**
+ * Meshes already encoded in their GPU formats, plus the materials they use,
+ * laid out so nothing is parsed or converted on load: the header points to a
+ * table of meshes, each pointing to its vertex streams and index data, which
+ * are uploaded directly from where they sit (the file's mapping natively, or
+ * the buffer a web build fetched it into). Everything is little-endian, with
+ * the tables and blobs aligned to \c #SCENE_FILE_ALIGN.
+ * \n
+ * Files are written ahead of time by \c #write(), ideally from meshes run
+ * through \c MeshOptimizer (keeping any levels of detail it generated).
+ */
+class SceneFile {
+public:
+	/**
+	 * Header at the start of the file.
+	 */
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t meshCount;
+		uint32_t materialCount;
+		uint64_t meshTable;     // offset of the first Entry
+		uint64_t materialTable; // offset of the first Material
+		uint64_t size;          // total file size
+	};
+	/**
+	 * Surface properties (only the colour is currently used, tinting the
+	 * mesh's instances).
+	 */
+	struct Material {
+		float color[4];
+		float metallic;
+		float roughness;
+		uint32_t reserved[2];
+	};
+	/**
+	 * Mesh table entry. The vertex layout is rebuilt from the encodings and
+	 * components, with the attributes in \c MeshAttrib order.
+	 */
+	struct Entry {
+		uint8_t interleaved;
+		uint8_t indexFormat; // 0 for 16-bit (padded to an even count), 1 for 32-bit
+		uint8_t lodCount;    // number of levels of detail in the level table (zero for a single level of every index)
+		uint8_t reserved;
+		uint8_t encodings[MESH_ATTRIB_COUNT];  // MeshEncoding
+		uint8_t components[MESH_ATTRIB_COUNT]; // zero if the attribute is absent
+		uint32_t vertexCount;
+		uint32_t indexCount; // of every level of detail
+		uint32_t material; // index into the material table (or ~0 for none)
+		float dequantize[6];
+		uint64_t streams[MESH_MAX_STREAMS]; // offset of each vertex stream
+		uint64_t indices;                   // offset of the index data
+		uint64_t lods;                      // offset of the level table (\c lodCount \c MeshLod ranges of the indices)
+	};
+
+private:
+	MappedFile file;
+	const uint8_t* _NULLABLE bytes = NULLPTR;
+	size_t length = 0;
+
+	/**
+	 * Checks the tables and every blob lie within the data.
+	 */
+	bool validate() const;
+
+	inline const Header& header() const { return *reinterpret_cast<const Header*>(bytes); }
+
+public:
+	SceneFile() = default;
+
+	SceneFile(const SceneFile&) = delete;
+	SceneFile& operator=(const SceneFile&) = delete;
+
+	/**
+	 * Maps a scene file (not available in web builds, which have no file
+	 * system, where this always fails).
+	 *
+	 * \param[in] path file to open
+	 * \return \c true if the file was mapped and is valid
+	 */
+	bool open(const char* _NONNULL path);
+
+	/**
+	 * Uses a scene already in memory (e.g. fetched), which isn't copied so
+	 * needs to outlive any uploads.
+	 *
+	 * \param[in] data start of the scene (aligned to at least four bytes)
+	 * \param[in] size size of \a data in bytes
+	 * \return \c true if the data is a valid scene
+	 */
+	bool open(const void* _NONNULL data, size_t size);
+
+	/**
+	 * Unmaps (or forgets) the data.
+	 */
+	void close();
+
+	inline bool isOpen() const { return bytes != NULLPTR; }
+	inline uint32_t getMeshCount() const { return (bytes) ? header().meshCount : 0; }
+	inline uint32_t getMaterialCount() const { return (bytes) ? header().materialCount : 0; }
+
+	/**
+	 * Mesh table entry (\a mesh must be less than \c #getMeshCount()).
+	 */
+	const Entry& getEntry(uint32_t mesh) const;
+
+	/**
+	 * Material used by a mesh (or \c null if it has none).
+	 */
+	const Material* _NULLABLE getMaterial(uint32_t mesh) const;
+
+	/**
+	 * Vertex layout of a mesh.
+	 */
+	VertexLayout getLayout(uint32_t mesh) const;
+
+	/**
+	 * Uploads a mesh's vertex and index data (with every level of detail)
+	 * straight from the scene's memory.
+	 *
+	 * \param[in] renderer renderer owning the device and queue
+	 * \param[in] mesh index of the mesh
+	 * \param[out] out receives the GPU buffers
+	 */
+	void upload(Renderer& renderer, uint32_t mesh, Mesh& out) const;
+
+	/**
+	 * Encodes meshes and writes them to a scene file.
+	 *
+	 * \param[in] path file to write
+	 * \param[in] meshes source meshes
+	 * \param[in] layouts layout to store each mesh in (attributes are reordered into \c MeshAttrib order)
+	 * \param[in] materialIds material index for each mesh (or \c null for none)
+	 * \param[in] meshCount number of meshes
+	 * \param[in] materials material table
+	 * \param[in] materialCount number of materials
+	 * \return \c false if a mesh lacks data for its layout or the file couldn't be written
+	 */
+	static bool write(const char* _NONNULL path, const MeshSource* _NONNULL meshes, const VertexLayout* _NONNULL layouts,
+		const uint32_t* _NULLABLE materialIds, uint32_t meshCount, const Material* _NULLABLE materials, uint32_t materialCount);
+};
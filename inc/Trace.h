@@ -0,0 +1,96 @@
+/**
+ * \file Trace.h
+ * Lightweight trace event recorder with Chrome \c trace_event JSON export.
+ */
+#pragma once
+
+#include "defines.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Number of events each thread's ring holds before the oldest are overwritten.
+ */
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE (1 << 15)
+#endif
+
+/**
+ * Records trace events into per-thread rings. Each thread writes only to its
+ * own ring (allocated on its first event and registered once, without locks)
+ * so recording is a few stores and an atomic index update; \c #dump() reads
+ * every ring and writes the events that weren't overwritten meanwhile.
+ * \n
+ * Recording is off until \c #setEnabled() is called, with markers costing a
+ * single flag test while it's off. Names and categories must be string
+ * literals (or otherwise outlive the recorder), since only the pointers are
+ * kept.
+ */
+namespace Trace {
+	/**
+	 * Turns recording on or off.
+	 */
+	void setEnabled(bool enabled);
+
+	/**
+	 * Whether events are being recorded.
+	 */
+	bool isEnabled();
+
+	/**
+	 * Current time on the trace clock, in seconds.
+	 */
+	double now();
+
+	/**
+	 * Records an event on the calling thread.
+	 *
+	 * \param[in] phase Chrome trace phase (e.g. \c 'B' begin, \c 'E' end, \c 'i' instant)
+	 * \param[in] category category name
+	 * \param[in] name event name
+	 * \param[in] time timestamp on the trace clock (see \c #now())
+	 * \param[in] id optional identifier (pairing async events)
+	 */
+	void record(char phase, const char* _NONNULL category, const char* _NONNULL name, double time, uint64_t id = 0);
+
+	/**
+	 * Writes the recorded events as Chrome \c trace_event JSON (loadable in
+	 * \c chrome://tracing or Perfetto).
+	 *
+	 * \param[in] path file to write
+	 * \return \c true if the file was written
+	 */
+	bool dump(const char* _NONNULL path);
+
+	/**
+	 * Scoped marker, recording a begin event on construction and the matching
+	 * end event on destruction.
+	 */
+	class Scope {
+	private:
+		const char* _NULLABLE name;
+	public:
+		inline Scope(const char* _NONNULL name)
+			: name(isEnabled() ? name : NULLPTR) {
+			if (this->name) {
+				record('B', "Renderer", name, now());
+			}
+		}
+		inline ~Scope() {
+			if (name) {
+				record('E', "Renderer", name, now());
+			}
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+/**
+ * Marks the rest of the enclosing scope as a trace event called \a name.
+ */
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(name)
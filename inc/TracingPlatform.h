@@ -0,0 +1,37 @@
+/**
+ * \file TracingPlatform.h
+ * Dawn platform collecting Dawn's internal trace events.
+ */
+#pragma once
+
+#include "RendererPlatform.h"
+
+/**
+ * Extends \c RendererPlatform by forwarding Dawn's trace events (validation,
+ * command recording, etc.) to the \c Trace recorder, alongside the renderer's
+ * own markers and on the same clock.
+ * \n
+ * Dawn reads the category flags once per event, so these are fixed when the
+ * platform is created: tracing is enabled when \c RENDERER_TRACE is set in the
+ * environment (naming the file \c #dump() writes).
+ */
+class TracingPlatform : public RendererPlatform {
+private:
+	unsigned char flags[4];
+
+public:
+	TracingPlatform();
+
+	/**
+	 * Writes the trace to the file named by \c RENDERER_TRACE.
+	 *
+	 * \return \c true if tracing is enabled and the file was written
+	 */
+	static bool dump();
+
+	const unsigned char* GetTraceCategoryEnabledFlag(dawn_platform::TraceCategory category) OVERRIDE;
+	double MonotonicallyIncreasingTime() OVERRIDE;
+	uint64_t AddTraceEvent(char phase, const unsigned char* categoryGroupEnabled, const char* name, uint64_t id,
+		double timestamp, int numArgs, const char** argNames, const unsigned char* argTypes, const uint64_t* argValues,
+		unsigned char flags) OVERRIDE;
+};
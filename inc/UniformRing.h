@@ -0,0 +1,110 @@
+/**
+ * \file UniformRing.h
+ * Per-frame sub-allocator for uniform data.
+ */
+#pragma once
+
+#include "defines.h"
+
+#include <stdint.h>
+#include <vector>
+
+#include <webgpu/webgpu.h>
+
+/**
+ * Alignment of each slot (WebGPU's minimum dynamic uniform buffer offset
+ * alignment).
+ */
+#define UNIFORM_RING_ALIGNMENT 256
+
+/**
+ * Offset returned by \c #UniformRing::push() when the frame's slots are used
+ * up (see \c #UniformRing::grow()).
+ */
+#define UNIFORM_RING_FULL 0xFFFFFFFFu
+
+/**
+ * One large uniform buffer carved into 256-byte aligned slots each frame.
+ * Uniform data is \e pushed into a CPU-side copy, returning the dynamic offset
+ * to pass to \c wgpuRenderPassEncoderSetBindGroup(), and everything pushed
+ * during the frame goes to the GPU with a single \c wgpuQueueWriteBuffer() in
+ * \c #flush().
+ *
+ * Since queue writes are ordered with submissions the same buffer can be
+ * reused every frame, as long as \c #flush() is called before the frame's
+ * commands are submitted.
+ *
+ * A frame pushing more than fits gets \c #UNIFORM_RING_FULL back, and since
+ * the offsets already handed out may be in use the ring can't grow by itself:
+ * the caller pushes its uniforms before encoding any commands with them, then
+ * on overflow calls \c #grow() and pushes them again.
+ */
+class UniformRing {
+private:
+	WGPUBuffer _NULLABLE buffer = NULLPTR;
+
+	/**
+	 * CPU copy of the slots pushed this frame (sized to the full capacity).
+	 */
+	std::vector<uint8_t> staging;
+
+	/**
+	 * Bytes used this frame (always a multiple of the slot alignment).
+	 */
+	size_t used = 0;
+
+	/**
+	 * Whether a push this frame didn't fit.
+	 */
+	bool overflowed = false;
+
+public:
+	UniformRing() = default;
+	~UniformRing();
+
+	/**
+	 * Creates the GPU buffer.
+	 *
+	 * \param[in] device WebGPU device
+	 * \param[in] capacity total bytes available per frame
+	 */
+	void create(WGPUDevice _NONNULL device, size_t capacity);
+
+	/**
+	 * Releases the GPU buffer.
+	 */
+	void release();
+
+	/**
+	 * Copies \a data into the next free slot.
+	 *
+	 * \param[in] data uniform data
+	 * \param[in] size number of bytes in \a data
+	 * \return dynamic offset of the slot (or \c #UNIFORM_RING_FULL if there's no room left this frame)
+	 */
+	uint32_t push(const void* _NONNULL data, size_t size);
+
+	/**
+	 * Whether a push this frame didn't fit (see \c #grow()).
+	 */
+	inline bool isFull() const { return overflowed; }
+
+	/**
+	 * Doubles the capacity, recreating the GPU buffer (so bind groups over
+	 * \c #getBuffer() need recreating too) and discarding this frame's pushes,
+	 * whose offsets mustn't have been used.
+	 *
+	 * \param[in] device WebGPU device
+	 */
+	void grow(WGPUDevice _NONNULL device);
+
+	/**
+	 * Uploads everything pushed since the last call then starts a new frame.
+	 *
+	 * \param[in] queue queue the frame will be submitted to
+	 */
+	void flush(WGPUQueue _NONNULL queue);
+
+	inline WGPUBuffer _NULLABLE getBuffer() { return buffer; }
+	inline size_t getCapacity() { return staging.size(); }
+};
@@ -0,0 +1,460 @@
+/**
+ * \file VecMath.h
+ * SIMD vector and matrix types for CPU-side transform and culling work.
+ */
+#pragma once
+
+#include "defines.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Backend: WebAssembly SIMD (with -msimd128), SSE (always there on x64), NEON,
+ * or plain floats (also forced by defining VECMATH_NO_SIMD).
+ */
+#if defined(VECMATH_NO_SIMD)
+#define VECMATH_SCALAR
+#elif defined(__wasm_simd128__)
+#define VECMATH_WASM
+#include <wasm_simd128.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VECMATH_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define VECMATH_NEON
+#include <arm_neon.h>
+#else
+#define VECMATH_SCALAR
+#endif
+
+/**
+ * Four floats in a SIMD register (or, without SIMD, an array).
+ */
+struct alignas(16) float4 {
+#if defined(VECMATH_WASM)
+	v128_t v;
+#elif defined(VECMATH_SSE)
+	__m128 v;
+#elif defined(VECMATH_NEON)
+	float32x4_t v;
+#else
+	float v[4];
+#endif
+
+	/**
+	 * Loads four floats (with no alignment requirement).
+	 */
+	static inline float4 load(const float* _NONNULL p) {
+		float4 r;
+#if defined(VECMATH_WASM)
+		r.v = wasm_v128_load(p);
+#elif defined(VECMATH_SSE)
+		r.v = _mm_loadu_ps(p);
+#elif defined(VECMATH_NEON)
+		r.v = vld1q_f32(p);
+#else
+		memcpy(r.v, p, sizeof(r.v));
+#endif
+		return r;
+	}
+
+	/**
+	 * Loads three floats, with \a w as the fourth (so never reading past
+	 * the end of an array of xyz points).
+	 */
+	static inline float4 load3(const float* _NONNULL p, float w) {
+		return set(p[0], p[1], p[2], w);
+	}
+
+	static inline float4 set(float x, float y, float z, float w) {
+		float4 r;
+#if defined(VECMATH_WASM)
+		r.v = wasm_f32x4_make(x, y, z, w);
+#elif defined(VECMATH_SSE)
+		r.v = _mm_setr_ps(x, y, z, w);
+#elif defined(VECMATH_NEON)
+		const float p[4] = {x, y, z, w};
+		r.v = vld1q_f32(p);
+#else
+		r.v[0] = x;
+		r.v[1] = y;
+		r.v[2] = z;
+		r.v[3] = w;
+#endif
+		return r;
+	}
+
+	static inline float4 splat(float x) {
+		float4 r;
+#if defined(VECMATH_WASM)
+		r.v = wasm_f32x4_splat(x);
+#elif defined(VECMATH_SSE)
+		r.v = _mm_set1_ps(x);
+#elif defined(VECMATH_NEON)
+		r.v = vdupq_n_f32(x);
+#else
+		r.v[0] = r.v[1] = r.v[2] = r.v[3] = x;
+#endif
+		return r;
+	}
+
+	/**
+	 * Stores all four floats (with no alignment requirement).
+	 */
+	inline void store(float* _NONNULL p) const {
+#if defined(VECMATH_WASM)
+		wasm_v128_store(p, v);
+#elif defined(VECMATH_SSE)
+		_mm_storeu_ps(p, v);
+#elif defined(VECMATH_NEON)
+		vst1q_f32(p, v);
+#else
+		memcpy(p, v, sizeof(v));
+#endif
+	}
+
+	/**
+	 * Stores the first three floats only.
+	 */
+	inline void store3(float* _NONNULL p) const {
+		float tmp[4];
+		store(tmp);
+		memcpy(p, tmp, 3 * sizeof(float));
+	}
+
+	/**
+	 * Component \a N copied to all four lanes.
+	 */
+	template<int N>
+	inline float4 broadcast() const {
+		float4 r;
+#if defined(VECMATH_WASM)
+		r.v = wasm_i32x4_shuffle(v, v, N, N, N, N);
+#elif defined(VECMATH_SSE)
+		r.v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(N, N, N, N));
+#elif defined(VECMATH_NEON)
+		r.v = vdupq_n_f32(vgetq_lane_f32(v, N));
+#else
+		r.v[0] = r.v[1] = r.v[2] = r.v[3] = v[N];
+#endif
+		return r;
+	}
+};
+
+inline float4 operator+(float4 a, float4 b) {
+	float4 r;
+#if defined(VECMATH_WASM)
+	r.v = wasm_f32x4_add(a.v, b.v);
+#elif defined(VECMATH_SSE)
+	r.v = _mm_add_ps(a.v, b.v);
+#elif defined(VECMATH_NEON)
+	r.v = vaddq_f32(a.v, b.v);
+#else
+	for (int n = 0; n < 4; n++) {
+		r.v[n] = a.v[n] + b.v[n];
+	}
+#endif
+	return r;
+}
+
+inline float4 operator-(float4 a, float4 b) {
+	float4 r;
+#if defined(VECMATH_WASM)
+	r.v = wasm_f32x4_sub(a.v, b.v);
+#elif defined(VECMATH_SSE)
+	r.v = _mm_sub_ps(a.v, b.v);
+#elif defined(VECMATH_NEON)
+	r.v = vsubq_f32(a.v, b.v);
+#else
+	for (int n = 0; n < 4; n++) {
+		r.v[n] = a.v[n] - b.v[n];
+	}
+#endif
+	return r;
+}
+
+inline float4 operator*(float4 a, float4 b) {
+	float4 r;
+#if defined(VECMATH_WASM)
+	r.v = wasm_f32x4_mul(a.v, b.v);
+#elif defined(VECMATH_SSE)
+	r.v = _mm_mul_ps(a.v, b.v);
+#elif defined(VECMATH_NEON)
+	r.v = vmulq_f32(a.v, b.v);
+#else
+	for (int n = 0; n < 4; n++) {
+		r.v[n] = a.v[n] * b.v[n];
+	}
+#endif
+	return r;
+}
+
+/**
+ * \a a x \a b + \a c.
+ */
+inline float4 madd(float4 a, float4 b, float4 c) {
+#if defined(VECMATH_NEON)
+	float4 r;
+	r.v = vmlaq_f32(c.v, a.v, b.v);
+	return r;
+#else
+	return a * b + c;
+#endif
+}
+
+inline float4 vmin(float4 a, float4 b) {
+	float4 r;
+#if defined(VECMATH_WASM)
+	r.v = wasm_f32x4_pmin(a.v, b.v);
+#elif defined(VECMATH_SSE)
+	r.v = _mm_min_ps(a.v, b.v);
+#elif defined(VECMATH_NEON)
+	r.v = vminq_f32(a.v, b.v);
+#else
+	for (int n = 0; n < 4; n++) {
+		r.v[n] = (b.v[n] < a.v[n]) ? b.v[n] : a.v[n];
+	}
+#endif
+	return r;
+}
+
+inline float4 vmax(float4 a, float4 b) {
+	float4 r;
+#if defined(VECMATH_WASM)
+	r.v = wasm_f32x4_pmax(a.v, b.v);
+#elif defined(VECMATH_SSE)
+	r.v = _mm_max_ps(a.v, b.v);
+#elif defined(VECMATH_NEON)
+	r.v = vmaxq_f32(a.v, b.v);
+#else
+	for (int n = 0; n < 4; n++) {
+		r.v[n] = (a.v[n] < b.v[n]) ? b.v[n] : a.v[n];
+	}
+#endif
+	return r;
+}
+
+inline float4 vabs(float4 a) {
+	float4 r;
+#if defined(VECMATH_WASM)
+	r.v = wasm_f32x4_abs(a.v);
+#elif defined(VECMATH_SSE)
+	r.v = _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v);
+#elif defined(VECMATH_NEON)
+	r.v = vabsq_f32(a.v);
+#else
+	for (int n = 0; n < 4; n++) {
+		r.v[n] = (a.v[n] < 0.0f) ? -a.v[n] : a.v[n];
+	}
+#endif
+	return r;
+}
+
+/**
+ * Bit \c n set for each component where \a a is less than \a b.
+ */
+inline int lessMask(float4 a, float4 b) {
+#if defined(VECMATH_WASM)
+	return (int) wasm_i32x4_bitmask(wasm_f32x4_lt(a.v, b.v));
+#elif defined(VECMATH_SSE)
+	return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v));
+#elif defined(VECMATH_NEON)
+	uint32x4_t lt = vcltq_f32(a.v, b.v);
+	return (int) ((vgetq_lane_u32(lt, 0) & 1) | (vgetq_lane_u32(lt, 1) & 2) | (vgetq_lane_u32(lt, 2) & 4) | (vgetq_lane_u32(lt, 3) & 8));
+#else
+	int mask = 0;
+	for (int n = 0; n < 4; n++) {
+		mask |= (a.v[n] < b.v[n]) ? (1 << n) : 0;
+	}
+	return mask;
+#endif
+}
+
+/**
+ * Column-major 4x4 matrix (as WGSL's \c mat4x4<f32> and \c Transform::matrix).
+ */
+struct alignas(16) float4x4 {
+	float4 cols[4];
+
+	static inline float4x4 load(const float* _NONNULL m) {
+		float4x4 r;
+		for (int c = 0; c < 4; c++) {
+			r.cols[c] = float4::load(m + c * 4);
+		}
+		return r;
+	}
+
+	inline void store(float* _NONNULL m) const {
+		for (int c = 0; c < 4; c++) {
+			cols[c].store(m + c * 4);
+		}
+	}
+
+	static inline float4x4 identity() {
+		float4x4 r;
+		r.cols[0] = float4::set(1.0f, 0.0f, 0.0f, 0.0f);
+		r.cols[1] = float4::set(0.0f, 1.0f, 0.0f, 0.0f);
+		r.cols[2] = float4::set(0.0f, 0.0f, 1.0f, 0.0f);
+		r.cols[3] = float4::set(0.0f, 0.0f, 0.0f, 1.0f);
+		return r;
+	}
+
+	/**
+	 * Rotation about the Z axis.
+	 *
+	 * \param[in] radians angle (anticlockwise)
+	 */
+	static float4x4 rotationZ(float radians);
+
+	/**
+	 * Translation, rotation (unit quaternion) then scale, applied scale first.
+	 *
+	 * \param[in] t translation (x, y, z)
+	 * \param[in] q rotation (x, y, z, w)
+	 * \param[in] s scale (x, y, z)
+	 */
+	static float4x4 compose(const float* _NONNULL t, const float* _NONNULL q, const float* _NONNULL s);
+};
+
+inline float4 operator*(const float4x4& m, float4 v) {
+	float4 r = m.cols[0] * v.broadcast<0>();
+	r = madd(m.cols[1], v.broadcast<1>(), r);
+	r = madd(m.cols[2], v.broadcast<2>(), r);
+	return madd(m.cols[3], v.broadcast<3>(), r);
+}
+
+inline float4x4 operator*(const float4x4& a, const float4x4& b) {
+	float4x4 r;
+	for (int c = 0; c < 4; c++) {
+		r.cols[c] = a * b.cols[c];
+	}
+	return r;
+}
+
+/**
+ * Result of \c #Frustum::testBox().
+ */
+enum FrustumTest {
+	FRUSTUM_OUTSIDE,
+	FRUSTUM_INTERSECTS,
+	FRUSTUM_INSIDE,
+};
+
+/**
+ * View frustum as six planes (stored four to a register, so a box is tested
+ * against all of them in two passes).
+ */
+struct Frustum {
+	float4 nx[2], ny[2], nz[2], d[2]; // plane normals and distances (the last two planes always pass)
+	float4 ax[2], ay[2], az[2];       // absolute normals
+
+	/**
+	 * Planes of a view-projection matrix (WebGPU clip space, with \c z from
+	 * zero to \c w).
+	 *
+	 * \param[in] viewProj column-major view-projection
+	 */
+	static Frustum fromMatrix(const float4x4& viewProj);
+
+	/**
+	 * The same planes unpacked, e.g. for a shader.
+	 *
+	 * \param[in] viewProj column-major view-projection
+	 * \param[out] planes receives six planes, each the normal then distance (24 floats)
+	 */
+	static void getPlanes(const float4x4& viewProj, float* _NONNULL planes);
+
+	/**
+	 * Tests an axis-aligned box (by its centre and half-size) against every
+	 * plane.
+	 *
+	 * \param[in] min box minimum (xyz)
+	 * \param[in] max box maximum (xyz)
+	 * \return whether the box is outside, partly inside or wholly inside
+	 */
+	inline FrustumTest testBox(const float* _NONNULL min, const float* _NONNULL max) const {
+		float4 cx = float4::splat((min[0] + max[0]) * 0.5f), ex = float4::splat((max[0] - min[0]) * 0.5f);
+		float4 cy = float4::splat((min[1] + max[1]) * 0.5f), ey = float4::splat((max[1] - min[1]) * 0.5f);
+		float4 cz = float4::splat((min[2] + max[2]) * 0.5f), ez = float4::splat((max[2] - min[2]) * 0.5f);
+		float4 zero = float4::splat(0.0f);
+		int partial = 0;
+		for (int n = 0; n < 2; n++) {
+			float4 dist = madd(nx[n], cx, madd(ny[n], cy, madd(nz[n], cz, d[n])));
+			float4 radius = madd(ax[n], ex, madd(ay[n], ey, az[n] * ez));
+			if (lessMask(dist + radius, zero)) {
+				return FRUSTUM_OUTSIDE;
+			}
+			partial |= lessMask(dist - radius, zero);
+		}
+		return (partial) ? FRUSTUM_INTERSECTS : FRUSTUM_INSIDE;
+	}
+};
+
+/**
+ * Batched kernels, working directly on arrays of floats (so on vertex data,
+ * instance buffers, etc.) with no alignment requirements.
+ */
+namespace VecMath {
+	/**
+	 * Transforms points (as positions, so including the translation).
+	 *
+	 * \param[in] m transform
+	 * \param[in] points \a count xyz points
+	 * \param[out] out receives the transformed points (may be \a points)
+	 * \param[in] count number of points
+	 */
+	void transformPoints(const float4x4& m, const float* _NONNULL points, float* _NONNULL out, size_t count);
+
+	/**
+	 * Multiplies one matrix by many (\c out[n] = \a a x \c b[n]), e.g. a
+	 * parent or view matrix applied to a run of local transforms.
+	 *
+	 * \param[in] a left-hand matrix
+	 * \param[in] b \a count column-major matrices, \a stride floats apart
+	 * \param[out] out receives the products, \a stride floats apart (may be \a b)
+	 * \param[in] count number of matrices
+	 * \param[in] stride floats from the start of one matrix to the next (16 if packed)
+	 */
+	void multiplyMatrices(const float4x4& a, const float* _NONNULL b, float* _NONNULL out, size_t count, size_t stride = 16);
+
+	/**
+	 * Multiplies many matrices by one (\c out[n] = \c a[n] x \a b), e.g.
+	 * model matrices followed by a mesh's dequantization.
+	 *
+	 * \param[in] a \a count column-major matrices, \a stride floats apart
+	 * \param[in] b right-hand matrix
+	 * \param[out] out receives the products, \a stride floats apart (may be \a a)
+	 * \param[in] count number of matrices
+	 * \param[in] stride floats from the start of one matrix to the next (16 if packed)
+	 */
+	void multiplyMatrices(const float* _NONNULL a, const float4x4& b, float* _NONNULL out, size_t count, size_t stride = 16);
+
+	/**
+	 * Bounding box of a run of points.
+	 *
+	 * \param[in] points \a count points of \a components floats each
+	 * \param[in] count number of points (at least one)
+	 * \param[in] components floats per point (1 to 4)
+	 * \param[out] min receives the minimum of each component (\a components floats)
+	 * \param[out] max receives the maximum of each component
+	 * \param[in] stride floats from the start of one point to the next (zero if packed)
+	 */
+	void computeBounds(const float* _NONNULL points, size_t count, size_t components, float* _NONNULL min, float* _NONNULL max,
+		size_t stride = 0);
+
+	/**
+	 * World bounding boxes of a local box placed by each of many transforms
+	 * (transforming the box's centre and extents, Arvo's method).
+	 *
+	 * \param[in] matrices \a count column-major transforms, \a stride floats apart
+	 * \param[in] min local box minimum (xyz)
+	 * \param[in] max local box maximum (xyz)
+	 * \param[out] outMin receives each box's minimum (\a count xyz triples)
+	 * \param[out] outMax receives each box's maximum
+	 * \param[in] count number of transforms
+	 * \param[in] stride floats from the start of one matrix to the next (16 if packed)
+	 */
+	void transformBounds(const float* _NONNULL matrices, const float* _NONNULL min, const float* _NONNULL max,
+		float* _NONNULL outMin, float* _NONNULL outMax, size_t count, size_t stride = 16);
+}
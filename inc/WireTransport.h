@@ -0,0 +1,162 @@
+/**
+ * \file WireTransport.h
+ * In-process \c dawn_wire transport with a dedicated GPU thread.
+ */
+#pragma once
+
+#include "defines.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <dawn/dawn_proc_table.h>
+#include <dawn_wire/WireClient.h>
+#include <dawn_wire/WireServer.h>
+
+/**
+ * Default size of each direction's ring buffer (in bytes, a power of two).
+ */
+#ifndef WIRE_RING_SIZE
+#define WIRE_RING_SIZE (4 * 1024 * 1024)
+#endif
+
+/**
+ * Single-producer/single-consumer byte ring implementing Dawn's command
+ * serializer. The producer reserves command space in the ring directly (no
+ * intermediate copy), grouping commands into chunks that never straddle the
+ * end of the ring; \c #Flush() publishes the open chunk to the consumer. When
+ * the ring is full the producer waits for the consumer to catch up.
+ * \n
+ * If the consumer may itself be waiting on a reply ring the producer reads,
+ * the producer stashes those replies while it waits (so neither side blocks
+ * the other), handling them on its next \c #consume().
+ */
+class WireRing : public dawn_wire::CommandSerializer {
+private:
+	std::vector<char> data;
+	uint64_t capacity;
+	// producer side
+	uint64_t writePos = 0;
+	uint64_t chunk;
+	// shared
+	std::atomic<uint64_t> committed = 0;
+	std::atomic<uint64_t> consumed = 0;
+	std::atomic<uint32_t>* _NULLABLE signal;
+	WireRing* _NULLABLE replies;
+	// consumer side
+	std::vector<char> stashed;
+
+public:
+	/**
+	 * Creates the ring.
+	 *
+	 * \param[in] size capacity in bytes (a power of two)
+	 * \param[in] signal optional counter bumped (and notified) on each flush, for a consumer waiting on it
+	 * \param[in] replies optional ring carrying the consumer's replies (with a \a signal, also used to wake the producer), stashed while waiting for space
+	 */
+	WireRing(size_t size, std::atomic<uint32_t>* _NULLABLE signal = NULLPTR, WireRing* _NULLABLE replies = NULLPTR);
+
+	void* GetCmdSpace(size_t size) OVERRIDE;
+	bool Flush() OVERRIDE;
+	size_t GetMaximumAllocationSize() const OVERRIDE;
+
+	/**
+	 * Passes every stashed then published chunk to \a handler (called only by
+	 * the consumer thread).
+	 *
+	 * \param[in] handler wire client or server decoding the commands
+	 * \return \c false if the handler rejected any commands
+	 */
+	bool consume(dawn_wire::CommandHandler& handler);
+
+	/**
+	 * Copies every published chunk out of the ring, freeing its space, to be
+	 * handled by the next \c #consume() (called only by the consumer thread,
+	 * when it can't handle commands yet).
+	 */
+	void stash();
+
+private:
+	/**
+	 * Waits until \a size bytes past the write position are free, stashing
+	 * any replies meanwhile.
+	 */
+	void waitForSpace(uint64_t size);
+	/**
+	 * Chunk header at ring position \a pos.
+	 */
+	uint64_t& header(uint64_t pos);
+};
+
+/**
+ * Runs a Dawn device behind \c dawn_wire within the same process: the calling
+ * thread records through a \c WireClient (all \c wgpu* calls are serialized
+ * into a ring) while a dedicated GPU thread decodes them with a
+ * \c WireServer, calling into Dawn proper. Results and callbacks come back
+ * through a second ring.
+ * \n
+ * Commands are sent on each \c wgpuSwapChainPresent() (the client's proc is
+ * hooked to flush after it), or whenever the ring fills. Only one transport
+ * may be active at a time.
+ */
+class WireTransport {
+private:
+	std::atomic<uint32_t> signal = 0;
+	std::atomic<uint32_t> clientSignal = 0;
+	std::atomic<bool> running = true;
+	std::atomic<bool> stopped = false;
+	WireRing toServer;
+	WireRing toClient;
+	DawnProcTable nativeProcs;
+	DawnProcTable clientProcs;
+	std::unique_ptr<dawn_wire::WireServer> server;
+	std::unique_ptr<dawn_wire::WireClient> client;
+	std::thread thread;
+
+public:
+	/**
+	 * Starts the GPU thread serving \a device. The native procs must already be
+	 * installed; afterwards only the GPU thread may call them.
+	 *
+	 * \param[in] device native Dawn device
+	 * \param[in] ringSize size of each direction's ring buffer
+	 */
+	WireTransport(WGPUDevice _NONNULL device, size_t ringSize = WIRE_RING_SIZE);
+	/**
+	 * Sends any remaining commands then stops the GPU thread.
+	 */
+	~WireTransport();
+
+	WireTransport(const WireTransport&) = delete;
+	WireTransport& operator=(const WireTransport&) = delete;
+
+	/**
+	 * Client-side device, to use in place of the native device.
+	 */
+	WGPUDevice _NONNULL getDevice() const;
+
+	/**
+	 * Client-side procs, to install with \c dawnProcSetProcs().
+	 */
+	inline const DawnProcTable& getProcs() const { return clientProcs; }
+
+	/**
+	 * The active transport, if any.
+	 */
+	static WireTransport* _NULLABLE getActive();
+
+	/**
+	 * Sends the commands recorded so far to the GPU thread and handles any
+	 * results it returned (running their callbacks on the calling thread).
+	 */
+	void flush();
+
+private:
+	/**
+	 * GPU thread: decodes commands as they arrive until stopped.
+	 */
+	void run();
+};
@@ -17,19 +17,38 @@
 
 #include "imgui.h"
 #include "imgui_impl_wgpu.h"
+#include "Trace.h"
 #include <limits.h>
 #include <webgpu/webgpu.h>
 
 #define HAS_EMSCRIPTEN_VERSION(major, minor, tiny) (__EMSCRIPTEN_major__ > (major) || (__EMSCRIPTEN_major__ == (major) && __EMSCRIPTEN_minor__ > (minor)) || (__EMSCRIPTEN_major__ == (major) && __EMSCRIPTEN_minor__ == (minor) && __EMSCRIPTEN_tiny__ >= (tiny)))
 
-// Dear ImGui prototypes from imgui_internal.h
-extern ImGuiID ImHashData(const void* data_p, size_t data_size, ImU32 seed = 0);
-
 // WebGPU data
 static WGPUDevice               g_wgpuDevice = NULL;
 static WGPUTextureFormat        g_renderTargetFormat = WGPUTextureFormat_Undefined;
 static WGPURenderPipeline       g_pipelineState = NULL;
 
+// Per-texture bind groups in an open-addressed (linear probing) hash table keyed by texture view. Every
+// IMGUI_WGPU_BIND_GROUP_SWEEP_FRAMES frames, entries not drawn with in the last IMGUI_WGPU_BIND_GROUP_MAX_AGE are released.
+#define IMGUI_WGPU_BIND_GROUP_MIN_CAPACITY  64
+#define IMGUI_WGPU_BIND_GROUP_MAX_AGE       120
+#define IMGUI_WGPU_BIND_GROUP_SWEEP_FRAMES  60
+
+struct ImageBindGroupEntry
+{
+    ImTextureID     TextureId;
+    WGPUBindGroup   BindGroup;                  // NULL marks an empty slot
+    unsigned int    LastUsed;                   // Frame index this was last drawn with
+};
+
+struct ImageBindGroupCache
+{
+    ImageBindGroupEntry*    Entries;
+    unsigned int            Capacity;           // Power of two (zero until first used)
+    unsigned int            Count;
+    unsigned int            LastSweep;          // Frame index of the last eviction sweep
+};
+
 struct RenderResources
 {
     WGPUTexture         FontTexture;            // Font texture
@@ -38,7 +57,7 @@ struct RenderResources
     WGPUBuffer          Uniforms;               // Shader uniforms
     WGPUBindGroup       CommonBindGroup;        // Resources bind-group to bind the common resources to pipeline
     WGPUBindGroupLayout ImageBindGroupLayout;   // Bind group layout for image textures
-    ImGuiStorage        ImageBindGroups;        // Resources bind-group to bind the font/image resources to pipeline (this is a key->value map)
+    ImageBindGroupCache ImageBindGroups;        // Resources bind-groups to bind the image resources to pipeline (other than the font)
     WGPUBindGroup       ImageBindGroup;         // Default font-resource of Dear ImGui
 };
 static RenderResources  g_resources;
@@ -47,19 +66,47 @@ struct FrameResources
 {
     WGPUBuffer  IndexBuffer;
     WGPUBuffer  VertexBuffer;
-    ImDrawIdx*  IndexBufferHost;
-    ImDrawVert* VertexBufferHost;
     int         IndexBufferSize;
     int         VertexBufferSize;
+    int         IndexHighWater;         // Most indices used since the last shrink check
+    int         VertexHighWater;        // Most vertices used since the last shrink check
+    int         FramesSinceShrinkCheck;
 };
+
+// Vertex/index buffers start at these sizes and double as needed. Every IMGUI_WGPU_SHRINK_FRAMES uses of a frame's buffers,
+// any left larger than IMGUI_WGPU_SHRINK_RATIO times the most it needed are reallocated (with 2x headroom over that).
+#define IMGUI_WGPU_MIN_VERTICES     5000
+#define IMGUI_WGPU_MIN_INDICES      10000
+#define IMGUI_WGPU_SHRINK_FRAMES    300
+#define IMGUI_WGPU_SHRINK_RATIO     4
+
+// Each draw list's indices start 4-byte aligned in the index buffer (see ImGui_ImplWGPU_RenderDrawData), padding up to one index per list
+#define IMGUI_WGPU_IDX_PADDING      (sizeof(ImDrawIdx) == 2 ? 1 : 0)
+#define IMGUI_WGPU_ALIGN_IDX(n)     (((n) + IMGUI_WGPU_IDX_PADDING) & ~IMGUI_WGPU_IDX_PADDING)
+static ImGui_ImplWGPU_Stats g_stats;
 static FrameResources*  g_pFrameResources = NULL;
 static unsigned int     g_numFramesInFlight = 0;
 static unsigned int     g_frameIndex = UINT_MAX;
 
+// What a frame's draw loop encoded, kept so an identical next frame can be drawn again from the same buffers (this
+// isn't a WGPURenderBundle since bundles can't set the scissor rect, which changes between ImGui draws)
+struct ReplayDrawCall
+{
+    WGPUBindGroup   BindGroup;          // Owned by the image bind group cache (see ImGui_ImplWGPU_RenderDrawData)
+    uint32_t        ClipRect[4];        // Scissor x, y, width and height
+    uint32_t        ElemCount;
+    uint32_t        FirstIndex;
+    int32_t         BaseVertex;
+};
+static ImVector<ReplayDrawCall> g_replayDrawCalls;
+static ImU64            g_replayHash = 0;       // Hash of the draw data g_replayDrawCalls came from (zero if there's nothing to replay)
+static FrameResources*  g_replayFrame = NULL;   // Buffers still holding that draw data's vertices and indices
+
 struct Uniforms
 {
     float MVP[4][4];
 };
+static Uniforms         g_lastUniforms;         // Copy of what was last written to g_resources.Uniforms (zeroed when the buffer is created)
 
 //-----------------------------------------------------------------------------
 // SHADERS
@@ -173,18 +220,6 @@ static uint32_t __glsl_shader_frag_spv[] =
     0x0003003e,0x00000009,0x00000022,0x000100fd,0x00010038
 };
 
-static void SafeRelease(ImDrawIdx*& res)
-{
-    if (res)
-        delete[] res;
-    res = NULL;
-}
-static void SafeRelease(ImDrawVert*& res)
-{
-    if (res)
-        delete[] res;
-    res = NULL;
-}
 static void SafeRelease(WGPUBindGroupLayout& res)
 {
     if (res)
@@ -234,6 +269,16 @@ static void SafeRelease(WGPUTexture& res)
     res = NULL;
 }
 
+static void SafeRelease(ImageBindGroupCache& res)
+{
+    for (unsigned int i = 0; i < res.Capacity; i++)
+        SafeRelease(res.Entries[i].BindGroup);
+    IM_FREE(res.Entries);
+    res.Entries = NULL;
+    res.Capacity = 0;
+    res.Count = 0;
+}
+
 static void SafeRelease(RenderResources& res)
 {
     SafeRelease(res.FontTexture);
@@ -243,14 +288,17 @@ static void SafeRelease(RenderResources& res)
     SafeRelease(res.CommonBindGroup);
     SafeRelease(res.ImageBindGroupLayout);
     SafeRelease(res.ImageBindGroup);
+    SafeRelease(res.ImageBindGroups);
 };
 
 static void SafeRelease(FrameResources& res)
 {
+    if (res.IndexBuffer)
+        g_stats.AllocatedBytes -= res.IndexBufferSize * sizeof(ImDrawIdx);
+    if (res.VertexBuffer)
+        g_stats.AllocatedBytes -= res.VertexBufferSize * sizeof(ImDrawVert);
     SafeRelease(res.IndexBuffer);
     SafeRelease(res.VertexBuffer);
-    SafeRelease(res.IndexBufferHost);
-    SafeRelease(res.VertexBufferHost);
 }
 
 static WGPUProgrammableStageDescriptor ImGui_ImplWGPU_CreateShaderModule(uint32_t* binary_data, uint32_t binary_data_size)
@@ -280,6 +328,79 @@ static WGPUBindGroup ImGui_ImplWGPU_CreateImageBindGroup(WGPUBindGroupLayout lay
     return wgpuDeviceCreateBindGroup(g_wgpuDevice, &image_bg_descriptor);
 }
 
+// Fibonacci hash of the texture view's address, as a slot index for a table of the given capacity
+static unsigned int ImGui_ImplWGPU_HashTextureId(ImTextureID texture_id, unsigned int capacity)
+{
+    return (unsigned int)(((ImU64)(uintptr_t)texture_id * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+}
+
+// Move the cache's entries into a table of a new capacity (also closing any gaps left by evicted entries)
+static void ImGui_ImplWGPU_RehashImageBindGroups(ImageBindGroupCache& cache, unsigned int capacity)
+{
+    ImageBindGroupEntry* entries = (ImageBindGroupEntry*)IM_ALLOC(capacity * sizeof(ImageBindGroupEntry));
+    memset(entries, 0, capacity * sizeof(ImageBindGroupEntry));
+    for (unsigned int i = 0; i < cache.Capacity; i++)
+    {
+        if (cache.Entries[i].BindGroup == NULL)
+            continue;
+        unsigned int slot = ImGui_ImplWGPU_HashTextureId(cache.Entries[i].TextureId, capacity);
+        while (entries[slot].BindGroup != NULL)
+            slot = (slot + 1) & (capacity - 1);
+        entries[slot] = cache.Entries[i];
+    }
+    IM_FREE(cache.Entries);
+    cache.Entries = entries;
+    cache.Capacity = capacity;
+}
+
+// Bind group for a user texture, created on first use (and kept while it's drawn with)
+static WGPUBindGroup ImGui_ImplWGPU_GetImageBindGroup(ImTextureID texture_id)
+{
+    if (texture_id == (ImTextureID)g_resources.FontTextureView)
+        return g_resources.ImageBindGroup;
+
+    ImageBindGroupCache& cache = g_resources.ImageBindGroups;
+    if (cache.Capacity == 0 || (cache.Count + 1) * 2 > cache.Capacity)
+        ImGui_ImplWGPU_RehashImageBindGroups(cache, cache.Capacity ? cache.Capacity * 2 : IMGUI_WGPU_BIND_GROUP_MIN_CAPACITY);
+
+    unsigned int slot = ImGui_ImplWGPU_HashTextureId(texture_id, cache.Capacity);
+    while (cache.Entries[slot].BindGroup != NULL && cache.Entries[slot].TextureId != texture_id)
+        slot = (slot + 1) & (cache.Capacity - 1);
+    ImageBindGroupEntry& entry = cache.Entries[slot];
+    if (entry.BindGroup == NULL)
+    {
+        entry.TextureId = texture_id;
+        entry.BindGroup = ImGui_ImplWGPU_CreateImageBindGroup(g_resources.ImageBindGroupLayout, (WGPUTextureView)texture_id);
+        cache.Count++;
+    }
+    entry.LastUsed = g_frameIndex;
+    return entry.BindGroup;
+}
+
+// Release the bind groups of textures no longer drawn with, shrinking the table if it's become sparse
+static void ImGui_ImplWGPU_SweepImageBindGroups()
+{
+    ImageBindGroupCache& cache = g_resources.ImageBindGroups;
+    cache.LastSweep = g_frameIndex;
+    unsigned int evicted = 0;
+    for (unsigned int i = 0; i < cache.Capacity; i++)
+    {
+        ImageBindGroupEntry& entry = cache.Entries[i];
+        if (entry.BindGroup != NULL && g_frameIndex - entry.LastUsed > IMGUI_WGPU_BIND_GROUP_MAX_AGE)
+        {
+            SafeRelease(entry.BindGroup);
+            evicted++;
+        }
+    }
+    if (evicted == 0)
+        return;
+    cache.Count -= evicted;
+    unsigned int capacity = IMGUI_WGPU_BIND_GROUP_MIN_CAPACITY;
+    while (capacity < cache.Count * 4)
+        capacity *= 2;
+    ImGui_ImplWGPU_RehashImageBindGroups(cache, capacity < cache.Capacity ? capacity : cache.Capacity);
+}
+
 static void ImGui_ImplWGPU_SetupRenderState(ImDrawData* draw_data, WGPURenderPassEncoder ctx, FrameResources* fr)
 {
     // Setup orthographic projection matrix into our constant buffer
@@ -296,7 +417,12 @@ static void ImGui_ImplWGPU_SetupRenderState(ImDrawData* draw_data, WGPURenderPas
             { 0.0f,         0.0f,           0.5f,       0.0f },
             { (R+L)/(L-R),  (T+B)/(B-T),    0.5f,       1.0f },
         };
-        wgpuQueueWriteBuffer(wgpuDeviceGetDefaultQueue(g_wgpuDevice), g_resources.Uniforms, 0, mvp, sizeof(mvp));
+        // The projection only changes with the display size/position, so skip the upload when the buffer already holds it
+        if (memcmp(g_lastUniforms.MVP, mvp, sizeof(mvp)) != 0)
+        {
+            memcpy(g_lastUniforms.MVP, mvp, sizeof(mvp));
+            wgpuQueueWriteBuffer(wgpuDeviceGetDefaultQueue(g_wgpuDevice), g_resources.Uniforms, 0, mvp, sizeof(mvp));
+        }
     }
 
     // Setup viewport
@@ -315,76 +441,225 @@ static void ImGui_ImplWGPU_SetupRenderState(ImDrawData* draw_data, WGPURenderPas
     wgpuRenderPassEncoderSetBlendColor(ctx, &blend_color);
 }
 
+// Smallest of capacity, 2*capacity, 4*capacity... holding needed elements
+static int ImGui_ImplWGPU_ArenaCapacity(int capacity, int needed)
+{
+    while (capacity < needed)
+        capacity *= 2;
+    return capacity;
+}
+
+// (Re)create a frame's vertex buffer holding capacity vertices
+static bool ImGui_ImplWGPU_CreateVertexArena(FrameResources* fr, int capacity)
+{
+    if (fr->VertexBuffer)
+        g_stats.AllocatedBytes -= fr->VertexBufferSize * sizeof(ImDrawVert);
+    SafeRelease(fr->VertexBuffer);
+    fr->VertexBufferSize = capacity;
+
+    WGPUBufferDescriptor vb_desc =
+    {
+        NULL,
+        "Dear ImGui Vertex buffer",
+        WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
+        fr->VertexBufferSize * sizeof(ImDrawVert),
+        false
+    };
+    fr->VertexBuffer = wgpuDeviceCreateBuffer(g_wgpuDevice, &vb_desc);
+    if (!fr->VertexBuffer)
+        return false;
+    g_stats.AllocatedBytes += vb_desc.size;
+    return true;
+}
+
+// (Re)create a frame's index buffer holding capacity indices
+static bool ImGui_ImplWGPU_CreateIndexArena(FrameResources* fr, int capacity)
+{
+    if (fr->IndexBuffer)
+        g_stats.AllocatedBytes -= fr->IndexBufferSize * sizeof(ImDrawIdx);
+    SafeRelease(fr->IndexBuffer);
+    fr->IndexBufferSize = capacity;
+
+    WGPUBufferDescriptor ib_desc =
+    {
+        NULL,
+        "Dear ImGui Index buffer",
+        WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
+        fr->IndexBufferSize * sizeof(ImDrawIdx),
+        false
+    };
+    fr->IndexBuffer = wgpuDeviceCreateBuffer(g_wgpuDevice, &ib_desc);
+    if (!fr->IndexBuffer)
+        return false;
+    g_stats.AllocatedBytes += ib_desc.size;
+    return true;
+}
+
 // Render function
+// Hash of everything that ends up on screen: the display rect, each list's vertices and indices, and each command's
+// draw arguments. Zero means the frame can't be replayed (user callbacks may do anything, so their frames never are).
+// Words are mixed FNV-style in four independent lanes, since this runs over every vertex each frame.
+static ImU64 ImGui_ImplWGPU_HashBytes(ImU64 hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    const ImU64 prime = 0x100000001B3ULL;
+    ImU64 lanes[4] = { hash, hash ^ 0x9E3779B97F4A7C15ULL, hash ^ 0xC2B2AE3D27D4EB4FULL, hash ^ 0x165667B19E3779F9ULL };
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (int lane = 0; lane < 4; lane++)
+        {
+            ImU64 word;
+            memcpy(&word, bytes + i + lane * 8, sizeof(word));
+            lanes[lane] = (lanes[lane] ^ word) * prime;
+        }
+    }
+    hash = ((lanes[0] * prime ^ lanes[1]) * prime ^ lanes[2]) * prime ^ lanes[3];
+    for (; i < size; i++)
+        hash = (hash ^ bytes[i]) * prime;
+    return (hash ^ size) * prime;
+}
+
+static ImU64 ImGui_ImplWGPU_HashDrawData(const ImDrawData* draw_data)
+{
+    ImU64 hash = 0xCBF29CE484222325ULL;
+    hash = ImGui_ImplWGPU_HashBytes(hash, &draw_data->DisplayPos, sizeof(draw_data->DisplayPos));
+    hash = ImGui_ImplWGPU_HashBytes(hash, &draw_data->DisplaySize, sizeof(draw_data->DisplaySize));
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        hash = ImGui_ImplWGPU_HashBytes(hash, cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+        hash = ImGui_ImplWGPU_HashBytes(hash, cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+        {
+            // Field by field, since ImDrawCmd has padding
+            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+            if (pcmd->UserCallback != NULL)
+                return 0;
+            unsigned int args[3] = { pcmd->VtxOffset, pcmd->IdxOffset, pcmd->ElemCount };
+            hash = ImGui_ImplWGPU_HashBytes(hash, &pcmd->ClipRect, sizeof(pcmd->ClipRect));
+            hash = ImGui_ImplWGPU_HashBytes(hash, &pcmd->TextureId, sizeof(pcmd->TextureId));
+            hash = ImGui_ImplWGPU_HashBytes(hash, args, sizeof(args));
+        }
+    }
+    return hash != 0 ? hash : 1;
+}
+
+// Draw the previous frame again: its buffers are untouched and the draw calls are already resolved
+static void ImGui_ImplWGPU_ReplayDrawCalls(ImDrawData* draw_data, WGPURenderPassEncoder pass_encoder)
+{
+    ImGui_ImplWGPU_SetupRenderState(draw_data, pass_encoder, g_replayFrame);
+    WGPUBindGroup bound = NULL;
+    for (const ReplayDrawCall* call = g_replayDrawCalls.begin(); call != g_replayDrawCalls.end(); call++)
+    {
+        if (call->BindGroup != bound)
+        {
+            wgpuRenderPassEncoderSetBindGroup(pass_encoder, 1, call->BindGroup, 0, NULL);
+            bound = call->BindGroup;
+        }
+        wgpuRenderPassEncoderSetScissorRect(pass_encoder, call->ClipRect[0], call->ClipRect[1], call->ClipRect[2], call->ClipRect[3]);
+        wgpuRenderPassEncoderDrawIndexed(pass_encoder, call->ElemCount, 1, call->FirstIndex, call->BaseVertex, 0);
+    }
+    g_stats.ReplayedFrames++;
+}
+
 // (this used to be set in io.RenderDrawListsFn and called by ImGui::Render(), but you can now call this directly from your main loop)
 void ImGui_ImplWGPU_RenderDrawData(ImDrawData* draw_data, WGPURenderPassEncoder pass_encoder)
 {
+    TRACE_SCOPE("ImGui_ImplWGPU_RenderDrawData");
+
     // Avoid rendering when minimized
     if (draw_data->DisplaySize.x <= 0.0f || draw_data->DisplaySize.y <= 0.0f)
         return;
 
+    // An unchanged frame is drawn from the buffers already holding it, without uploading or walking the draw lists.
+    // The bind groups it uses can't be swept meanwhile, since only frames that go on below advance g_frameIndex.
+    ImU64 hash = ImGui_ImplWGPU_HashDrawData(draw_data);
+    if (hash != 0 && hash == g_replayHash)
+    {
+        ImGui_ImplWGPU_ReplayDrawCalls(draw_data, pass_encoder);
+        return;
+    }
+    g_replayHash = 0;
+    g_replayDrawCalls.resize(0);
+
     // FIXME: Assuming that this only gets called once per frame!
     // If not, we can't just re-allocate the IB or VB, we'll have to do a proper allocator.
     g_frameIndex = g_frameIndex + 1;
     FrameResources* fr = &g_pFrameResources[g_frameIndex % g_numFramesInFlight];
+    if (g_frameIndex - g_resources.ImageBindGroups.LastSweep >= IMGUI_WGPU_BIND_GROUP_SWEEP_FRAMES)
+        ImGui_ImplWGPU_SweepImageBindGroups();
+
+    // Track how much of the buffers is used, periodically giving back space that went unused
+    if (fr->VertexHighWater < draw_data->TotalVtxCount)
+        fr->VertexHighWater = draw_data->TotalVtxCount;
+    int total_idx_count = draw_data->TotalIdxCount + IMGUI_WGPU_IDX_PADDING * draw_data->CmdListsCount;
+    if (fr->IndexHighWater < total_idx_count)
+        fr->IndexHighWater = total_idx_count;
+    size_t frame_bytes = draw_data->TotalVtxCount * sizeof(ImDrawVert) + draw_data->TotalIdxCount * sizeof(ImDrawIdx);
+    if (g_stats.HighWaterBytes < frame_bytes)
+        g_stats.HighWaterBytes = frame_bytes;
+    if (++fr->FramesSinceShrinkCheck >= IMGUI_WGPU_SHRINK_FRAMES)
+    {
+        int vtx_capacity = ImGui_ImplWGPU_ArenaCapacity(IMGUI_WGPU_MIN_VERTICES, fr->VertexHighWater * 2);
+        if (fr->VertexBuffer && fr->VertexBufferSize / IMGUI_WGPU_SHRINK_RATIO > fr->VertexHighWater && vtx_capacity < fr->VertexBufferSize)
+        {
+            if (!ImGui_ImplWGPU_CreateVertexArena(fr, vtx_capacity))
+                return;
+            g_stats.Shrinks++;
+        }
+        int idx_capacity = ImGui_ImplWGPU_ArenaCapacity(IMGUI_WGPU_MIN_INDICES, fr->IndexHighWater * 2);
+        if (fr->IndexBuffer && fr->IndexBufferSize / IMGUI_WGPU_SHRINK_RATIO > fr->IndexHighWater && idx_capacity < fr->IndexBufferSize)
+        {
+            if (!ImGui_ImplWGPU_CreateIndexArena(fr, idx_capacity))
+                return;
+            g_stats.Shrinks++;
+        }
+        fr->VertexHighWater = 0;
+        fr->IndexHighWater = 0;
+        fr->FramesSinceShrinkCheck = 0;
+    }
 
-    // Create and grow vertex/index buffers if needed
+    // Create and grow vertex/index buffers if needed (doubling, so steady-state frames never allocate)
     if (fr->VertexBuffer == NULL || fr->VertexBufferSize < draw_data->TotalVtxCount)
     {
-        SafeRelease(fr->VertexBuffer);
-        SafeRelease(fr->VertexBufferHost);
-        fr->VertexBufferSize = draw_data->TotalVtxCount + 5000;
-
-        WGPUBufferDescriptor vb_desc =
-        {
-            NULL,
-            "Dear ImGui Vertex buffer",
-            WGPUBufferUsage_CopyDst | WGPUBufferUsage_Vertex,
-            fr->VertexBufferSize * sizeof(ImDrawVert),
-            false
-        };
-        fr->VertexBuffer = wgpuDeviceCreateBuffer(g_wgpuDevice, &vb_desc);
-        if (!fr->VertexBuffer)
+        if (!ImGui_ImplWGPU_CreateVertexArena(fr, ImGui_ImplWGPU_ArenaCapacity(fr->VertexBufferSize, draw_data->TotalVtxCount)))
             return;
-
-        fr->VertexBufferHost = new ImDrawVert[fr->VertexBufferSize];
+        g_stats.Grows++;
     }
-    if (fr->IndexBuffer == NULL || fr->IndexBufferSize < draw_data->TotalIdxCount)
+    if (fr->IndexBuffer == NULL || fr->IndexBufferSize < total_idx_count)
     {
-        SafeRelease(fr->IndexBuffer);
-        SafeRelease(fr->IndexBufferHost);
-        fr->IndexBufferSize = draw_data->TotalIdxCount + 10000;
-
-        WGPUBufferDescriptor ib_desc =
-        {
-            NULL,
-            "Dear ImGui Index buffer",
-            WGPUBufferUsage_CopyDst | WGPUBufferUsage_Index,
-            fr->IndexBufferSize * sizeof(ImDrawIdx),
-            false
-        };
-        fr->IndexBuffer = wgpuDeviceCreateBuffer(g_wgpuDevice, &ib_desc);
-        if (!fr->IndexBuffer)
+        if (!ImGui_ImplWGPU_CreateIndexArena(fr, ImGui_ImplWGPU_ArenaCapacity(fr->IndexBufferSize, total_idx_count)))
             return;
-
-        fr->IndexBufferHost = new ImDrawIdx[fr->IndexBufferSize];
+        g_stats.Grows++;
     }
 
-    // Upload vertex/index data into a single contiguous GPU buffer
-    ImDrawVert* vtx_dst = (ImDrawVert*)fr->VertexBufferHost;
-    ImDrawIdx* idx_dst = (ImDrawIdx*)fr->IndexBufferHost;
+    // Upload each list's vertex/index data straight into the GPU buffers at their running offsets (with no host-side
+    // staging copy). Writes need 4-byte aligned offsets and sizes, which vertices always have, but each list's 16-bit
+    // indices start on an even index and an odd trailing index is written separately, padded.
+    WGPUQueue queue = wgpuDeviceGetDefaultQueue(g_wgpuDevice);
+    uint64_t vtx_offset = 0;
+    uint64_t idx_offset = 0;
     for (int n = 0; n < draw_data->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
-        memcpy(vtx_dst, cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
-        memcpy(idx_dst, cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
-        vtx_dst += cmd_list->VtxBuffer.Size;
-        idx_dst += cmd_list->IdxBuffer.Size;
+        uint64_t vtx_size = cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+        if (vtx_size > 0)
+            wgpuQueueWriteBuffer(queue, fr->VertexBuffer, vtx_offset, cmd_list->VtxBuffer.Data, vtx_size);
+        vtx_offset += vtx_size;
+
+        idx_offset = IMGUI_WGPU_ALIGN_IDX(idx_offset);
+        uint64_t idx_size = cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+        uint64_t idx_aligned = idx_size & ~3;
+        if (idx_aligned > 0)
+            wgpuQueueWriteBuffer(queue, fr->IndexBuffer, idx_offset * sizeof(ImDrawIdx), cmd_list->IdxBuffer.Data, idx_aligned);
+        if (idx_aligned < idx_size)
+        {
+            ImDrawIdx last[2] = { cmd_list->IdxBuffer.back(), 0 };
+            wgpuQueueWriteBuffer(queue, fr->IndexBuffer, idx_offset * sizeof(ImDrawIdx) + idx_aligned, last, sizeof(last));
+        }
+        idx_offset += cmd_list->IdxBuffer.Size;
     }
-    int64_t vb_write_size = ((char*)vtx_dst - (char*)fr->VertexBufferHost + 3) & ~3;
-    int64_t ib_write_size = ((char*)idx_dst - (char*)fr->IndexBufferHost  + 3) & ~3;
-    wgpuQueueWriteBuffer(wgpuDeviceGetDefaultQueue(g_wgpuDevice), fr->VertexBuffer, 0, fr->VertexBufferHost, vb_write_size);
-    wgpuQueueWriteBuffer(wgpuDeviceGetDefaultQueue(g_wgpuDevice), fr->IndexBuffer,  0, fr->IndexBufferHost,  ib_write_size);
 
     // Setup desired render state
     ImGui_ImplWGPU_SetupRenderState(draw_data, pass_encoder, fr);
@@ -397,6 +672,7 @@ void ImGui_ImplWGPU_RenderDrawData(ImDrawData* draw_data, WGPURenderPassEncoder
     for (int n = 0; n < draw_data->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        global_idx_offset = IMGUI_WGPU_ALIGN_IDX(global_idx_offset);
         for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
         {
             const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
@@ -412,17 +688,9 @@ void ImGui_ImplWGPU_RenderDrawData(ImDrawData* draw_data, WGPURenderPassEncoder
             else
             {
                 // Bind custom texture
-                auto bind_group = g_resources.ImageBindGroups.GetVoidPtr(ImHashData(&pcmd->TextureId, sizeof(ImTextureID)));
-                if (bind_group)
-                {
-                    wgpuRenderPassEncoderSetBindGroup(pass_encoder, 1, (WGPUBindGroup)bind_group, 0, NULL);
-                }
-                else
-                {
-                    WGPUBindGroup image_bind_group = ImGui_ImplWGPU_CreateImageBindGroup(g_resources.ImageBindGroupLayout, (WGPUTextureView)pcmd->TextureId);
-                    g_resources.ImageBindGroups.SetVoidPtr(ImHashData(&pcmd->TextureId, sizeof(ImTextureID)), image_bind_group);
-                    wgpuRenderPassEncoderSetBindGroup(pass_encoder, 1, image_bind_group, 0, NULL);
-                }
+                ReplayDrawCall call;
+                call.BindGroup = ImGui_ImplWGPU_GetImageBindGroup(pcmd->TextureId);
+                wgpuRenderPassEncoderSetBindGroup(pass_encoder, 1, call.BindGroup, 0, NULL);
 
                 // Apply Scissor, Bind texture, Draw
                 uint32_t clip_rect[4];
@@ -430,13 +698,26 @@ void ImGui_ImplWGPU_RenderDrawData(ImDrawData* draw_data, WGPURenderPassEncoder
                 clip_rect[1] = static_cast<uint32_t>(pcmd->ClipRect.y - clip_off.y);
                 clip_rect[2] = static_cast<uint32_t>(pcmd->ClipRect.z - clip_off.x);
                 clip_rect[3] = static_cast<uint32_t>(pcmd->ClipRect.w - clip_off.y);
-                wgpuRenderPassEncoderSetScissorRect(pass_encoder, clip_rect[0], clip_rect[1], clip_rect[2] - clip_rect[0], clip_rect[3] - clip_rect[1]);
-                wgpuRenderPassEncoderDrawIndexed(pass_encoder, pcmd->ElemCount, 1, pcmd->IdxOffset + global_idx_offset, pcmd->VtxOffset + global_vtx_offset, 0);
+                call.ClipRect[0] = clip_rect[0];
+                call.ClipRect[1] = clip_rect[1];
+                call.ClipRect[2] = clip_rect[2] - clip_rect[0];
+                call.ClipRect[3] = clip_rect[3] - clip_rect[1];
+                call.ElemCount = pcmd->ElemCount;
+                call.FirstIndex = pcmd->IdxOffset + global_idx_offset;
+                call.BaseVertex = pcmd->VtxOffset + global_vtx_offset;
+                wgpuRenderPassEncoderSetScissorRect(pass_encoder, call.ClipRect[0], call.ClipRect[1], call.ClipRect[2], call.ClipRect[3]);
+                wgpuRenderPassEncoderDrawIndexed(pass_encoder, call.ElemCount, 1, call.FirstIndex, call.BaseVertex, 0);
+                if (hash != 0)
+                    g_replayDrawCalls.push_back(call);
             }
         }
         global_idx_offset += cmd_list->IdxBuffer.Size;
         global_vtx_offset += cmd_list->VtxBuffer.Size;
     }
+
+    // Keep what was just drawn for the next frame, should it turn out the same
+    g_replayHash = hash;
+    g_replayFrame = fr;
 }
 
 static WGPUBuffer ImGui_ImplWGPU_CreateBufferFromData(const WGPUDevice& device, const void* data, uint64_t size, WGPUBufferUsage usage)
@@ -547,6 +828,7 @@ static void ImGui_ImplWGPU_CreateUniformBuffer()
         false
     };
     g_resources.Uniforms = wgpuDeviceCreateBuffer(g_wgpuDevice, &ub_desc);
+    memset(&g_lastUniforms, 0, sizeof(g_lastUniforms));
 }
 
 bool ImGui_ImplWGPU_CreateDeviceObjects()
@@ -705,7 +987,6 @@ bool ImGui_ImplWGPU_CreateDeviceObjects()
 
     WGPUBindGroup image_bind_group = ImGui_ImplWGPU_CreateImageBindGroup(bg_layouts[1], g_resources.FontTextureView);
     g_resources.ImageBindGroup = image_bind_group;
-    g_resources.ImageBindGroups.SetVoidPtr(ImHashData(&g_resources.FontTextureView, sizeof(ImTextureID)), image_bind_group);
 
     SafeRelease(vertex_shader_desc.module);
     SafeRelease(pixel_shader_desc.module);
@@ -727,6 +1008,9 @@ void ImGui_ImplWGPU_InvalidateDeviceObjects()
 
     for (unsigned int i = 0; i < g_numFramesInFlight; i++)
         SafeRelease(g_pFrameResources[i]);
+    g_replayDrawCalls.clear();
+    g_replayHash = 0;
+    g_replayFrame = NULL;
 }
 
 bool ImGui_ImplWGPU_Init(WGPUDevice device, int num_frames_in_flight, WGPUTextureFormat rt_format)
@@ -748,7 +1032,7 @@ bool ImGui_ImplWGPU_Init(WGPUDevice device, int num_frames_in_flight, WGPUTextur
     g_resources.Uniforms = NULL;
     g_resources.CommonBindGroup = NULL;
     g_resources.ImageBindGroupLayout = NULL;
-    g_resources.ImageBindGroups.Data.reserve(100);
+    g_resources.ImageBindGroups = ImageBindGroupCache();
     g_resources.ImageBindGroup = NULL;
 
     // Create buffers with a default size (they will later be grown as needed)
@@ -757,10 +1041,11 @@ bool ImGui_ImplWGPU_Init(WGPUDevice device, int num_frames_in_flight, WGPUTextur
         FrameResources* fr = &g_pFrameResources[i];
         fr->IndexBuffer = NULL;
         fr->VertexBuffer = NULL;
-        fr->IndexBufferHost = NULL;
-        fr->VertexBufferHost = NULL;
-        fr->IndexBufferSize = 10000;
-        fr->VertexBufferSize = 5000;
+        fr->IndexBufferSize = IMGUI_WGPU_MIN_INDICES;
+        fr->VertexBufferSize = IMGUI_WGPU_MIN_VERTICES;
+        fr->IndexHighWater = 0;
+        fr->VertexHighWater = 0;
+        fr->FramesSinceShrinkCheck = 0;
     }
 
     return true;
@@ -776,6 +1061,11 @@ void ImGui_ImplWGPU_Shutdown()
     g_frameIndex = UINT_MAX;
 }
 
+const ImGui_ImplWGPU_Stats* ImGui_ImplWGPU_GetStats()
+{
+    return &g_stats;
+}
+
 void ImGui_ImplWGPU_NewFrame()
 {
     if (!g_pipelineState)
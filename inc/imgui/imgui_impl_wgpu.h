@@ -22,3 +22,15 @@ IMGUI_IMPL_API void ImGui_ImplWGPU_RenderDrawData(ImDrawData* draw_data, WGPURen
 // Use if you want to reset your rendering device without losing Dear ImGui state.
 IMGUI_IMPL_API void ImGui_ImplWGPU_InvalidateDeviceObjects();
 IMGUI_IMPL_API bool ImGui_ImplWGPU_CreateDeviceObjects();
+
+// Counters for the per-frame vertex/index buffers (grown geometrically, shrunk after a quiet period) and for frames
+// replayed without uploading or walking the draw lists (when the draw data is unchanged), e.g. for telemetry
+struct ImGui_ImplWGPU_Stats
+{
+    unsigned int    Grows;              // Buffer allocations made to fit a frame (including the first)
+    unsigned int    Shrinks;            // Buffer allocations made to give back unused space
+    size_t          AllocatedBytes;     // GPU bytes currently allocated across all frames in flight
+    size_t          HighWaterBytes;     // Most vertex+index bytes needed by a single frame
+    unsigned int    ReplayedFrames;     // Frames drawn again from the previous frame's buffers and draw calls
+};
+IMGUI_IMPL_API const ImGui_ImplWGPU_Stats* ImGui_ImplWGPU_GetStats();
@@ -2,6 +2,11 @@
 #include "RendererWindow.h"
 #include "Renderer.h"
 #include <stdio.h>
+#include <stdlib.h>
+
+#ifndef __EMSCRIPTEN__
+#include "TracingPlatform.h"
+#endif
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
@@ -22,6 +27,14 @@ bool render(double time)
 	return renderer->render(time);
 }	
 
+/**
+  * Callback passed to the window when rendering on demand.
+  */
+bool needsRedraw()
+{
+	return renderer->needsRedraw();
+}
+
 /**
   * Callback resize function passed to the window.
   */
@@ -80,13 +93,41 @@ int main(int /*argc*/, char* /*argv*/[]) {
 		renderer->setDevice(wgpu_device);
 		renderer->setQueue(queue);
 		renderer->setSwapChain(wgpu_swap_chain);
+
+		// optionally render on a separate thread, with input passed through a queue
+		// (ImGui then can't use its GLFW backend, which would run on the wrong thread)
+		if (getenv("RENDERER_THREADED") && window->threaded(&renderer->getInput())) {
+			win = NULLPTR;
+		}
 		renderer->setupImGui(win);
 		renderer->createPipelineAndBuffers();
 
+#ifndef __EMSCRIPTEN__
+		// optionally load a scene, uploaded straight from the file's mapping
+		if (const char* path = getenv("RENDERER_SCENE")) {
+			SceneFile scene;
+			if (scene.open(path)) {
+				renderer->addScene(scene);
+			} else {
+				printf("Unable to load scene: %s\n", path);
+			}
+		}
+#endif
+
+		// optionally render only frames that would change (sleeping otherwise)
+		if (getenv("RENDERER_ON_DEMAND")) {
+			window->onDemand(needsRedraw);
+		}
+
 		// show the window & run the main loop
 		window->show(wHnd);
 		window->loop(wHnd, render);
 
+#ifndef __EMSCRIPTEN__
+		// write out the trace if RENDERER_TRACE named a file
+		TracingPlatform::dump();
+#endif
+
 		// destroy the window
 		window->destroy(wHnd);
 	}
@@ -101,6 +142,7 @@ int main(int /*argc*/, char* /*argv*/[]) {
   */
 void showImGui(bool state) {
 	renderer->showImGui(state);
+	RendererWindow::wake();
 }
 
 /**
@@ -108,11 +150,144 @@ void showImGui(bool state) {
   */
 void setColor(float r, float g, float b) {
 	renderer->setColor(r, g, b);
+	RendererWindow::wake();
+}
+
+/**
+  * JS exposed handle function returning, from "Module.getCommandBuffer()", a Uint8Array view onto the memory that
+  * batched commands are written to (see CommandStream.h for the format). The view is invalidated should the WASM
+  * memory grow, so should be fetched again if its byteLength drops to zero:
+  *
+  *	const u8 = Module.getCommandBuffer();
+  *	const cmds = new DataView(u8.buffer, u8.byteOffset, u8.byteLength);
+  *	cmds.setUint32(0, 2, true);  // CMD_SET_COLOR
+  *	cmds.setFloat32(4, 1.0, true);
+  *	...
+  *	Module.flushCommands(1);
+  */
+val getCommandBuffer() {
+	CommandStream& commands = renderer->getCommands();
+	return val(typed_memory_view(commands.capacity(), commands.data()));
+}
+
+/**
+  * JS exposed handle function that allows to call "Module.flushCommands(count)" from the web app, taking the first
+  * count commands written to the command buffer (applied at the start of the next frame).
+  */
+unsigned flushCommands(unsigned count) {
+	unsigned accepted = renderer->getCommands().flush(count);
+	RendererWindow::wake();
+	return accepted;
+}
+
+/**
+  * JS exposed handle function that allows to call "Module.allocGeometry(bytes)" from the web app, returning
+  * { id, bytes } (or null if out of memory) where bytes is a Uint8Array view onto WASM memory to fill with vertices
+  * then indices, e.g. streaming a fetched mesh straight into it. Should the WASM memory grow before the view is
+  * filled it needs fetching again with "Module.getGeometry(id)".
+  */
+val allocGeometry(unsigned bytes) {
+	uint32_t id = renderer->allocGeometry(bytes);
+	if (id == 0) {
+		return val::null();
+	}
+	val geometry = val::object();
+	geometry.set("id", id);
+	geometry.set("bytes", val(typed_memory_view(bytes, renderer->getGeometry(id))));
+	return geometry;
+}
+
+/**
+  * JS exposed handle function that allows to call "Module.getGeometry(id)" from the web app, returning a fresh view
+  * onto the memory from "Module.allocGeometry()" (or null if already committed or freed).
+  */
+val getGeometry(unsigned id) {
+	uint8_t* data = renderer->getGeometry(id);
+	return (data) ? val(typed_memory_view(renderer->getGeometrySize(id), data)) : val::null();
+}
+
+/**
+  * JS exposed handle function that allows to call "Module.commitGeometry(id, vertexCount, indexCount)" from the web
+  * app, uploading the memory from "Module.allocGeometry()" (x, y, r, g, b float vertices followed by 32-bit indices)
+  * directly to the GPU as a new mesh, then freeing it. Returns the mesh ID (or "Module.INVALID_MESH" if the counts
+  * don't fit).
+  */
+unsigned commitGeometry(unsigned id, unsigned vertexCount, unsigned indexCount) {
+	unsigned meshId = renderer->commitGeometry(id, vertexCount, indexCount);
+	RendererWindow::wake();
+	return meshId;
+}
+
+/**
+  * JS exposed handle function that allows to call "Module.freeGeometry(id)" from the web app, abandoning memory from
+  * "Module.allocGeometry()" without uploading it.
+  */
+void freeGeometry(unsigned id) {
+	renderer->freeGeometry(id);
+}
+
+/**
+  * JS exposed handle function that allows to call "Module.loadScene(id)" from the web app, adding every mesh in a
+  * scene file (see SceneFile.h) fetched into memory from "Module.allocGeometry()", uploaded directly from there, then
+  * freeing it. The response can be streamed straight in as it arrives, e.g.:
+  *
+  *	const res = await fetch('scene.bin');
+  *	const geom = Module.allocGeometry(Number(res.headers.get('Content-Length')));
+  *	const reader = res.body.getReader();
+  *	for (let pos = 0, r; !(r = await reader.read()).done; pos += r.value.length) {
+  *		Module.getGeometry(geom.id).set(r.value, pos);
+  *	}
+  *	const firstMesh = Module.loadScene(geom.id);
+  *
+  * Returns the ID of the first mesh (the rest following consecutively) or "Module.INVALID_MESH" if the scene isn't
+  * valid.
+  */
+unsigned loadScene(unsigned id) {
+	uint8_t* data = renderer->getGeometry(id);
+	SceneFile scene;
+	unsigned meshId = RENDERER_INVALID_MESH;
+	if (data && scene.open(data, renderer->getGeometrySize(id))) {
+		meshId = renderer->addScene(scene);
+	} else {
+		printf("Invalid scene %u\n", id);
+	}
+	scene.close();
+	renderer->freeGeometry(id);
+	RendererWindow::wake();
+	return meshId;
+}
+
+/**
+  * JS exposed handle function that allows to call "Module.setViewProjection(matrix)" from the web app, with a
+  * column-major 4x4 matrix as an array of 16 numbers (or null to go back to the default flat view). Instances outside
+  * its frustum are culled before drawing.
+  */
+void setViewProjection(val matrix) {
+	if (matrix.isNull() || matrix.isUndefined()) {
+		renderer->setViewProjection(nullptr);
+	} else {
+		std::vector<float> values = vecFromJSArray<float>(matrix);
+		if (values.size() == 16) {
+			renderer->setViewProjection(values.data());
+		} else {
+			printf("Invalid view-projection (%u values)\n", (unsigned) values.size());
+		}
+	}
+	RendererWindow::wake();
 }
 
 EMSCRIPTEN_BINDINGS(my_module) {
 	function("showImGui", &showImGui);
 	function("setColor", &setColor);
+	function("getCommandBuffer", &getCommandBuffer);
+	function("flushCommands", &flushCommands);
+	function("allocGeometry", &allocGeometry);
+	function("getGeometry", &getGeometry);
+	function("commitGeometry", &commitGeometry);
+	constant("INVALID_MESH", RENDERER_INVALID_MESH);
+	function("freeGeometry", &freeGeometry);
+	function("loadScene", &loadScene);
+	function("setViewProjection", &setViewProjection);
 }
 #endif // __EMSCRIPTEN__
 // =================== "API to JS" END =====================
@@ -0,0 +1,164 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <float.h>
+
+void Bvh::build(const float* mins, const float* maxs, uint32_t count)
+{
+	nodes.clear();
+	boxes.resize((size_t) count * 6);
+	order.resize(count);
+	leaves.resize(count);
+	for (uint32_t n = 0; n < count; n++) {
+		for (int c = 0; c < 3; c++) {
+			boxes[n * 6 + c]     = mins[n * 3 + c];
+			boxes[n * 6 + 3 + c] = maxs[n * 3 + c];
+		}
+		order[n] = n;
+	}
+	if (count > 0) {
+		nodes.reserve((count / BVH_LEAF_SIZE + 1) * 2);
+		split(0, count, 0);
+	}
+	dirty.assign(nodes.size(), 0);
+	firstDirty = (uint32_t) nodes.size();
+}
+
+/**
+ * Adds a node over \a count objects from \a first in the order, splitting at
+ * the median centre along the axis the centres spread most (so the tree is
+ * balanced, whatever the distribution).
+ *
+ * \return index of the node
+ */
+uint32_t Bvh::split(uint32_t first, uint32_t count, uint32_t parent)
+{
+	uint32_t index = (uint32_t) nodes.size();
+	nodes.push_back({});
+	nodes[index].first  = first;
+	nodes[index].count  = count;
+	nodes[index].parent = parent;
+	fit(nodes[index]);
+	if (count <= BVH_LEAF_SIZE) {
+		for (uint32_t n = first; n < first + count; n++) {
+			leaves[order[n]] = index;
+		}
+		return index;
+	}
+
+	float lo[3] = { FLT_MAX,  FLT_MAX,  FLT_MAX};
+	float hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+	for (uint32_t n = first; n < first + count; n++) {
+		const float* box = &boxes[order[n] * 6];
+		for (int c = 0; c < 3; c++) {
+			float centre = box[c] + box[3 + c];
+			lo[c] = std::min(lo[c], centre);
+			hi[c] = std::max(hi[c], centre);
+		}
+	}
+	int axis = 0;
+	for (int c = 1; c < 3; c++) {
+		if (hi[c] - lo[c] > hi[axis] - lo[axis]) {
+			axis = c;
+		}
+	}
+	uint32_t half = count / 2;
+	std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+		[this, axis](uint32_t a, uint32_t b) {
+			return boxes[a * 6 + axis] + boxes[a * 6 + 3 + axis] < boxes[b * 6 + axis] + boxes[b * 6 + 3 + axis];
+		});
+
+	split(first, half, index);
+	uint32_t right = split(first + half, count - half, index);
+	nodes[index].right = right;
+	return index;
+}
+
+/**
+ * Sets a node's box to enclose its objects' boxes.
+ */
+void Bvh::fit(Node& node) const
+{
+	float4 lo = float4::splat( FLT_MAX);
+	float4 hi = float4::splat(-FLT_MAX);
+	for (uint32_t n = node.first; n < node.first + node.count; n++) {
+		const float* box = &boxes[order[n] * 6];
+		lo = vmin(lo, float4::load3(box, 0.0f));
+		hi = vmax(hi, float4::load3(box + 3, 0.0f));
+	}
+	lo.store3(node.min);
+	hi.store3(node.max);
+}
+
+void Bvh::update(uint32_t object, const float* min, const float* max)
+{
+	float* box = &boxes[object * 6];
+	for (int c = 0; c < 3; c++) {
+		box[c]     = min[c];
+		box[3 + c] = max[c];
+	}
+	// flag the path to the root, stopping where it's already flagged
+	uint32_t node = leaves[object];
+	while (!dirty[node]) {
+		dirty[node] = 1;
+		firstDirty = std::min(firstDirty, node);
+		if (node == 0) {
+			break;
+		}
+		node = nodes[node].parent;
+	}
+}
+
+void Bvh::refit()
+{
+	// children come after their parents, so going backwards refits them first
+	uint32_t count = (uint32_t) nodes.size();
+	for (uint32_t n = count; n-- > firstDirty;) {
+		if (!dirty[n]) {
+			continue;
+		}
+		Node& node = nodes[n];
+		if (node.right == 0) {
+			fit(node);
+		} else {
+			const Node& left  = nodes[n + 1];
+			const Node& right = nodes[node.right];
+			for (int c = 0; c < 3; c++) {
+				node.min[c] = std::min(left.min[c], right.min[c]);
+				node.max[c] = std::max(left.max[c], right.max[c]);
+			}
+		}
+		dirty[n] = 0;
+	}
+	firstDirty = count;
+}
+
+void Bvh::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+	if (nodes.empty()) {
+		return;
+	}
+	uint32_t stack[64];
+	uint32_t depth = 0;
+	stack[depth++] = 0;
+	while (depth > 0) {
+		const Node& node = nodes[stack[--depth]];
+		FrustumTest test = frustum.testBox(node.min, node.max);
+		if (test == FRUSTUM_OUTSIDE) {
+			continue;
+		}
+		if (test == FRUSTUM_INSIDE) {
+			visible.insert(visible.end(), order.begin() + node.first, order.begin() + node.first + node.count);
+		} else if (node.right == 0) {
+			for (uint32_t n = node.first; n < node.first + node.count; n++) {
+				const float* box = &boxes[order[n] * 6];
+				if (frustum.testBox(box, box + 3) != FRUSTUM_OUTSIDE) {
+					visible.push_back(order[n]);
+				}
+			}
+		} else {
+			stack[depth++] = node.right;
+			stack[depth++] = (uint32_t) (&node - nodes.data()) + 1;
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#include "CommandStream.h"
+
+#include <cstdio>
+
+/**
+ * Argument words per opcode (indexed by \c CommandOp, zero being invalid).
+ */
+static const uint8_t ARG_WORDS[CMD_COUNT] = {
+	0, // invalid
+	1, // CMD_SHOW_IMGUI
+	3, // CMD_SET_COLOR
+	4, // CMD_SET_VERTEX_COLOR
+	4, // CMD_SET_CLEAR_COLOR
+	1, // CMD_SET_SPEED
+};
+
+uint32_t CommandStream::flush(uint32_t count)
+{
+	const size_t words = sizeof(staging) / sizeof(staging[0]);
+	size_t pos = 0;
+	uint32_t n = 0;
+	for (; n < count; n++) {
+		if (pos >= words || staging[pos] == 0 || staging[pos] >= CMD_COUNT || pos + 1 + ARG_WORDS[staging[pos]] > words) {
+			printf("Malformed command %u of %u (opcode %u)\n", n, count, (pos < words) ? staging[pos] : 0);
+			break;
+		}
+		pos += 1 + ARG_WORDS[staging[pos]];
+	}
+	pending.insert(pending.end(), staging, staging + pos);
+	return n;
+}
+
+bool CommandStream::next(Command& cmd)
+{
+	if (read >= pending.size()) {
+		// keep the capacity for the next batch
+		pending.resize(0);
+		read = 0;
+		return false;
+	}
+	cmd.op = static_cast<CommandOp>(pending[read++]);
+	for (unsigned n = 0; n < ARG_WORDS[cmd.op]; n++) {
+		cmd.args[n].u = pending[read++];
+	}
+	return true;
+}
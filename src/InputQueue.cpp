@@ -0,0 +1,21 @@
+#include "InputQueue.h"
+
+bool InputQueue::push(const InputEvent& event) {
+	size_t next = tail.load(std::memory_order_relaxed);
+	if (next - head.load(std::memory_order_acquire) >= INPUT_QUEUE_SIZE) {
+		return false;
+	}
+	events[next % INPUT_QUEUE_SIZE] = event;
+	tail.store(next + 1, std::memory_order_release);
+	return true;
+}
+
+bool InputQueue::pop(InputEvent& event) {
+	size_t next = head.load(std::memory_order_relaxed);
+	if (next == tail.load(std::memory_order_acquire)) {
+		return false;
+	}
+	event = events[next % INPUT_QUEUE_SIZE];
+	head.store(next + 1, std::memory_order_release);
+	return true;
+}
@@ -0,0 +1,175 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#if defined(_WIN32)
+
+/**
+ * Common open and map for both modes (a zero \a size keeps the existing size).
+ */
+static bool mapFile(const char* path, bool write, size_t size, void*& file, void*& mapping, void*& ptr, size_t& len) {
+	HANDLE hFile = CreateFileA(path, (write) ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, FILE_SHARE_READ, NULL,
+		(write) ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (write) {
+		fileSize.QuadPart = (LONGLONG) size;
+		if (!SetFilePointerEx(hFile, fileSize, NULL, FILE_BEGIN) || !SetEndOfFile(hFile)) {
+			CloseHandle(hFile);
+			return false;
+		}
+	} else if (!GetFileSizeEx(hFile, &fileSize)) {
+		CloseHandle(hFile);
+		return false;
+	}
+	if (fileSize.QuadPart == 0) {
+		CloseHandle(hFile);
+		return false;
+	}
+	HANDLE hMapping = CreateFileMappingA(hFile, NULL, (write) ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+	if (!hMapping) {
+		CloseHandle(hFile);
+		return false;
+	}
+	ptr = MapViewOfFile(hMapping, (write) ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+	if (!ptr) {
+		CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return false;
+	}
+	file = hFile;
+	mapping = hMapping;
+	len = (size_t) fileSize.QuadPart;
+	return true;
+}
+
+bool MappedFile::open(const char* path)
+{
+	close();
+	return mapFile(path, false, 0, file, mapping, ptr, len);
+}
+
+bool MappedFile::create(const char* path, size_t size)
+{
+	close();
+	return mapFile(path, true, size, file, mapping, ptr, len);
+}
+
+void MappedFile::flush()
+{
+	if (ptr) {
+		FlushViewOfFile(ptr, len);
+	}
+}
+
+void MappedFile::close()
+{
+	if (ptr) {
+		UnmapViewOfFile(ptr);
+		CloseHandle(mapping);
+		CloseHandle(file);
+	}
+	ptr = NULLPTR;
+	file = NULLPTR;
+	mapping = NULLPTR;
+	len = 0;
+}
+
+#elif defined(__EMSCRIPTEN__)
+
+bool MappedFile::open(const char* /*path*/)
+{
+	return false;
+}
+
+bool MappedFile::create(const char* /*path*/, size_t /*size*/)
+{
+	return false;
+}
+
+void MappedFile::flush()
+{
+}
+
+void MappedFile::close()
+{
+}
+
+#else
+
+bool MappedFile::open(const char* path)
+{
+	close();
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close();
+		return false;
+	}
+	void* mem = mmap(NULLPTR, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (mem == MAP_FAILED) {
+		close();
+		return false;
+	}
+	ptr = mem;
+	len = (size_t) info.st_size;
+	return true;
+}
+
+bool MappedFile::create(const char* path, size_t size)
+{
+	close();
+	fd = ::open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0 || size == 0 || ftruncate(fd, (off_t) size) != 0) {
+		close();
+		return false;
+	}
+	void* mem = mmap(NULLPTR, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mem == MAP_FAILED) {
+		close();
+		return false;
+	}
+	ptr = mem;
+	len = size;
+	return true;
+}
+
+void MappedFile::flush()
+{
+	if (ptr) {
+		msync(ptr, len, MS_ASYNC);
+	}
+}
+
+void MappedFile::close()
+{
+	if (ptr) {
+		munmap(ptr, len);
+	}
+	if (fd >= 0) {
+		::close(fd);
+	}
+	ptr = NULLPTR;
+	fd = -1;
+	len = 0;
+}
+
+#endif
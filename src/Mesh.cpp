@@ -0,0 +1,414 @@
+#include "Mesh.h"
+#include "Renderer.h"
+#include "VecMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+//****************************** VertexLayout ********************************/
+
+/**
+ * Vertex format and size for an encoding, widening to the formats WebGPU has
+ * (there are no three component or 8-bit two component normalized formats
+ * that keep attributes four byte aligned).
+ *
+ * \param[in] encoding storage type
+ * \param[in] components number of source components
+ * \param[out] format receives the vertex format
+ * \return number of components stored
+ */
+static uint32_t resolveFormat(MeshEncoding encoding, uint32_t components, WGPUVertexFormat& format) {
+	switch (encoding) {
+	case MESH_UNORM16:
+		format = (components <= 2) ? WGPUVertexFormat_UShort2Norm : WGPUVertexFormat_UShort4Norm;
+		return (components <= 2) ? 2 : 4;
+	case MESH_SNORM16:
+		format = (components <= 2) ? WGPUVertexFormat_Short2Norm : WGPUVertexFormat_Short4Norm;
+		return (components <= 2) ? 2 : 4;
+	case MESH_UNORM8:
+		format = WGPUVertexFormat_UChar4Norm;
+		return 4;
+	case MESH_SNORM8:
+		format = WGPUVertexFormat_Char4Norm;
+		return 4;
+	default:
+		static const WGPUVertexFormat floats[] = {
+			WGPUVertexFormat_Float, WGPUVertexFormat_Float2, WGPUVertexFormat_Float3, WGPUVertexFormat_Float4
+		};
+		format = floats[components - 1];
+		return components;
+	}
+}
+
+/**
+ * Bytes per stored component.
+ */
+static uint32_t componentSize(MeshEncoding encoding) {
+	switch (encoding) {
+	case MESH_UNORM16:
+	case MESH_SNORM16:
+		return 2;
+	case MESH_UNORM8:
+	case MESH_SNORM8:
+		return 1;
+	default:
+		return 4;
+	}
+}
+
+VertexLayout::VertexLayout(bool interleaved)
+	: interleaved(interleaved)
+{}
+
+VertexLayout& VertexLayout::add(MeshAttrib attrib, MeshEncoding encoding, uint32_t components)
+{
+	if (has(attrib) || components < 1 || components > 4) {
+		return *this;
+	}
+	uint32_t stored = resolveFormat(encoding, components, attributes[attrib].format);
+	uint32_t stream = (interleaved) ? 0 : streamCount;
+	if (stream == streamCount) {
+		streamCount++;
+	}
+	// every format is a multiple of four bytes, keeping the offsets aligned
+	attributes[attrib].offset = strides[stream];
+	attributes[attrib].shaderLocation = getShaderLocation(attrib);
+	strides[stream] += stored * componentSize(encoding);
+	streams[attrib] = stream;
+	encodings[attrib] = encoding;
+	this->components[attrib] = (uint8_t) components;
+	mask |= 1u << attrib;
+	return *this;
+}
+
+uint32_t VertexLayout::getVertexSize() const
+{
+	uint32_t size = 0;
+	for (uint32_t n = 0; n < streamCount; n++) {
+		size += strides[n];
+	}
+	return size;
+}
+
+const WGPUVertexBufferLayoutDescriptor* VertexLayout::getBufferLayouts() const
+{
+	// each stream's attributes need to be contiguous (which with attributes missing they aren't in the per-attribute array)
+	uint32_t count = 0;
+	for (uint32_t stream = 0; stream < streamCount; stream++) {
+		buffers[stream].arrayStride = strides[stream];
+		buffers[stream].stepMode = WGPUInputStepMode_Vertex;
+		buffers[stream].attributeCount = 0;
+		buffers[stream].attributes = &packed[count];
+		for (uint32_t attrib = 0; attrib < MESH_ATTRIB_COUNT; attrib++) {
+			if (has((MeshAttrib) attrib) && streams[attrib] == stream) {
+				packed[count++] = attributes[attrib];
+				buffers[stream].attributeCount++;
+			}
+		}
+	}
+	return buffers;
+}
+
+uint32_t VertexLayout::getShaderLocation(MeshAttrib attrib)
+{
+	static const uint32_t locations[MESH_ATTRIB_COUNT] = {
+		0, // MESH_POSITION
+		1, // MESH_COLOR
+		7, // MESH_NORMAL
+		8, // MESH_TEXCOORD
+	};
+	return locations[attrib];
+}
+
+//********************************** Mesh ************************************/
+
+/**
+ * Component written for those a format has beyond the source's (opaque alpha
+ * for colours, zero otherwise).
+ */
+static float padding(MeshAttrib attrib, uint32_t component) {
+	return (attrib == MESH_COLOR && component == 3) ? 1.0f : 0.0f;
+}
+
+/**
+ * Writes one attribute of every vertex into its stream.
+ *
+ * \param[in] layout layout being encoded
+ * \param[in] attrib attribute to encode
+ * \param[in] src source floats (the layout's number of components per vertex)
+ * \param[in] vertexCount number of vertices
+ * \param[in] dst start of the attribute's stream
+ * \param[in] scale optional per-component scale applied (after \a offset) before storing
+ * \param[in] offset optional per-component offset subtracted before storing
+ */
+static void encode(const VertexLayout& layout, MeshAttrib attrib, const float* src, uint32_t vertexCount, uint8_t* dst,
+		const float* scale, const float* offset) {
+	WGPUVertexFormat format;
+	uint32_t components = layout.getComponents(attrib);
+	MeshEncoding encoding = layout.getEncoding(attrib);
+	uint32_t stored = resolveFormat(encoding, components, format);
+	uint32_t stride = layout.getStride(layout.getStream(attrib));
+	dst += layout.getOffset(attrib);
+	for (uint32_t v = 0; v < vertexCount; v++, src += components, dst += stride) {
+		for (uint32_t c = 0; c < stored; c++) {
+			float x = (c < components) ? src[c] : padding(attrib, c);
+			if (scale && c < 3 && c < components) {
+				x = (x - offset[c]) * scale[c];
+			}
+			switch (encoding) {
+			case MESH_UNORM16:
+				reinterpret_cast<uint16_t*>(dst)[c] = (uint16_t) (fminf(fmaxf(x, 0.0f), 1.0f) * 65535.0f + 0.5f);
+				break;
+			case MESH_SNORM16:
+				reinterpret_cast<int16_t*>(dst)[c] = (int16_t) lrintf(fminf(fmaxf(x, -1.0f), 1.0f) * 32767.0f);
+				break;
+			case MESH_UNORM8:
+				dst[c] = (uint8_t) (fminf(fmaxf(x, 0.0f), 1.0f) * 255.0f + 0.5f);
+				break;
+			case MESH_SNORM8:
+				reinterpret_cast<int8_t*>(dst)[c] = (int8_t) lrintf(fminf(fmaxf(x, -1.0f), 1.0f) * 127.0f);
+				break;
+			default:
+				reinterpret_cast<float*>(dst)[c] = x;
+			}
+		}
+	}
+}
+
+Mesh::Mesh(Mesh&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept
+{
+	if (this != &other) {
+		release();
+		layout = other.layout;
+		for (uint32_t n = 0; n < MESH_MAX_STREAMS; n++) {
+			streams[n] = other.streams[n];
+			other.streams[n] = NULLPTR;
+		}
+		indexBuf = other.indexBuf;
+		other.indexBuf = NULLPTR;
+		indexFormat = other.indexFormat;
+		vertexCount = other.vertexCount;
+		indexCount  = other.indexCount;
+		memcpy(lods, other.lods, sizeof(lods));
+		lodCount = other.lodCount;
+		for (uint32_t c = 0; c < 3; c++) {
+			dequantScale[c]  = other.dequantScale[c];
+			dequantOffset[c] = other.dequantOffset[c];
+		}
+		memcpy(bounds, other.bounds, sizeof(bounds));
+	}
+	return *this;
+}
+
+Mesh::~Mesh()
+{
+#ifndef __EMSCRIPTEN__
+	release();
+#endif
+}
+
+bool Mesh::encodeVertices(const MeshData& data, const VertexLayout& layout, std::vector<uint8_t>* streamData, float* dequantize)
+{
+	if (!layout.has(MESH_POSITION) || data.vertexCount == 0) {
+		return false;
+	}
+	for (uint32_t attrib = 0; attrib < MESH_ATTRIB_COUNT; attrib++) {
+		if (layout.has((MeshAttrib) attrib) && !data.attribs[attrib]) {
+			return false;
+		}
+	}
+
+	// normalized positions are remapped to span their bounds
+	const float identity[6] = {1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f};
+	memcpy(dequantize, identity, sizeof(identity));
+	float quantize[3] = {1.0f, 1.0f, 1.0f};
+	uint32_t posComponents = layout.getComponents(MESH_POSITION);
+	MeshEncoding posEncoding = layout.getEncoding(MESH_POSITION);
+	if (posEncoding != MESH_FLOAT) {
+		bool isSigned = (posEncoding == MESH_SNORM16 || posEncoding == MESH_SNORM8);
+		float bounds[2][4];
+		VecMath::computeBounds(data.attribs[MESH_POSITION], data.vertexCount, posComponents, bounds[0], bounds[1]);
+		for (uint32_t c = 0; c < posComponents && c < 3; c++) {
+			float lo = bounds[0][c];
+			float hi = bounds[1][c];
+			float extent = (hi > lo) ? (hi - lo) : 1.0f;
+			// unsigned maps [lo, hi] to [0, 1], signed to [-1, 1] around the centre
+			dequantize[c]     = (isSigned) ? extent * 0.5f : extent;
+			dequantize[3 + c] = (isSigned) ? (lo + hi) * 0.5f : lo;
+			quantize[c]       = 1.0f / dequantize[c];
+		}
+	}
+
+	for (uint32_t n = 0; n < layout.getStreamCount(); n++) {
+		streamData[n].assign((size_t) layout.getStride(n) * data.vertexCount, 0);
+	}
+	for (uint32_t attrib = 0; attrib < MESH_ATTRIB_COUNT; attrib++) {
+		if (layout.has((MeshAttrib) attrib)) {
+			bool remap = (attrib == MESH_POSITION && posEncoding != MESH_FLOAT);
+			encode(layout, (MeshAttrib) attrib, data.attribs[attrib], data.vertexCount,
+				streamData[layout.getStream((MeshAttrib) attrib)].data(),
+				(remap) ? quantize : NULLPTR, (remap) ? dequantize + 3 : NULLPTR);
+		}
+	}
+	return true;
+}
+
+bool Mesh::create(Renderer& renderer, const MeshData& data, const VertexLayout& layout)
+{
+	std::vector<uint8_t> streamData[MESH_MAX_STREAMS];
+	float dequantize[6];
+	if (!encodeVertices(data, layout, streamData, dequantize)) {
+		return false;
+	}
+	const void* streamPtrs[MESH_MAX_STREAMS] = {};
+	for (uint32_t n = 0; n < layout.getStreamCount(); n++) {
+		streamPtrs[n] = streamData[n].data();
+	}
+
+	// without indices the vertices are drawn in order
+	std::vector<uint32_t> sequential;
+	const uint32_t* indices = data.indices;
+	uint32_t indexCount = data.indexCount;
+	if (!indices) {
+		sequential.resize(data.vertexCount);
+		for (uint32_t v = 0; v < data.vertexCount; v++) {
+			sequential[v] = v;
+		}
+		indices = sequential.data();
+		indexCount = data.vertexCount;
+	}
+	if (data.lodCount > MESH_MAX_LODS || (data.lodCount > 0 && !data.lods)) {
+		return false;
+	}
+	for (uint32_t n = 0; n < data.lodCount; n++) {
+		const MeshLod& lod = data.lods[n];
+		if (lod.indexCount == 0 || lod.indexCount % 3 != 0 || (uint64_t) lod.firstIndex + lod.indexCount > indexCount) {
+			return false;
+		}
+	}
+
+	upload(renderer, layout, streamPtrs, data.vertexCount, indices, 0, WGPUIndexFormat_Uint32, dequantize);
+	indexBuf = createIndexBuffer(renderer, indices, indexCount, data.vertexCount, indexFormat);
+	if (data.lodCount > 0) {
+		memcpy(lods, data.lods, data.lodCount * sizeof(MeshLod));
+		lodCount = data.lodCount;
+	} else {
+		lods[0] = {0, indexCount, 0.0f};
+		lodCount = 1;
+	}
+	this->indexCount = lods[0].indexCount;
+	return true;
+}
+
+void Mesh::upload(Renderer& renderer, const VertexLayout& layout, const void* const* vertexData, uint32_t vertexCount,
+		const void* indices, uint32_t indexCount, WGPUIndexFormat format, const float* dequantize,
+		const MeshLod* lods, uint32_t lodCount)
+{
+	release();
+	this->layout = layout;
+	this->vertexCount = vertexCount;
+	for (uint32_t n = 0; n < layout.getStreamCount(); n++) {
+		streams[n] = renderer.createBuffer(vertexData[n], (size_t) layout.getStride(n) * vertexCount, WGPUBufferUsage_Vertex);
+	}
+	if (indexCount > 0) {
+		size_t indexBytes = (size_t) indexCount * ((format == WGPUIndexFormat_Uint16) ? 2 : 4);
+		indexBuf = renderer.createBuffer(indices, (indexBytes + 3) & ~(size_t) 3, WGPUBufferUsage_Index);
+	}
+	this->indexFormat = format;
+	if (lods && lodCount > 0) {
+		memcpy(this->lods, lods, lodCount * sizeof(MeshLod));
+		this->lodCount = lodCount;
+	} else {
+		this->lods[0] = {0, indexCount, 0.0f};
+		this->lodCount = 1;
+	}
+	this->indexCount = this->lods[0].indexCount;
+	for (uint32_t c = 0; c < 3; c++) {
+		dequantScale[c]  = (dequantize) ? dequantize[c] : 1.0f;
+		dequantOffset[c] = (dequantize) ? dequantize[3 + c] : 0.0f;
+	}
+
+	// normalized positions span their range (being remapped to fit), floats need measuring
+	memset(bounds, 0, sizeof(bounds));
+	uint32_t posComponents = std::min(layout.getComponents(MESH_POSITION), 3u);
+	MeshEncoding posEncoding = layout.getEncoding(MESH_POSITION);
+	if (posEncoding == MESH_FLOAT) {
+		if (vertexCount > 0) {
+			uint32_t stream = layout.getStream(MESH_POSITION);
+			const float* positions = reinterpret_cast<const float*>(static_cast<const uint8_t*>(vertexData[stream]) + layout.getOffset(MESH_POSITION));
+			VecMath::computeBounds(positions, vertexCount, posComponents, bounds, bounds + 3, layout.getStride(stream) / sizeof(float));
+		}
+	} else {
+		bool isSigned = (posEncoding == MESH_SNORM16 || posEncoding == MESH_SNORM8);
+		for (uint32_t c = 0; c < posComponents; c++) {
+			bounds[c]     = (isSigned) ? -1.0f : 0.0f;
+			bounds[3 + c] = 1.0f;
+		}
+	}
+}
+
+void Mesh::release()
+{
+	for (uint32_t n = 0; n < MESH_MAX_STREAMS; n++) {
+		if (streams[n]) {
+			wgpuBufferRelease(streams[n]);
+			streams[n] = NULLPTR;
+		}
+	}
+	if (indexBuf) {
+		wgpuBufferRelease(indexBuf);
+		indexBuf = NULLPTR;
+	}
+	vertexCount = 0;
+	indexCount  = 0;
+	lodCount    = 0;
+}
+
+void Mesh::bind(WGPURenderPassEncoder pass) const
+{
+	for (uint32_t n = 0; n < layout.getStreamCount(); n++) {
+		wgpuRenderPassEncoderSetVertexBuffer(pass, n, streams[n], 0, 0);
+	}
+	wgpuRenderPassEncoderSetIndexBuffer(pass, indexBuf, indexFormat, 0, 0);
+}
+
+void Mesh::getDequantize(float* matrix) const
+{
+	for (uint32_t n = 0; n < 16; n++) {
+		matrix[n] = (n % 5 == 0) ? 1.0f : 0.0f;
+	}
+	for (uint32_t c = 0; c < 3; c++) {
+		matrix[c * 5]  = dequantScale[c];
+		matrix[12 + c] = dequantOffset[c];
+	}
+}
+
+void Mesh::getBounds(float* min, float* max) const
+{
+	memcpy(min, bounds, 3 * sizeof(float));
+	memcpy(max, bounds + 3, 3 * sizeof(float));
+}
+
+WGPUBuffer Mesh::createIndexBuffer(Renderer& renderer, const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, WGPUIndexFormat& format)
+{
+	if (vertexCount > MESH_MAX_INDEX16_VERTICES) {
+		format = WGPUIndexFormat_Uint32;
+		return renderer.createBuffer(indices, (size_t) indexCount * sizeof(uint32_t), WGPUBufferUsage_Index);
+	}
+	// narrowed, padded to an even count for the four byte aligned write
+	std::vector<uint16_t> narrow((indexCount + 1) & ~1u, 0);
+	for (uint32_t n = 0; n < indexCount; n++) {
+		narrow[n] = (uint16_t) indices[n];
+	}
+	format = WGPUIndexFormat_Uint16;
+	return renderer.createBuffer(narrow.data(), narrow.size() * sizeof(uint16_t), WGPUBufferUsage_Index);
+}
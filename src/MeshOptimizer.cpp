@@ -0,0 +1,567 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+MeshData MeshSource::getData() const
+{
+	MeshData data = {};
+	for (uint32_t n = 0; n < MESH_ATTRIB_COUNT; n++) {
+		data.attribs[n] = (attribs[n].empty()) ? NULLPTR : attribs[n].data();
+	}
+	data.vertexCount = vertexCount;
+	data.indices = (indices.empty()) ? NULLPTR : indices.data();
+	data.indexCount = (uint32_t) indices.size();
+	data.lods = (lods.empty()) ? NULLPTR : lods.data();
+	data.lodCount = (uint32_t) lods.size();
+	return data;
+}
+
+//**************************** Vertex cache (Tipsify) ************************/
+
+namespace {
+/**
+ * Triangles using each vertex (compressed rows: vertex \c v's triangles are
+ * \c triangles[offsets[v]] to \c triangles[offsets[v + 1]]).
+ */
+struct Adjacency {
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> triangles;
+
+	Adjacency(const uint32_t* indices, size_t indexCount, uint32_t vertexCount)
+		: offsets(vertexCount + 1, 0)
+		, triangles(indexCount)
+	{
+		for (size_t n = 0; n < indexCount; n++) {
+			offsets[indices[n] + 1]++;
+		}
+		for (uint32_t v = 0; v < vertexCount; v++) {
+			offsets[v + 1] += offsets[v];
+		}
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t n = 0; n < indexCount; n++) {
+			triangles[fill[indices[n]]++] = (uint32_t) (n / 3);
+		}
+	}
+};
+}
+
+void MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+	size_t triCount = indexCount / 3;
+	if (triCount == 0 || vertexCount == 0) {
+		return;
+	}
+	Adjacency adjacency(indices, triCount * 3, vertexCount);
+
+	// live (not yet emitted) triangles per vertex and when each was last cached
+	std::vector<uint32_t> live(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+	}
+	std::vector<uint32_t> cached(vertexCount, 0);
+	std::vector<bool> emitted(triCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(triCount * 3);
+
+	uint32_t time = cacheSize + 1;
+	uint32_t cursor = 0;
+	int64_t fan = 0;
+	while (fan >= 0) {
+		// emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (uint32_t n = adjacency.offsets[fan]; n < adjacency.offsets[fan + 1]; n++) {
+			uint32_t tri = adjacency.triangles[n];
+			if (emitted[tri]) {
+				continue;
+			}
+			for (uint32_t c = 0; c < 3; c++) {
+				uint32_t v = indices[tri * 3 + c];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cached[v] > cacheSize) {
+					cached[v] = time++;
+				}
+			}
+			emitted[tri] = true;
+		}
+
+		// next fan: the candidate furthest through the cache that will still be in it once fanned
+		fan = -1;
+		uint32_t best = 0;
+		for (uint32_t v : candidates) {
+			if (live[v] > 0) {
+				uint32_t priority = (time - cached[v] + 2 * live[v] <= cacheSize) ? time - cached[v] : 0;
+				if (fan < 0 || priority > best) {
+					fan = v;
+					best = priority;
+				}
+			}
+		}
+		// otherwise a recently used vertex, or failing that the next with triangles left
+		while (fan < 0 && !deadEnds.empty()) {
+			uint32_t v = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[v] > 0) {
+				fan = v;
+			}
+		}
+		while (fan < 0 && cursor < vertexCount) {
+			if (live[cursor] > 0) {
+				fan = cursor;
+			}
+			cursor++;
+		}
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+//********************************* Overdraw *********************************/
+
+void MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, uint32_t components,
+		uint32_t vertexCount, uint32_t cacheSize)
+{
+	size_t triCount = indexCount / 3;
+	if (triCount < 2 || vertexCount == 0) {
+		return;
+	}
+
+	// split into clusters wherever the cache is cold (every vertex of a triangle missing)
+	std::vector<uint32_t> clusters;
+	std::vector<uint32_t> cached(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	for (size_t tri = 0; tri < triCount; tri++) {
+		uint32_t misses = 0;
+		for (uint32_t c = 0; c < 3; c++) {
+			uint32_t v = indices[tri * 3 + c];
+			if (time - cached[v] > cacheSize) {
+				cached[v] = time++;
+				misses++;
+			}
+		}
+		if (misses == 3 || tri == 0) {
+			clusters.push_back((uint32_t) tri);
+		}
+	}
+	if (clusters.size() < 2) {
+		return;
+	}
+	clusters.push_back((uint32_t) triCount);
+
+	// each cluster's area-weighted centroid and normal (and the mesh's centroid)
+	auto position = [&](uint32_t v, float* p) {
+		for (uint32_t c = 0; c < 3; c++) {
+			p[c] = (c < components) ? positions[(size_t) v * components + c] : 0.0f;
+		}
+	};
+	size_t clusterCount = clusters.size() - 1;
+	std::vector<float> centroids(clusterCount * 3, 0.0f);
+	std::vector<float> normals(clusterCount * 3, 0.0f);
+	float meshCentroid[3] = {};
+	float meshArea = 0.0f;
+	for (size_t n = 0; n < clusterCount; n++) {
+		float area = 0.0f;
+		for (uint32_t tri = clusters[n]; tri < clusters[n + 1]; tri++) {
+			float a[3], b[3], c[3];
+			position(indices[tri * 3 + 0], a);
+			position(indices[tri * 3 + 1], b);
+			position(indices[tri * 3 + 2], c);
+			float e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+			float e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+			float normal[3] = {e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0]};
+			float triArea = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			for (uint32_t k = 0; k < 3; k++) {
+				centroids[n * 3 + k] += (a[k] + b[k] + c[k]) * triArea / 3.0f;
+				normals[n * 3 + k] += normal[k];
+			}
+			area += triArea;
+		}
+		for (uint32_t k = 0; k < 3; k++) {
+			meshCentroid[k] += centroids[n * 3 + k];
+			centroids[n * 3 + k] = (area > 0.0f) ? centroids[n * 3 + k] / area : 0.0f;
+		}
+		meshArea += area;
+	}
+	for (uint32_t k = 0; k < 3; k++) {
+		meshCentroid[k] = (meshArea > 0.0f) ? meshCentroid[k] / meshArea : 0.0f;
+	}
+
+	// outward facing first (how far the cluster sits along its own normal from the centre)
+	std::vector<float> keys(clusterCount);
+	std::vector<uint32_t> order(clusterCount);
+	for (size_t n = 0; n < clusterCount; n++) {
+		const float* c = &centroids[n * 3];
+		const float* d = &normals[n * 3];
+		float length = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		float dot = (c[0] - meshCentroid[0]) * d[0] + (c[1] - meshCentroid[1]) * d[1] + (c[2] - meshCentroid[2]) * d[2];
+		keys[n] = (length > 0.0f) ? dot / length : 0.0f;
+		order[n] = (uint32_t) n;
+	}
+	std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) {
+		return keys[a] > keys[b];
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(triCount * 3);
+	for (uint32_t n : order) {
+		output.insert(output.end(), indices + clusters[n] * 3, indices + clusters[n + 1] * 3);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+//******************************* Vertex fetch *******************************/
+
+uint32_t MeshOptimizer::optimizeVertexFetch(MeshSource& mesh)
+{
+	const uint32_t unused = UINT32_MAX;
+	std::vector<uint32_t> remap(mesh.vertexCount, unused);
+	uint32_t next = 0;
+	for (uint32_t& index : mesh.indices) {
+		if (remap[index] == unused) {
+			remap[index] = next++;
+		}
+		index = remap[index];
+	}
+	for (uint32_t attrib = 0; attrib < MESH_ATTRIB_COUNT; attrib++) {
+		uint32_t components = mesh.components[attrib];
+		if (mesh.attribs[attrib].empty() || components == 0) {
+			continue;
+		}
+		std::vector<float> reordered((size_t) next * components);
+		for (uint32_t v = 0; v < mesh.vertexCount; v++) {
+			if (remap[v] != unused) {
+				std::copy_n(&mesh.attribs[attrib][(size_t) v * components], components, &reordered[(size_t) remap[v] * components]);
+			}
+		}
+		mesh.attribs[attrib].swap(reordered);
+	}
+	mesh.vertexCount = next;
+	return next;
+}
+
+//****************************** Simplification ******************************/
+
+namespace {
+/**
+ * Sum of squared distances from a set of planes (each weighted by its
+ * triangle's area), as the ten distinct terms of a symmetric 4x4 matrix. The
+ * total weight turns the sum back into a mean.
+ */
+struct Quadric {
+	double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+	double weight;
+
+	void addPlane(const double* n, double d, double w) {
+		xx += w * n[0] * n[0];
+		xy += w * n[0] * n[1];
+		xz += w * n[0] * n[2];
+		xw += w * n[0] * d;
+		yy += w * n[1] * n[1];
+		yz += w * n[1] * n[2];
+		yw += w * n[1] * d;
+		zz += w * n[2] * n[2];
+		zw += w * n[2] * d;
+		ww += w * d * d;
+		weight += w;
+	}
+
+	void add(const Quadric& q) {
+		xx += q.xx; xy += q.xy; xz += q.xz; xw += q.xw;
+		yy += q.yy; yz += q.yz; yw += q.yw;
+		zz += q.zz; zw += q.zw;
+		ww += q.ww;
+		weight += q.weight;
+	}
+
+	/**
+	 * Weighted sum of the squared distances of \a p from the planes.
+	 */
+	double evaluate(const float* p) const {
+		double x = p[0], y = p[1], z = p[2];
+		return xx * x * x + yy * y * y + zz * z * z + ww
+			+ 2.0 * (xy * x * y + xz * x * z + yz * y * z + xw * x + yw * y + zw * z);
+	}
+};
+
+/**
+ * Unnormalized normal of a triangle (its length being twice the area).
+ */
+inline void triangleNormal(const float* a, const float* b, const float* c, double* n) {
+	double u[3] = {(double) b[0] - a[0], (double) b[1] - a[1], (double) b[2] - a[2]};
+	double v[3] = {(double) c[0] - a[0], (double) c[1] - a[1], (double) c[2] - a[2]};
+	n[0] = u[1] * v[2] - u[2] * v[1];
+	n[1] = u[2] * v[0] - u[0] * v[2];
+	n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+/**
+ * Whether moving \a from onto \a to turns any of \a from's triangles (other
+ * than those along the edge, which collapse) to face the other way.
+ */
+bool collapseFlips(const uint32_t* indices, const Adjacency& adjacency, const float* points, uint32_t from, uint32_t to) {
+	for (uint32_t k = adjacency.offsets[from]; k < adjacency.offsets[from + 1]; k++) {
+		const uint32_t* tri = indices + adjacency.triangles[k] * 3;
+		if (tri[0] == to || tri[1] == to || tri[2] == to) {
+			continue;
+		}
+		const float* before[3];
+		const float* after[3];
+		for (int e = 0; e < 3; e++) {
+			before[e] = points + (size_t) tri[e] * 3;
+			after[e]  = points + (size_t) ((tri[e] == from) ? to : tri[e]) * 3;
+		}
+		double n0[3];
+		double n1[3];
+		triangleNormal(before[0], before[1], before[2], n0);
+		triangleNormal(after[0], after[1], after[2], n1);
+		if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0) {
+			return true;
+		}
+	}
+	return false;
+}
+}
+
+size_t MeshOptimizer::simplify(uint32_t* indices, size_t indexCount, const float* positions, uint32_t components,
+		uint32_t vertexCount, size_t targetCount, float* error)
+{
+	indexCount -= indexCount % 3;
+	if (error) {
+		*error = 0.0f;
+	}
+	if (indexCount <= targetCount) {
+		return indexCount;
+	}
+	// positions widened to xyz (flat meshes at zero)
+	std::vector<float> points((size_t) vertexCount * 3, 0.0f);
+	uint32_t stored = std::min(components, 3u);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		for (uint32_t c = 0; c < stored; c++) {
+			points[(size_t) v * 3 + c] = positions[(size_t) v * components + c];
+		}
+	}
+
+	// vertices on borders (edges without exactly one twin running the other way) stay put
+	std::vector<uint8_t> locked(vertexCount, 0);
+	{
+		Adjacency adjacency(indices, indexCount, vertexCount);
+		for (size_t n = 0; n < indexCount; n++) {
+			uint32_t a = indices[n];
+			uint32_t b = indices[n - n % 3 + (n + 1) % 3];
+			uint32_t forward  = 0;
+			uint32_t backward = 0;
+			for (uint32_t k = adjacency.offsets[b]; k < adjacency.offsets[b + 1]; k++) {
+				const uint32_t* tri = indices + adjacency.triangles[k] * 3;
+				for (int e = 0; e < 3; e++) {
+					forward  += (tri[e] == a && tri[(e + 1) % 3] == b) ? 1 : 0;
+					backward += (tri[e] == b && tri[(e + 1) % 3] == a) ? 1 : 0;
+				}
+			}
+			if (forward != 1 || backward != 1) {
+				locked[a] = locked[b] = 1;
+			}
+		}
+	}
+
+	// each vertex starts with the planes of its triangles
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t n = 0; n < indexCount; n += 3) {
+		const float* p0 = &points[(size_t) indices[n + 0] * 3];
+		const float* p1 = &points[(size_t) indices[n + 1] * 3];
+		const float* p2 = &points[(size_t) indices[n + 2] * 3];
+		double normal[3];
+		triangleNormal(p0, p1, p2, normal);
+		double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length == 0.0) {
+			continue;
+		}
+		for (int c = 0; c < 3; c++) {
+			normal[c] /= length;
+		}
+		double d = -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]);
+		for (int e = 0; e < 3; e++) {
+			quadrics[indices[n + e]].addPlane(normal, d, length * 0.5);
+		}
+	}
+	auto cost = [&](uint32_t from, uint32_t to) {
+		double weight = quadrics[from].weight + quadrics[to].weight;
+		if (weight <= 0.0) {
+			return 0.0;
+		}
+		const float* p = &points[(size_t) to * 3];
+		return std::max(quadrics[from].evaluate(p) + quadrics[to].evaluate(p), 0.0) / weight;
+	};
+
+	// passes of the cheapest collapses whose neighbourhoods don't overlap (so the adjacency holds for the pass)
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint8_t> touched(vertexCount);
+	double worst = 0.0;
+	while (indexCount > targetCount) {
+		Adjacency adjacency(indices, indexCount, vertexCount);
+		collapses.clear();
+		for (size_t n = 0; n < indexCount; n++) {
+			uint32_t a = indices[n];
+			uint32_t b = indices[n - n % 3 + (n + 1) % 3];
+			// each inner edge once (its twin running from b to a)
+			if (a >= b || (locked[a] && locked[b])) {
+				continue;
+			}
+			double ab = (locked[a]) ? DBL_MAX : cost(a, b);
+			double ba = (locked[b]) ? DBL_MAX : cost(b, a);
+			collapses.push_back((ab <= ba) ? Collapse{a, b, ab} : Collapse{b, a, ba});
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+			return x.cost < y.cost;
+		});
+
+		std::iota(remap.begin(), remap.end(), 0u);
+		std::fill(touched.begin(), touched.end(), 0);
+		size_t goal = (indexCount - targetCount) / 6 + 1; // each collapse removing two triangles
+		size_t done = 0;
+		for (const Collapse& collapse : collapses) {
+			if (done >= goal) {
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to]
+					|| collapseFlips(indices, adjacency, points.data(), collapse.from, collapse.to)) {
+				continue;
+			}
+			for (uint32_t k = adjacency.offsets[collapse.from]; k < adjacency.offsets[collapse.from + 1]; k++) {
+				const uint32_t* tri = indices + adjacency.triangles[k] * 3;
+				touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+			}
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			worst = std::max(worst, collapse.cost);
+			done++;
+		}
+		if (done == 0) {
+			break; // everything left is locked or would flip
+		}
+
+		// triangles along collapsed edges are now lines
+		size_t count = 0;
+		for (size_t n = 0; n < indexCount; n += 3) {
+			uint32_t a = remap[indices[n + 0]];
+			uint32_t b = remap[indices[n + 1]];
+			uint32_t c = remap[indices[n + 2]];
+			if (a != b && b != c && c != a) {
+				indices[count++] = a;
+				indices[count++] = b;
+				indices[count++] = c;
+			}
+		}
+		indexCount = count;
+	}
+	if (error) {
+		*error = (float) sqrt(worst);
+	}
+	return indexCount;
+}
+
+void MeshOptimizer::generateLods(MeshSource& mesh, uint32_t lodCount)
+{
+	lodCount = std::min<uint32_t>(lodCount, MESH_MAX_LODS);
+	const std::vector<float>& positions = mesh.attribs[MESH_POSITION];
+	if (lodCount <= 1 || !mesh.lods.empty() || mesh.indices.size() < 3 || positions.empty()) {
+		return;
+	}
+	size_t full = mesh.indices.size() - mesh.indices.size() % 3;
+	mesh.lods.push_back({0, (uint32_t) full, 0.0f});
+
+	// each level simplified from the one before
+	std::vector<uint32_t> level(mesh.indices.begin(), mesh.indices.begin() + full);
+	while (mesh.lods.size() < lodCount) {
+		size_t previous = level.size();
+		size_t target = (size_t) (previous / 3 * MESH_OPT_LOD_RATIO) * 3;
+		float error;
+		size_t count = simplify(level.data(), previous, positions.data(), mesh.components[MESH_POSITION], mesh.vertexCount,
+			target, &error);
+		if (count == 0 || count > previous * MESH_OPT_LOD_MIN_SAVING) {
+			break;
+		}
+		level.resize(count);
+		mesh.lods.push_back({(uint32_t) mesh.indices.size(), (uint32_t) count, mesh.lods.back().error + error});
+		mesh.indices.insert(mesh.indices.end(), level.begin(), level.end());
+	}
+	if (mesh.lods.size() == 1) {
+		mesh.lods.clear();
+	}
+}
+
+//********************************* Combined *********************************/
+
+void MeshOptimizer::optimize(MeshSource& mesh)
+{
+	if (mesh.indices.empty()) {
+		// unindexed meshes are drawn in order, so there's nothing to reorder
+		return;
+	}
+	// each level of detail is drawn on its own, so is reordered on its own
+	MeshLod whole = {0, (uint32_t) mesh.indices.size(), 0.0f};
+	const MeshLod* lods = (mesh.lods.empty()) ? &whole : mesh.lods.data();
+	size_t lodCount = std::max<size_t>(mesh.lods.size(), 1);
+	for (size_t n = 0; n < lodCount; n++) {
+		uint32_t* indices = mesh.indices.data() + lods[n].firstIndex;
+		optimizeVertexCache(indices, lods[n].indexCount, mesh.vertexCount);
+		if (!mesh.attribs[MESH_POSITION].empty()) {
+			optimizeOverdraw(indices, lods[n].indexCount, mesh.attribs[MESH_POSITION].data(),
+				mesh.components[MESH_POSITION], mesh.vertexCount);
+		}
+	}
+	optimizeVertexFetch(mesh);
+}
+
+float MeshOptimizer::getACMR(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+	size_t triCount = indexCount / 3;
+	if (triCount == 0) {
+		return 0.0f;
+	}
+	std::vector<uint32_t> cached(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	for (size_t n = 0; n < triCount * 3; n++) {
+		if (time - cached[indices[n]] > cacheSize) {
+			cached[indices[n]] = time++;
+		}
+	}
+	return (float) (time - cacheSize - 1) / triCount;
+}
+
+//*********************************** Job ************************************/
+
+MeshOptimizer::Job::Job(MeshSource&& mesh, uint32_t lodCount)
+	: mesh(std::move(mesh))
+	, lodCount(lodCount)
+{
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+	generateLods(this->mesh, this->lodCount);
+	optimize(this->mesh);
+	finished.store(true, std::memory_order_release);
+#else
+	worker = std::thread([this]() {
+		generateLods(this->mesh, this->lodCount);
+		optimize(this->mesh);
+		finished.store(true, std::memory_order_release);
+	});
+#endif
+}
+
+MeshOptimizer::Job::~Job()
+{
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
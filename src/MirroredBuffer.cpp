@@ -0,0 +1,158 @@
+#include "MirroredBuffer.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+MirroredBuffer::MirroredBuffer(MirroredBuffer&& other) noexcept
+	: buffer(other.buffer)
+	, usage(other.usage)
+	, mirror(std::move(other.mirror))
+	, dirty(std::move(other.dirty))
+{
+	other.buffer = NULLPTR;
+}
+
+MirroredBuffer& MirroredBuffer::operator=(MirroredBuffer&& other) noexcept
+{
+	if (this != &other) {
+		release();
+		buffer = other.buffer;
+		usage  = other.usage;
+		mirror = std::move(other.mirror);
+		dirty  = std::move(other.dirty);
+		other.buffer = NULLPTR;
+	}
+	return *this;
+}
+
+MirroredBuffer::~MirroredBuffer()
+{
+#ifndef __EMSCRIPTEN__
+	release();
+#endif
+}
+
+void MirroredBuffer::create(Renderer& renderer, const void* data, size_t size, WGPUBufferUsage usage)
+{
+	release();
+
+	// queue writes need four byte aligned sizes
+	mirror.assign((size + 3) & ~(size_t) 3, 0);
+	if (data) {
+		memcpy(mirror.data(), data, size);
+	}
+	this->usage = usage;
+	buffer = renderer.createBuffer(mirror.data(), mirror.size(), usage);
+}
+
+bool MirroredBuffer::reserve(Renderer& renderer, size_t size)
+{
+	size = (size + 3) & ~(size_t) 3;
+	if (size <= mirror.size()) {
+		return false;
+	}
+	if (buffer) {
+		wgpuBufferRelease(buffer);
+	}
+	// the new buffer is created with the whole mirror, so nothing is left dirty
+	mirror.resize(std::max(size, mirror.size() * 2), 0);
+	dirty.clear();
+	buffer = renderer.createBuffer(mirror.data(), mirror.size(), usage);
+	return true;
+}
+
+void MirroredBuffer::release()
+{
+	if (buffer) {
+		wgpuBufferRelease(buffer);
+		buffer = NULLPTR;
+	}
+	mirror.clear();
+	dirty.clear();
+}
+
+void MirroredBuffer::markDirty(size_t begin, size_t end)
+{
+	// extending the previous range is the common case (sequential writes)
+	if (!dirty.empty() && begin >= dirty.back().begin && begin <= dirty.back().end + MIRRORED_BUFFER_MERGE_GAP) {
+		dirty.back().end = std::max(dirty.back().end, end);
+	} else {
+		dirty.push_back({ begin, end });
+	}
+}
+
+bool MirroredBuffer::write(size_t offset, const void* data, size_t size)
+{
+	if (size > mirror.size() || offset > mirror.size() - size) {
+		return false;
+	}
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+	uint8_t* dst = mirror.data() + offset;
+
+	// narrow down to the bytes that actually differ
+	size_t first = 0;
+	while (first < size && src[first] == dst[first]) {
+		first++;
+	}
+	if (first == size) {
+		return true;
+	}
+	size_t last = size;
+	while (last > first && src[last - 1] == dst[last - 1]) {
+		last--;
+	}
+	memcpy(dst + first, src + first, last - first);
+	markDirty(offset + first, offset + last);
+	return true;
+}
+
+void* MirroredBuffer::modify(size_t offset, size_t size)
+{
+	if (size > mirror.size() || offset > mirror.size() - size) {
+		return NULLPTR;
+	}
+	markDirty(offset, offset + size);
+	return mirror.data() + offset;
+}
+
+void MirroredBuffer::invalidate()
+{
+	dirty.clear();
+	if (!mirror.empty()) {
+		markDirty(0, mirror.size());
+	}
+}
+
+size_t MirroredBuffer::flush(WGPUQueue queue)
+{
+	if (dirty.empty() || !buffer) {
+		return 0;
+	}
+
+	// align to four bytes, sort, then merge overlapping (or close enough) ranges
+	for (auto it = dirty.begin(); it != dirty.end(); ++it) {
+		it->begin &= ~(size_t) 3;
+		it->end = std::min((it->end + 3) & ~(size_t) 3, mirror.size());
+	}
+	std::sort(dirty.begin(), dirty.end(), [](const Range& a, const Range& b) {
+		return a.begin < b.begin;
+		});
+
+	size_t uploaded = 0;
+	Range span = dirty.front();
+	for (size_t n = 1; n <= dirty.size(); n++) {
+		if (n < dirty.size() && dirty[n].begin <= span.end + MIRRORED_BUFFER_MERGE_GAP) {
+			span.end = std::max(span.end, dirty[n].end);
+			continue;
+		}
+		wgpuQueueWriteBuffer(queue, buffer, span.begin, mirror.data() + span.begin, span.end - span.begin);
+		uploaded += span.end - span.begin;
+		if (n < dirty.size()) {
+			span = dirty[n];
+		}
+	}
+	dirty.clear();
+	return uploaded;
+}
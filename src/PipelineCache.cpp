@@ -0,0 +1,186 @@
+#include "PipelineCache.h"
+
+#include <cstring>
+
+/**
+ * Helper to store a float in the key without losing precision.
+ */
+static uint64_t floatBits(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+/**
+ * Helper to store a string (the shader entry points) in the key (FNV-1a).
+ */
+static uint64_t stringHash(const char* str) {
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	if (str) {
+		for (; *str; str++) {
+			hash = (hash ^ (uint8_t) *str) * 0x100000001B3ULL;
+		}
+	}
+	return hash;
+}
+
+size_t PipelineCache::KeyHash::operator()(const Key& key) const {
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for (auto it = key.begin(); it != key.end(); ++it) {
+		hash = (hash ^ *it) * 0x100000001B3ULL;
+	}
+	return (size_t) hash;
+}
+
+PipelineCache::~PipelineCache()
+{
+#ifndef __EMSCRIPTEN__
+	clear();
+#endif
+}
+
+/**
+ * Flattens every field affecting the compiled pipeline (labels are ignored).
+ * Optional structs are preceded by a presence flag so that a missing struct
+ * can't alias one filled with zeros.
+ */
+PipelineCache::Key PipelineCache::createKey(const WGPURenderPipelineDescriptor& desc) {
+	Key key;
+	key.reserve(64);
+	key.push_back(reinterpret_cast<uintptr_t>(desc.layout));
+
+	key.push_back(reinterpret_cast<uintptr_t>(desc.vertexStage.module));
+	key.push_back(stringHash(desc.vertexStage.entryPoint));
+	key.push_back(desc.fragmentStage != NULLPTR);
+	if (desc.fragmentStage) {
+		key.push_back(reinterpret_cast<uintptr_t>(desc.fragmentStage->module));
+		key.push_back(stringHash(desc.fragmentStage->entryPoint));
+	}
+
+	key.push_back(desc.vertexState != NULLPTR);
+	if (const WGPUVertexStateDescriptor* vs = desc.vertexState) {
+		key.push_back(vs->indexFormat);
+		key.push_back(vs->vertexBufferCount);
+		for (uint32_t b = 0; b < vs->vertexBufferCount; b++) {
+			const WGPUVertexBufferLayoutDescriptor& buf = vs->vertexBuffers[b];
+			key.push_back(buf.arrayStride);
+			key.push_back(buf.stepMode);
+			key.push_back(buf.attributeCount);
+			for (uint32_t a = 0; a < buf.attributeCount; a++) {
+				key.push_back(buf.attributes[a].format);
+				key.push_back(buf.attributes[a].offset);
+				key.push_back(buf.attributes[a].shaderLocation);
+			}
+		}
+	}
+
+	key.push_back(desc.primitiveTopology);
+	key.push_back(desc.rasterizationState != NULLPTR);
+	if (const WGPURasterizationStateDescriptor* rs = desc.rasterizationState) {
+		key.push_back(rs->frontFace);
+		key.push_back(rs->cullMode);
+		key.push_back((uint32_t) rs->depthBias);
+		key.push_back(floatBits(rs->depthBiasSlopeScale));
+		key.push_back(floatBits(rs->depthBiasClamp));
+	}
+
+	key.push_back(desc.sampleCount);
+	key.push_back(desc.depthStencilState != NULLPTR);
+	if (const WGPUDepthStencilStateDescriptor* ds = desc.depthStencilState) {
+		key.push_back(ds->format);
+		key.push_back(ds->depthWriteEnabled);
+		key.push_back(ds->depthCompare);
+		const WGPUStencilStateFaceDescriptor* faces[] = { &ds->stencilFront, &ds->stencilBack };
+		for (auto face : faces) {
+			key.push_back(face->compare);
+			key.push_back(face->failOp);
+			key.push_back(face->depthFailOp);
+			key.push_back(face->passOp);
+		}
+		key.push_back(ds->stencilReadMask);
+		key.push_back(ds->stencilWriteMask);
+	}
+
+	key.push_back(desc.colorStateCount);
+	for (uint32_t c = 0; c < desc.colorStateCount; c++) {
+		const WGPUColorStateDescriptor& cs = desc.colorStates[c];
+		key.push_back(cs.format);
+		key.push_back(cs.alphaBlend.operation);
+		key.push_back(cs.alphaBlend.srcFactor);
+		key.push_back(cs.alphaBlend.dstFactor);
+		key.push_back(cs.colorBlend.operation);
+		key.push_back(cs.colorBlend.srcFactor);
+		key.push_back(cs.colorBlend.dstFactor);
+		key.push_back(cs.writeMask);
+	}
+
+	key.push_back(desc.sampleMask);
+	key.push_back(desc.alphaToCoverageEnabled);
+	return key;
+}
+
+WGPUShaderModule PipelineCache::getShaderModule(const std::string& code, const char* label) {
+	auto found = shaders.find(code);
+	if (found != shaders.end()) {
+		return found->second;
+	}
+
+	WGPUShaderModuleWGSLDescriptor wgsl = {};
+	wgsl.chain.sType = WGPUSType_ShaderModuleWGSLDescriptor;
+	wgsl.source = code.c_str();
+	WGPUShaderModuleDescriptor desc = {};
+	desc.nextInChain = reinterpret_cast<WGPUChainedStruct*>(&wgsl);
+	desc.label = label;
+	WGPUShaderModule module = wgpuDeviceCreateShaderModule(device, &desc);
+	if (module) {
+		shaders.emplace(code, module);
+	}
+	return module;
+}
+
+WGPURenderPipeline PipelineCache::getRenderPipeline(const WGPURenderPipelineDescriptor& desc) {
+	Key key = createKey(desc);
+	auto found = pipelines.find(key);
+	if (found != pipelines.end()) {
+		hits++;
+		return found->second.pipeline;
+	}
+	misses++;
+
+	WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline(device, &desc);
+	if (!pipeline) {
+		return NULLPTR;
+	}
+
+	// hold on to everything identified by handle in the key
+	Entry entry = { pipeline, {}, desc.layout };
+	if (desc.layout) {
+		wgpuPipelineLayoutReference(desc.layout);
+	}
+	entry.modules.push_back(desc.vertexStage.module);
+	if (desc.fragmentStage) {
+		entry.modules.push_back(desc.fragmentStage->module);
+	}
+	for (auto it = entry.modules.begin(); it != entry.modules.end(); ++it) {
+		wgpuShaderModuleReference(*it);
+	}
+	pipelines.emplace(std::move(key), std::move(entry));
+	return pipeline;
+}
+
+void PipelineCache::clear() {
+	for (auto it = pipelines.begin(); it != pipelines.end(); ++it) {
+		wgpuRenderPipelineRelease(it->second.pipeline);
+		for (auto mod = it->second.modules.begin(); mod != it->second.modules.end(); ++mod) {
+			wgpuShaderModuleRelease(*mod);
+		}
+		if (it->second.layout) {
+			wgpuPipelineLayoutRelease(it->second.layout);
+		}
+	}
+	pipelines.clear();
+	for (auto it = shaders.begin(); it != shaders.end(); ++it) {
+		wgpuShaderModuleRelease(it->second);
+	}
+	shaders.clear();
+}
@@ -1,20 +1,221 @@
 #include "Renderer.h"
+#include "Trace.h"
+#include "VecMath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef __EMSCRIPTEN__
+#include "TracingPlatform.h"
+#include "WireTransport.h"
+#endif
+
+/**
+ * Bytes of uniform data available per frame (256 slots).
+ */
+#define UNIFORM_RING_SIZE (64 * 1024)
+
+/**
+ * Initial capacity (in instances) of each mesh's instance buffer.
+ */
+#define INSTANCE_BATCH_SIZE 64
+
+/**
+ * Instance buffers are both drawn from and, with GPU culling, read and
+ * written by the culling pass.
+ */
+#define INSTANCE_USAGE ((WGPUBufferUsage) (WGPUBufferUsage_Vertex | WGPUBufferUsage_Storage))
+
+/**
+ * Instances per chunk in GPU culling, each chunk being culled by a single
+ * invocation (copying its visible instances to a range of this many per level
+ * of detail) and drawn by an indirect draw per level. The culling shader sizes
+ * its array of picked levels, and the ranges, to match.
+ */
+#define CULL_CHUNK_SIZE 128
+
+/**
+ * Culling invocations per workgroup (matching the shader's
+ * \c workgroup_size), chunks being padded to a multiple of this.
+ */
+#define CULL_GROUP_SIZE 64
+
+/**
+ * Bytes of indirect draw arguments per chunk and level of detail (index
+ * count, instance count, first index, base vertex and first instance).
+ */
+#define CULL_ARGS_SIZE (5 * sizeof(uint32_t))
+
+/**
+ * Instance count uploaded with the draw arguments, which the culling pass
+ * always overwrites (so reading it back means the pass never ran).
+ */
+#define CULL_NOT_RUN 0xFFFFFFFFu
+
+/**
+ * Largest error (in pixels) a mesh's simplified levels of detail may show on
+ * screen (see \c #Renderer::selectLods()).
+ */
+#define LOD_PIXEL_ERROR 1.0f
+
+/**
+ * Fraction of \c #LOD_PIXEL_ERROR a coarser level of detail's error needs to
+ * be under before an instance switches to it, the gap keeping instances near
+ * a threshold from popping between levels every frame.
+ */
+#define LOD_HYSTERESIS 0.75f
+
+/**
+ * Frames still rendered after the last change or input (see
+ * \c #needsRedraw()), letting ImGui's hover highlights, popups, etc., settle.
+ */
+#define SETTLE_FRAMES 3
+
+/**
+ * Seconds between refreshes of the frame rate and ImGui stats shown in the
+ * panel.
+ */
+#define STATS_INTERVAL 1.0f
+
+/**
+ * Bytes per vertex of committed geometry (position \c x, \c y then colour
+ * \c r, \c g, \c b, all floats, as the triangle).
+ */
+#define GEOMETRY_VERTEX_SIZE (5 * sizeof(float))
+
+/**
+ * Untransformed, uncoloured instance (each mesh starts with one).
+ */
+static Transform const IDENTITY_TRANSFORM = {
+	{
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f,
+	},
+	{ 1.0f, 1.0f, 1.0f, 1.0f },
+};
+
+/**
+ * Default view-projection: flattening everything to \c z = 1 (so only the
+ * triangle's rotation applies).
+ */
+static float const FLAT_VIEW[16] = {
+	1.0f, 0.0f, 0.0f, 0.0f,
+	0.0f, 1.0f, 0.0f, 0.0f,
+	0.0f, 0.0f, 0.0f, 0.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,
+};
+
+/**
+ * Bounds of the triangle's vertices (which has no \c Mesh to ask).
+ */
+static float const TRIANGLE_BOUNDS[6] = {
+	-0.8f, -0.8f, 0.0f,
+	 0.8f,  0.8f, 0.0f,
+};
+
+/**
+ * A run of instances culled together on the GPU, all of the same mesh (as the
+ * culling shader's \c Chunk), with what's needed to pick their levels of
+ * detail as \c Renderer::selectLods() does.
+ */
+struct CullChunk
+{
+	float centre[3]; // mesh bounds (before the instance transforms)
+	uint32_t first;  // first instance
+	float extent[3];
+	uint32_t count;  // number of instances
+	float errors[MESH_MAX_LODS]; // error of each level of detail (in source position units)
+	float unquantize[3]; // per axis, from squared scales of stored positions to those of source positions
+	uint32_t lodCount;
+};
+static_assert(MESH_MAX_LODS == 4, "the culling shader holds the errors in a vec4");
+
+/**
+ * Uniforms of the culling pass (as the culling shader's \c View).
+ */
+struct CullView
+{
+	float planes[24];  // view frustum
+	float lodScale[4]; // pixels per unit at a clip-space w of one, w per unit, then the pixel error allowed
+	float depthRow[4]; // the view-projection's row giving clip-space w
+};
+
+/**
+ * Scales from the view-projection to a level of detail's error on screen.
+ *
+ * \param[in] view view-projection matrix the instances are drawn with
+ * \param[in] width render target width
+ * \param[in] height render target height
+ * \param[out] pixels pixels per unit at a clip-space w of one (for whichever axis covers more)
+ * \param[out] depthScale clip-space w per unit
+ */
+static void getLodScale(const float4x4& view, int width, int height, float& pixels, float& depthScale)
+{
+	float m[16];
+	view.store(m);
+	pixels = 0.5f * std::max(sqrtf(m[0] * m[0] + m[4] * m[4] + m[8] * m[8]) * width,
+		sqrtf(m[1] * m[1] + m[5] * m[5] + m[9] * m[9]) * height);
+	depthScale = sqrtf(m[3] * m[3] + m[7] * m[7] + m[11] * m[11]);
+}
+
+/**
+ * Fills the culling pass's uniforms for a view.
+ *
+ * \param[in] view view-projection matrix the instances are drawn with
+ * \param[in] width render target width
+ * \param[in] height render target height
+ * \param[out] out frustum planes and level of detail scales
+ */
+static void getCullView(const float4x4& view, int width, int height, CullView& out)
+{
+	float m[16];
+	view.store(m);
+	Frustum::getPlanes(view, out.planes);
+	getLodScale(view, width, height, out.lodScale[0], out.lodScale[1]);
+	out.lodScale[2] = LOD_PIXEL_ERROR;
+	out.lodScale[3] = 0.0f;
+	for (int c = 0; c < 4; c++) {
+		out.depthRow[c] = m[c * 4 + 3];
+	}
+}
 
 Renderer::Renderer()
 {
+	memcpy(viewProj, FLAT_VIEW, sizeof(viewProj));
 	this->setupShaders();
 }
 
 Renderer::~Renderer()
 {
+	for (size_t n = 0; n < geometry.size(); n++) {
+		free(geometry[n].data);
+	}
 #ifndef __EMSCRIPTEN__
+	for (auto it = batches.begin(); it != batches.end(); ++it) {
+		if (it->cullGroup) {
+			wgpuBindGroupRelease(it->cullGroup);
+		}
+	}
+	batches.clear();
+	if (cullPipeline) {
+		wgpuComputePipelineRelease(cullPipeline);
+		wgpuBindGroupLayoutRelease(cullGroupLayout);
+	}
 	wgpuBindGroupRelease(bindGroup);
-	wgpuBufferRelease(uRotBuf);
+	wgpuBindGroupLayoutRelease(uniformLayout);
+	wgpuPipelineLayoutRelease(pipelineLayout);
+	uniforms.release();
 	wgpuBufferRelease(indxBuf);
-	wgpuBufferRelease(vertBuf);
-	wgpuRenderPipelineRelease(pipeline);
-	wgpuSwapChainRelease(swapchain);
+	vertices.release();
+	pipelines.clear();
+	if (swapchain) {
+		wgpuSwapChainRelease(swapchain);
+	}
 	wgpuQueueRelease(queue);
 	wgpuDeviceRelease(device);
 #endif
@@ -23,28 +224,23 @@ Renderer::~Renderer()
 void Renderer::setupShaders()
 {
 	triangle_vert_wgsl = R"(
-	const PI : f32 = 3.141592653589793;
-	fn radians(degs : f32) -> f32 {
-		return (degs * PI) / 180.0;
-	}
-	[[block]] struct Rotation {
-		[[offset(0)]] degs : f32;
+	[[block]] struct View {
+		[[offset(0)]] matrix : mat4x4<f32>;
 	};
-	[[set(0), binding(0)]] var<uniform> uRot : Rotation;
-	[[location(0)]] var<in>  aPos : vec2<f32>;
+	[[set(0), binding(0)]] var<uniform> uView : View;
+	[[location(0)]] var<in>  aPos : vec3<f32>;
 	[[location(1)]] var<in>  aCol : vec3<f32>;	
+	[[location(2)]] var<in>  iModel0 : vec4<f32>;
+	[[location(3)]] var<in>  iModel1 : vec4<f32>;
+	[[location(4)]] var<in>  iModel2 : vec4<f32>;
+	[[location(5)]] var<in>  iModel3 : vec4<f32>;
+	[[location(6)]] var<in>  iCol : vec4<f32>;
 	[[location(0)]] var<out> vCol : vec3<f32>;
 	[[builtin(position)]] var<out> Position : vec4<f32>;
 	[[stage(vertex)]] fn main() -> void {
-		var rads : f32 = radians(uRot.degs);
-		var cosA : f32 = cos(rads);
-		var sinA : f32 = sin(rads);
-		var rot : mat3x3<f32> = mat3x3<f32>(
-			vec3<f32>( cosA, sinA, 0.0),
-			vec3<f32>(-sinA, cosA, 0.0),
-			vec3<f32>( 0.0,  0.0,  1.0));
-		Position = vec4<f32>(rot * vec3<f32>(aPos, 1.0), 1.0);
-		vCol = aCol;
+		var model : mat4x4<f32> = mat4x4<f32>(iModel0, iModel1, iModel2, iModel3);
+		Position = uView.matrix * (model * vec4<f32>(aPos, 1.0));
+		vCol = aCol * iCol.rgb;
 	}
 )";
 
@@ -55,6 +251,141 @@ void Renderer::setupShaders()
 		fragColor = vec4<f32>(vCol, 1.0);
 	}
 )";
+
+	// one invocation per chunk, picking each visible instance's level of detail then copying the instances (five vec4s
+	// each) to the chunk's range for that level, with an indirect draw per level (the ranges being bound in turn, since
+	// a first instance in the arguments needs a feature that isn't always there)
+	cull_comp_wgsl = R"(
+	[[block]] struct View {
+		[[offset(0)]]  planes : [[stride(16)]] array<vec4<f32>, 6>;
+		[[offset(96)]] lodScale : vec4<f32>;
+		[[offset(112)]] depthRow : vec4<f32>;
+	};
+	[[block]] struct Instances {
+		[[offset(0)]] data : [[stride(16)]] array<vec4<f32>>;
+	};
+	struct Chunk {
+		[[offset(0)]]  centre : vec3<f32>;
+		[[offset(12)]] first : u32;
+		[[offset(16)]] extent : vec3<f32>;
+		[[offset(28)]] count : u32;
+		[[offset(32)]] errors : vec4<f32>;
+		[[offset(48)]] unquantize : vec3<f32>;
+		[[offset(60)]] lodCount : u32;
+	};
+	[[block]] struct Chunks {
+		[[offset(0)]] data : [[stride(64)]] array<Chunk>;
+	};
+	[[block]] struct DrawArgs {
+		[[offset(0)]] data : [[stride(4)]] array<u32>;
+	};
+	[[set(0), binding(0)]] var<uniform> uView : View;
+	[[set(0), binding(1)]] var<storage_buffer> sInstances : Instances;
+	[[set(0), binding(2)]] var<storage_buffer> sChunks : Chunks;
+	[[set(0), binding(3)]] var<storage_buffer> sVisible : Instances;
+	[[set(0), binding(4)]] var<storage_buffer> sArgs : DrawArgs;
+	[[builtin(global_invocation_id)]] var<in> gid : vec3<u32>;
+	[[stage(compute), workgroup_size(64)]] fn main() -> void {
+		var chunk : u32 = gid.x;
+		var centre : vec3<f32> = sChunks.data[chunk].centre;
+		var extent : vec3<f32> = sChunks.data[chunk].extent;
+		var first : u32 = sChunks.data[chunk].first;
+		var count : u32 = sChunks.data[chunk].count;
+		var errors : vec4<f32> = sChunks.data[chunk].errors;
+		var unquantize : vec3<f32> = sChunks.data[chunk].unquantize;
+		var lodCount : u32 = sChunks.data[chunk].lodCount;
+		var radius : f32 = length(extent);
+		// level picked for each instance (4 if culled) and the instances per level
+		var picked : array<u32, 128>;
+		var counts : array<u32, 4>;
+		var n : u32 = 0u;
+		loop {
+			if (n >= count) {
+				break;
+			}
+			var src : u32 = (first + n) * 5u;
+			var m0 : vec4<f32> = sInstances.data[src];
+			var m1 : vec4<f32> = sInstances.data[src + 1u];
+			var m2 : vec4<f32> = sInstances.data[src + 2u];
+			var m3 : vec4<f32> = sInstances.data[src + 3u];
+			var c : vec3<f32> = (m0 * centre.x + m1 * centre.y + m2 * centre.z + m3).xyz;
+			var e : vec3<f32> = abs(m0.xyz) * extent.x + abs(m1.xyz) * extent.y + abs(m2.xyz) * extent.z;
+			var inside : bool = true;
+			var p : u32 = 0u;
+			loop {
+				if (p >= 6u) {
+					break;
+				}
+				var plane : vec4<f32> = uView.planes[p];
+				if (dot(plane.xyz, c) + plane.w + dot(abs(plane.xyz), e) < 0.0) {
+					inside = false;
+				}
+				continuing {
+					p = p + 1u;
+				}
+			}
+			var lod : u32 = 4u;
+			if (inside) {
+				// the coarsest level whose error stays under the limit, at the nearest depth of the bounds
+				lod = 0u;
+				var axes : vec3<f32> = vec3<f32>(dot(m0.xyz, m0.xyz), dot(m1.xyz, m1.xyz), dot(m2.xyz, m2.xyz));
+				var scales : vec3<f32> = axes * unquantize;
+				var stretch : f32 = max(max(axes.x, axes.y), axes.z);
+				var scale : f32 = max(max(scales.x, scales.y), scales.z);
+				var depth : f32 = dot(uView.depthRow.xyz, c) + uView.depthRow.w - radius * sqrt(stretch) * uView.lodScale.y;
+				if (depth > 0.0) {
+					var perUnit : f32 = sqrt(scale) * uView.lodScale.x / depth;
+					loop {
+						if (lod + 1u >= lodCount) {
+							break;
+						}
+						if (errors[lod + 1u] * perUnit > uView.lodScale.z) {
+							break;
+						}
+						lod = lod + 1u;
+					}
+				}
+				counts[lod] = counts[lod] + 1u;
+			}
+			picked[n] = lod;
+			continuing {
+				n = n + 1u;
+			}
+		}
+		var level : u32 = 0u;
+		loop {
+			if (level >= lodCount) {
+				break;
+			}
+			sArgs.data[(chunk * lodCount + level) * 5u + 1u] = counts[level];
+			continuing {
+				level = level + 1u;
+			}
+		}
+		// each level's instances go to its own range of the chunk's
+		var offsets : array<u32, 4>;
+		var i : u32 = 0u;
+		loop {
+			if (i >= count) {
+				break;
+			}
+			var at : u32 = picked[i];
+			if (at < 4u) {
+				var src : u32 = (first + i) * 5u;
+				var dst : u32 = ((chunk * lodCount + at) * 128u + offsets[at]) * 5u;
+				sVisible.data[dst]      = sInstances.data[src];
+				sVisible.data[dst + 1u] = sInstances.data[src + 1u];
+				sVisible.data[dst + 2u] = sInstances.data[src + 2u];
+				sVisible.data[dst + 3u] = sInstances.data[src + 3u];
+				sVisible.data[dst + 4u] = sInstances.data[src + 4u];
+				offsets[at] = offsets[at] + 1u;
+			}
+			continuing {
+				i = i + 1u;
+			}
+		}
+	}
+)";
 }
 
 /**
@@ -93,27 +424,94 @@ WGPUBuffer Renderer::createBuffer(const void* data, size_t size, WGPUBufferUsage
  * Bare minimum pipeline to draw a triangle using the above shaders.
  */
 void Renderer::createPipelineAndBuffers() {
-	// compile shaders
-	// NOTE: these are now the WGSL shaders (tested with Dawn and Chrome Canary)
-	WGPUShaderModule vertMod = createShader(triangle_vert_wgsl.c_str());
-	WGPUShaderModule fragMod = createShader(triangle_frag_wgsl.c_str());
+	pipelines.setDevice(device);
 
-	// bind group layout (used by both the pipeline layout and uniform bind group, released at the end of this function)
+	// bind group layout (used by both the pipeline layout and uniform bind group)
 	WGPUBindGroupLayoutEntry bglEntry = {};
 	bglEntry.binding = 0;
 	bglEntry.visibility = WGPUShaderStage_Vertex;
 	bglEntry.type = WGPUBindingType_UniformBuffer;
+	bglEntry.hasDynamicOffset = true;
 
 	WGPUBindGroupLayoutDescriptor bglDesc = {};
 	bglDesc.entryCount = 1;
 	bglDesc.entries = &bglEntry;
-	WGPUBindGroupLayout bindGroupLayout = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
+	uniformLayout = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
 
-	// pipeline layout (used by the render pipeline, released after its creation)
+	// pipeline layout (used by every mesh's render pipeline)
 	WGPUPipelineLayoutDescriptor layoutDesc = {};
 	layoutDesc.bindGroupLayoutCount = 1;
-	layoutDesc.bindGroupLayouts = &bindGroupLayout;
-	WGPUPipelineLayout pipelineLayout = wgpuDeviceCreatePipelineLayout(device, &layoutDesc);
+	layoutDesc.bindGroupLayouts = &uniformLayout;
+	pipelineLayout = wgpuDeviceCreatePipelineLayout(device, &layoutDesc);
+
+	// create the buffers (x, y, r, g, b)
+	float const vertData[] = {
+		-0.8f, -0.8f, 0.0f, 0.0f, 1.0f, // BL
+		 0.8f, -0.8f, 0.0f, 1.0f, 0.0f, // BR
+		-0.0f,  0.8f, 1.0f, 0.0f, 0.0f, // top
+	};
+	uint32_t const indxData[] = {
+		0, 1, 2,
+	};
+	vertices.create(*this, vertData, sizeof(vertData), WGPUBufferUsage_Vertex);
+	indxBuf = Mesh::createIndexBuffer(*this, indxData, 3, 3, indxFormat);
+
+	// the triangle starts with a single untransformed instance
+	batches.resize(1);
+	batches[0].pipeline = getPipeline(VertexLayout().add(MESH_POSITION, MESH_FLOAT, 2).add(MESH_COLOR, MESH_FLOAT, 3));
+	batches[0].buffer.create(*this, nullptr, INSTANCE_BATCH_SIZE * sizeof(Transform), INSTANCE_USAGE);
+	batches[0].visible.create(*this, nullptr, INSTANCE_BATCH_SIZE * sizeof(Transform), INSTANCE_USAGE);
+	addInstances(0, std::span<const Transform>(&IDENTITY_TRANSFORM, 1));
+
+	// create the uniform ring and its bind group
+	uniforms.create(device, UNIFORM_RING_SIZE);
+	createUniformBindGroup();
+}
+
+/**
+ * Creates the uniform bind group (over one slot of the ring, the slot being
+ * picked by the dynamic offset).
+ */
+void Renderer::createUniformBindGroup() {
+	WGPUBindGroupEntry bgEntry = {};
+	bgEntry.binding = 0;
+	bgEntry.buffer = uniforms.getBuffer();
+	bgEntry.offset = 0;
+	bgEntry.size = sizeof(float4x4);
+
+	WGPUBindGroupDescriptor bgDesc = {};
+	bgDesc.layout = uniformLayout;
+	bgDesc.entryCount = 1;
+	bgDesc.entries = &bgEntry;
+
+	bindGroup = wgpuDeviceCreateBindGroup(device, &bgDesc);
+}
+
+/**
+ * Grows the uniform ring after this frame's uniforms didn't fit (before any
+ * commands use their offsets), recreating the bind groups over it.
+ */
+void Renderer::growUniforms() {
+	uniforms.grow(device);
+	wgpuBindGroupRelease(bindGroup);
+	createUniformBindGroup();
+	chunksStale = true; // the culling bind groups read the frustum planes from the ring too
+}
+
+/**
+ * Pipeline drawing meshes with the given vertex layout using the above
+ * shaders (each distinct layout compiling its own, the rest coming from the
+ * cache). The mesh's streams are bound from slot zero, followed by the
+ * instance stream.
+ *
+ * \param[in] layout mesh vertex layout (with at least positions and colours)
+ * \return pipeline owned by the cache
+ */
+WGPURenderPipeline Renderer::getPipeline(const VertexLayout& layout) {
+	// compile shaders (owned by the cache, which returns the same module for the same source)
+	// NOTE: these are now the WGSL shaders (tested with Dawn and Chrome Canary)
+	WGPUShaderModule vertMod = pipelines.getShaderModule(triangle_vert_wgsl);
+	WGPUShaderModule fragMod = pipelines.getShaderModule(triangle_frag_wgsl);
 
 	// begin pipeline set-up
 	WGPURenderPipelineDescriptor desc = {};
@@ -128,21 +526,29 @@ void Renderer::createPipelineAndBuffers() {
 	fragStage.entryPoint = "main";
 	desc.fragmentStage = &fragStage;
 
-	// describe buffer layouts
-	WGPUVertexAttributeDescriptor vertAttrs[2] = {};
-	vertAttrs[0].format = WGPUVertexFormat_Float2;
-	vertAttrs[0].offset = 0;
-	vertAttrs[0].shaderLocation = 0;
-	vertAttrs[1].format = WGPUVertexFormat_Float3;
-	vertAttrs[1].offset = 2 * sizeof(float);
-	vertAttrs[1].shaderLocation = 1;
-	WGPUVertexBufferLayoutDescriptor vertDesc = {};
-	vertDesc.arrayStride = 5 * sizeof(float);
-	vertDesc.attributeCount = 2;
-	vertDesc.attributes = vertAttrs;
+	// describe buffer layouts (the mesh's streams, then per-instance transform and colour)
+	WGPUVertexAttributeDescriptor instAttrs[5] = {};
+	for (uint32_t n = 0; n < 4; n++) {
+		instAttrs[n].format = WGPUVertexFormat_Float4;
+		instAttrs[n].offset = n * 4 * sizeof(float);
+		instAttrs[n].shaderLocation = 2 + n;
+	}
+	instAttrs[4].format = WGPUVertexFormat_Float4;
+	instAttrs[4].offset = offsetof(Transform, color);
+	instAttrs[4].shaderLocation = 6;
+	WGPUVertexBufferLayoutDescriptor vertDesc[MESH_MAX_STREAMS + 1] = {};
+	uint32_t streamCount = layout.getStreamCount();
+	const WGPUVertexBufferLayoutDescriptor* meshDesc = layout.getBufferLayouts();
+	for (uint32_t n = 0; n < streamCount; n++) {
+		vertDesc[n] = meshDesc[n];
+	}
+	vertDesc[streamCount].arrayStride = sizeof(Transform);
+	vertDesc[streamCount].stepMode = WGPUInputStepMode_Instance;
+	vertDesc[streamCount].attributeCount = 5;
+	vertDesc[streamCount].attributes = instAttrs;
 	WGPUVertexStateDescriptor vertState = {};
-	vertState.vertexBufferCount = 1;
-	vertState.vertexBuffers = &vertDesc;
+	vertState.vertexBufferCount = streamCount + 1;
+	vertState.vertexBuffers = vertDesc;
 
 	desc.vertexState = &vertState;
 	desc.primitiveTopology = WGPUPrimitiveTopology_TriangleList;
@@ -165,50 +571,14 @@ void Renderer::createPipelineAndBuffers() {
 
 	desc.sampleMask = 0xFFFFFFFF; // <-- Note: this currently causes Emscripten to fail (sampleMask ends up as -1, which trips an assert)
 
-	pipeline = wgpuDeviceCreateRenderPipeline(device, &desc);
-
-	// partial clean-up (just move to the end, no?)
-	wgpuPipelineLayoutRelease(pipelineLayout);
-
-	wgpuShaderModuleRelease(fragMod);
-	wgpuShaderModuleRelease(vertMod);
-
-	// create the buffers (x, y, r, g, b)
-	float const vertData[] = {
-		-0.8f, -0.8f, 0.0f, 0.0f, 1.0f, // BL
-		 0.8f, -0.8f, 0.0f, 1.0f, 0.0f, // BR
-		-0.0f,  0.8f, 1.0f, 0.0f, 0.0f, // top
-	};
-	uint16_t const indxData[] = {
-		0, 1, 2,
-		0 // padding (better way of doing this?)
-	};	
-	vertBuf = createBuffer(vertData, sizeof(vertData), WGPUBufferUsage_Vertex);
-	indxBuf = createBuffer(indxData, sizeof(indxData), WGPUBufferUsage_Index);
-
-	// create the uniform bind group (note 'rotDeg' is copied here, not bound in any way)
-	uRotBuf = createBuffer(&rotDeg, sizeof(rotDeg), WGPUBufferUsage_Uniform);
-
-	WGPUBindGroupEntry bgEntry = {};
-	bgEntry.binding = 0;
-	bgEntry.buffer = uRotBuf;
-	bgEntry.offset = 0;
-	bgEntry.size = sizeof(rotDeg);
-
-	WGPUBindGroupDescriptor bgDesc = {};
-	bgDesc.layout = bindGroupLayout;
-	bgDesc.entryCount = 1;
-	bgDesc.entries = &bgEntry;
-
-	bindGroup = wgpuDeviceCreateBindGroup(device, &bgDesc);
-
-	// last bit of clean-up
-	wgpuBindGroupLayoutRelease(bindGroupLayout);
+	return pipelines.getRenderPipeline(desc);
 }
 
 
 /**
- * ImGui setup function that is called only once.
+ * ImGui setup function that is called only once. Passing a \c null window
+ * (headless, or when rendering on its own thread) leaves ImGui without its
+ * GLFW backend, with input then coming through \c #processInput().
  * 
  * NOTICE: This is the only place where GLFW is needed in the Renderer. 
  * If you do not want to use ImGui, you can get rid of GLFW too.
@@ -230,8 +600,40 @@ void Renderer::setupImGui(GLFWwindow* window) {
 	ImGui::StyleColorsDark();
 	//ImGui::StyleColorsClassic();
 
-	// Setup Platform/Renderer backends				
-	ImGui_ImplGlfw_InitForOther(window, true);
+	// Setup Platform/Renderer backends (headless builds have no window, see renderImGui())
+#ifndef RENDERER_HEADLESS
+	if (window) {
+		ImGui_ImplGlfw_InitForOther(window, true);
+		imguiGlfw = true;
+	}
+#else
+	(void) window;
+#endif
+	if (!imguiGlfw) {
+		// the keys ImGui needs for navigation and text editing (as the GLFW backend maps them)
+		io.KeyMap[ImGuiKey_Tab]         = GLFW_KEY_TAB;
+		io.KeyMap[ImGuiKey_LeftArrow]   = GLFW_KEY_LEFT;
+		io.KeyMap[ImGuiKey_RightArrow]  = GLFW_KEY_RIGHT;
+		io.KeyMap[ImGuiKey_UpArrow]     = GLFW_KEY_UP;
+		io.KeyMap[ImGuiKey_DownArrow]   = GLFW_KEY_DOWN;
+		io.KeyMap[ImGuiKey_PageUp]      = GLFW_KEY_PAGE_UP;
+		io.KeyMap[ImGuiKey_PageDown]    = GLFW_KEY_PAGE_DOWN;
+		io.KeyMap[ImGuiKey_Home]        = GLFW_KEY_HOME;
+		io.KeyMap[ImGuiKey_End]         = GLFW_KEY_END;
+		io.KeyMap[ImGuiKey_Insert]      = GLFW_KEY_INSERT;
+		io.KeyMap[ImGuiKey_Delete]      = GLFW_KEY_DELETE;
+		io.KeyMap[ImGuiKey_Backspace]   = GLFW_KEY_BACKSPACE;
+		io.KeyMap[ImGuiKey_Space]       = GLFW_KEY_SPACE;
+		io.KeyMap[ImGuiKey_Enter]       = GLFW_KEY_ENTER;
+		io.KeyMap[ImGuiKey_Escape]      = GLFW_KEY_ESCAPE;
+		io.KeyMap[ImGuiKey_KeyPadEnter] = GLFW_KEY_KP_ENTER;
+		io.KeyMap[ImGuiKey_A]           = GLFW_KEY_A;
+		io.KeyMap[ImGuiKey_C]           = GLFW_KEY_C;
+		io.KeyMap[ImGuiKey_V]           = GLFW_KEY_V;
+		io.KeyMap[ImGuiKey_X]           = GLFW_KEY_X;
+		io.KeyMap[ImGuiKey_Y]           = GLFW_KEY_Y;
+		io.KeyMap[ImGuiKey_Z]           = GLFW_KEY_Z;
+	}
 	ImGui_ImplWGPU_Init(device, 3, WGPUTextureFormat_RGBA8Unorm);
 
 	// Load Fonts
@@ -261,12 +663,36 @@ void Renderer::renderImGui()
 	if (!this->_showImGui) {
 		return;
 	}
+	TRACE_SCOPE("Renderer::renderImGui");
 
 	// Start the Dear ImGui frame
 	ImGui_ImplWGPU_NewFrame();
-	ImGui_ImplGlfw_NewFrame();
+	if (imguiGlfw) {
+#ifndef RENDERER_HEADLESS
+		ImGui_ImplGlfw_NewFrame();
+#endif
+	} else {
+		// without the GLFW backend the display size and timing are ours to fill
+		ImGuiIO& io = ImGui::GetIO();
+		io.DisplaySize = ImVec2((float) width, (float) height);
+		io.DeltaTime = frameTime;
+	}
 	ImGui::NewFrame();
 
+	// keep rendering while ImGui has input to react to (or a text cursor to blink)
+	ImGuiIO& io = ImGui::GetIO();
+	bool active = io.MouseDelta.x != 0.0f || io.MouseDelta.y != 0.0f || io.MouseWheel != 0.0f || io.MouseWheelH != 0.0f
+		|| io.InputQueueCharacters.Size > 0 || io.WantTextInput;
+	for (int n = 0; n < IM_ARRAYSIZE(io.MouseDown) && !active; n++) {
+		active = io.MouseDown[n];
+	}
+	for (int n = 0; n < IM_ARRAYSIZE(io.KeysDown) && !active; n++) {
+		active = io.KeysDown[n];
+	}
+	if (active) {
+		settleFrames = SETTLE_FRAMES;
+	}
+
 	// Show a simple window that we create ourselves. We use a Begin/End pair to created a named window.
 	ImGui::Begin("WebRenderer");                                // Create a window called "Hello, world!" and append into it.
 
@@ -276,7 +702,30 @@ void Renderer::renderImGui()
 	ImGui::ColorEdit3("Vertex 2", (float*)&vertex2);       // Edit 3 floats representing a color
 	ImGui::ColorEdit3("Vertex 3", (float*)&vertex3);       // Edit 3 floats representing a color
 
-	ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+	const ImGui_ImplWGPU_Stats* imguiStats = ImGui_ImplWGPU_GetStats();
+	statsAge += io.DeltaTime;
+	if (statsAge >= STATS_INTERVAL || statsFramerate == 0.0f) {
+		statsAge = 0.0f;
+		statsFramerate = io.Framerate;
+		statsReplayed = imguiStats->ReplayedFrames;
+	}
+	ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / statsFramerate, statsFramerate);
+	ImGui::Text("Pipeline cache: %u hits, %u misses", pipelines.getHits(), pipelines.getMisses());
+	bool cullOnGpu = gpuCulling;
+	if (ImGui::Checkbox("GPU culling", &cullOnGpu)) {
+		setGpuCulling(cullOnGpu);
+	}
+	if (!gpuCulling) {
+		ImGui::Text("Visible instances: %u / %u", visibleTotal, bvh.getObjectCount());
+		ImGui::Text("Visible triangles: %llu", (unsigned long long) visibleTriangles);
+	}
+	ImGui::Text("ImGui buffers: %u KiB, %u grows, %u shrinks", (unsigned) (imguiStats->AllocatedBytes / 1024), imguiStats->Grows, imguiStats->Shrinks);
+	ImGui::Text("ImGui replayed frames: %u", statsReplayed);
+#ifndef __EMSCRIPTEN__
+	if (Trace::isEnabled() && ImGui::Button("Save trace")) {
+		TracingPlatform::dump();
+	}
+#endif
 	ImGui::End();
 
 	// Rendering
@@ -288,6 +737,10 @@ void Renderer::renderImGui()
  */
 WGPUSwapChain Renderer::resize(int width, int height)
 {
+	this->width = width;
+	this->height = height;
+	this->dirty = true;
+
 #ifdef __EMSCRIPTEN__
 	/*ImGui_ImplWGPU_InvalidateDeviceObjects();
 
@@ -309,11 +762,117 @@ WGPUSwapChain Renderer::resize(int width, int height)
 	return this->swapchain;
 }
 
+/**
+ * Handles the input queued by a threaded window, passing it to the mouse, key
+ * and resize handlers and (without its GLFW backend) to ImGui.
+ */
+void Renderer::processInput()
+{
+	ImGuiIO& io = ImGui::GetIO();
+	InputEvent event;
+	while (input.pop(event)) {
+		dirty = true;
+		switch (event.type) {
+		case InputEvent::MOUSE_BUTTON:
+			mouseClicked(event.button, event.action, (int) event.x, (int) event.y);
+			if (!imguiGlfw && event.button >= 0 && event.button < IM_ARRAYSIZE(io.MouseDown)) {
+				// ImGui orders the buttons left, right, middle (as do our constants)
+				io.MouseDown[event.button] = (event.action == ACTION_PRESSED);
+				io.MousePos = ImVec2((float) event.x, (float) event.y);
+			}
+			break;
+		case InputEvent::MOUSE_MOVE:
+			if (!imguiGlfw) {
+				io.MousePos = ImVec2((float) event.x, (float) event.y);
+			}
+			break;
+		case InputEvent::MOUSE_SCROLL:
+			if (!imguiGlfw) {
+				io.MouseWheelH += (float) event.x;
+				io.MouseWheel  += (float) event.y;
+			}
+			break;
+		case InputEvent::KEY:
+			keyPressed(event.button, event.action);
+			if (!imguiGlfw && event.button >= 0 && event.button < IM_ARRAYSIZE(io.KeysDown)) {
+				io.KeysDown[event.button] = (event.action != ACTION_RELEASED);
+				io.KeyCtrl  = io.KeysDown[GLFW_KEY_LEFT_CONTROL] || io.KeysDown[GLFW_KEY_RIGHT_CONTROL];
+				io.KeyShift = io.KeysDown[GLFW_KEY_LEFT_SHIFT]   || io.KeysDown[GLFW_KEY_RIGHT_SHIFT];
+				io.KeyAlt   = io.KeysDown[GLFW_KEY_LEFT_ALT]     || io.KeysDown[GLFW_KEY_RIGHT_ALT];
+				io.KeySuper = io.KeysDown[GLFW_KEY_LEFT_SUPER]   || io.KeysDown[GLFW_KEY_RIGHT_SUPER];
+			}
+			break;
+		case InputEvent::CHAR:
+			if (!imguiGlfw) {
+				io.AddInputCharacter((unsigned) event.button);
+			}
+			break;
+		case InputEvent::RESIZE:
+			resize(event.button, event.action);
+			break;
+		}
+	}
+}
+
+/**
+ * Applies the property updates flushed to \c #commands since the last frame
+ * (in order, so the last update to each property wins).
+ */
+void Renderer::applyCommands()
+{
+	ImVec4* vertexColors[] = {&vertex1, &vertex2, &vertex3};
+	Command cmd;
+	while (commands.next(cmd)) {
+		switch (cmd.op) {
+		case CMD_SHOW_IMGUI:
+			showImGui(cmd.args[0].u != 0);
+			break;
+		case CMD_SET_COLOR:
+			setColor(cmd.args[0].f, cmd.args[1].f, cmd.args[2].f);
+			break;
+		case CMD_SET_VERTEX_COLOR:
+			if (cmd.args[0].u < IM_ARRAYSIZE(vertexColors)) {
+				*vertexColors[cmd.args[0].u] = ImVec4(cmd.args[1].f, cmd.args[2].f, cmd.args[3].f, 1.0f);
+				dirty = true;
+			}
+			break;
+		case CMD_SET_CLEAR_COLOR:
+			clear_color = ImVec4(cmd.args[0].f, cmd.args[1].f, cmd.args[2].f, cmd.args[3].f);
+			dirty = true;
+			break;
+		case CMD_SET_SPEED:
+			speed = cmd.args[0].f;
+			dirty = true;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
 /**
  * Main rendering loop.
  */
-bool Renderer::render(double /*time*/) 
+bool Renderer::render(double time) 
 {	
+	TRACE_SCOPE("Renderer::render");
+
+	// frame timing for ImGui without its GLFW backend (which measures its own)
+	frameTime = (time > lastTime) ? (float) (time - lastTime) : 1.0f / 60.0f;
+	lastTime = time;
+
+	// input from a threaded window and property updates from JavaScript
+	this->processInput();
+	this->applyCommands();
+	this->finishMeshes();
+	this->updateScene();
+
+	// anything changed since the last frame needs a few more to settle
+	if (dirty) {
+		dirty = false;
+		settleFrames = SETTLE_FRAMES;
+	}
+
 	// ImGui rendering 
 	this->renderImGui();	
 	
@@ -334,30 +893,93 @@ bool Renderer::render(double /*time*/)
 	renderPass.colorAttachments = &colorDesc;
 	//renderPass.depthStencilAttachment = NULL;
 
+	// update the rotation, combined with the view-projection as a matrix copied into the ring
+	rotDeg += 0.1f * speed * dir;
+	float4x4 view = float4x4::load(viewProj) * float4x4::rotationZ(rotDeg * 3.14159265f / 180.0f);
+	CullView cullUniforms;
+	if (gpuCulling) {
+		view.store(cullView);
+		getCullView(view, width, height, cullUniforms);
+	}
+
+	// every uniform is pushed before anything is encoded, so a full ring can still grow
+	uint32_t rotOffset;
+	uint32_t frustumOffset = 0;
+	while (true) {
+		rotOffset = uniforms.push(&view, sizeof(view));
+		if (gpuCulling) {
+			frustumOffset = uniforms.push(&cullUniforms, sizeof(cullUniforms));
+		}
+		if (!uniforms.isFull()) {
+			break;
+		}
+		this->growUniforms();
+	}
+
 	// create encoder
 	WGPUCommandEncoderDescriptor enc_desc = {};
 	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, nullptr);
 
+	// only instances in view are drawn (found either here or by a compute pass ahead of the render pass)
+	if (gpuCulling) {
+		this->encodeCulling(encoder, frustumOffset);
+	} else {
+		this->cullInstances(view);
+	}
+
 	WGPURenderPassEncoder pass = wgpuCommandEncoderBeginRenderPass(encoder, &renderPass);	// create pass
-	
-	// update the rotation
-	rotDeg += 0.1f * speed * dir;
-	wgpuQueueWriteBuffer(queue, uRotBuf, 0, &rotDeg, sizeof(rotDeg));
 
-	// update the colors
+	// update the colors (only the bytes that changed are uploaded, if any)
 	float const vertData[] = {
 		-0.8f, -0.8f, vertex1.x, vertex1.y, vertex1.z, // BL
 		 0.8f, -0.8f, vertex2.x, vertex2.y, vertex2.z, // BR
 		-0.0f,  0.8f, vertex3.x, vertex3.y, vertex3.z, // top
 	};
-	wgpuQueueWriteBuffer(queue, vertBuf, 0, vertData, sizeof(vertData));
-
-	// draw the triangle (comment these five lines to simply clear the screen)
-	wgpuRenderPassEncoderSetPipeline(pass, pipeline);
-	wgpuRenderPassEncoderSetBindGroup(pass, 0, bindGroup, 0, 0);
-	wgpuRenderPassEncoderSetVertexBuffer(pass, 0, vertBuf, 0, 0);
-	wgpuRenderPassEncoderSetIndexBuffer(pass, indxBuf, WGPUIndexFormat_Uint16, 0, 0);
-	wgpuRenderPassEncoderDrawIndexed(pass, 3, 1, 0, 0, 0);
+	vertices.write(0, vertData, sizeof(vertData));
+
+	// draw every visible instance of each mesh in one call (comment these lines to simply clear the screen)
+	WGPURenderPipeline bound = nullptr;
+	for (size_t m = 0; m < batches.size(); m++) {
+		InstanceBatch& batch = batches[m];
+		uint32_t drawCount = (gpuCulling) ? batch.chunkCount : batch.visibleCount;
+		if (drawCount == 0 || (m > 0 && batch.mesh.getIndexCount() == 0)) {
+			continue; // nothing to draw (or the mesh is still being optimized)
+		}
+		WGPUBuffer instances = (!gpuCulling && !batch.compacted) ? batch.buffer.getBuffer() : batch.visible.getBuffer();
+		if (batch.pipeline != bound) {
+			wgpuRenderPassEncoderSetPipeline(pass, batch.pipeline);
+			wgpuRenderPassEncoderSetBindGroup(pass, 0, bindGroup, 1, &rotOffset);
+			bound = batch.pipeline;
+		}
+		if (m == 0) {
+			wgpuRenderPassEncoderSetVertexBuffer(pass, 0, vertices.getBuffer(), 0, 0);
+			wgpuRenderPassEncoderSetIndexBuffer(pass, indxBuf, indxFormat, 0, 0);
+			wgpuRenderPassEncoderSetVertexBuffer(pass, 1, instances, 0, 0);
+		} else {
+			batch.mesh.bind(pass);
+			wgpuRenderPassEncoderSetVertexBuffer(pass, batch.mesh.getLayout().getStreamCount(), instances, 0, 0);
+		}
+		if (gpuCulling) {
+			// each chunk's visible instances for each level are in their own range (bound in place of a first instance)
+			uint32_t slot = (m == 0) ? 1 : batch.mesh.getLayout().getStreamCount();
+			for (uint32_t n = 0; n < batch.chunkCount * batch.cullLods; n++) {
+				wgpuRenderPassEncoderSetVertexBuffer(pass, slot, instances, n * CULL_CHUNK_SIZE * sizeof(Transform), CULL_CHUNK_SIZE * sizeof(Transform));
+				wgpuRenderPassEncoderDrawIndexedIndirect(pass, batch.drawArgs.getBuffer(), n * CULL_ARGS_SIZE);
+			}
+		} else {
+			// the instances are grouped by level of detail, each level drawing its own range of the indices
+			uint32_t firstInstance = 0;
+			for (uint32_t lod = 0; lod < MESH_MAX_LODS; lod++) {
+				if (batch.lodCounts[lod] == 0) {
+					continue;
+				}
+				uint32_t indexCount = (m == 0) ? 3 : batch.mesh.getLod(lod).indexCount;
+				uint32_t firstIndex = (m == 0) ? 0 : batch.mesh.getLod(lod).firstIndex;
+				wgpuRenderPassEncoderDrawIndexed(pass, indexCount, batch.lodCounts[lod], firstIndex, 0, firstInstance);
+				firstInstance += batch.lodCounts[lod];
+			}
+		}
+	}
 
 	if (_showImGui) {
 		ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), pass);
@@ -369,7 +991,11 @@ bool Renderer::render(double /*time*/)
 	WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);				// create commands
 	wgpuCommandEncoderRelease(encoder);														// release encoder
 
-	wgpuQueueSubmit(queue, 1, &commands);
+	{
+		TRACE_SCOPE("Renderer::submit");
+		this->flushBuffers();
+		wgpuQueueSubmit(queue, 1, &commands);
+	}
 	wgpuCommandBufferRelease(commands);														// release commands
 
 #ifndef __EMSCRIPTEN__
@@ -377,10 +1003,42 @@ bool Renderer::render(double /*time*/)
 #endif
 	wgpuTextureViewRelease(backBufView);													// release textureView
 
+	if (settleFrames > 0) {
+		settleFrames--;
+	}
 
 	return true;
 }
 
+/**
+ * Uploads everything written since the last submit, ahead of the commands
+ * using it.
+ */
+void Renderer::flushBuffers()
+{
+	uniforms.flush(queue);																// upload this frame's uniforms
+	vertices.flush(queue);																// upload modified vertex data
+	for (auto it = batches.begin(); it != batches.end(); ++it) {
+		it->buffer.flush(queue);														// upload new/modified instances
+		it->visible.flush(queue);														// upload changes to those in view
+		it->chunks.flush(queue);														// upload GPU culling chunks and arguments
+		it->drawArgs.flush(queue);
+	}
+}
+
+/**
+ * Whether the next frame would differ from the last, for windows rendering
+ * only on demand: something changed (or has yet to be applied), ImGui is
+ * reacting to input, the triangle is rotating, scene nodes moved, or meshes
+ * are still being optimized. Frames are otherwise identical and can be skipped.
+ *
+ * \return \c true if \c #render() should be called
+ */
+bool Renderer::needsRedraw()
+{
+	return dirty || settleFrames > 0 || speed != 0.0f || !input.empty() || !commands.empty() || !pendingMeshes.empty() || scene.needsUpdate();
+}
+
 /**
  * Mouse handling function.
  */
@@ -392,6 +1050,8 @@ void Renderer::mouseClicked(int button, int action, int x, int y)
 		}		
 	}
 
+	dirty = true;
+
 	printf("button:%d action:%d x:%d y:%d\n", button, action, x, y);
 }
 
@@ -400,6 +1060,8 @@ void Renderer::mouseClicked(int button, int action, int x, int y)
  */
 void Renderer::keyPressed(int button, int action)
 {	
+	dirty = true;
+
 	printf("key:%d action:%d\n", button, action);
 }
 
@@ -409,6 +1071,7 @@ void Renderer::keyPressed(int button, int action)
 void Renderer::showImGui(bool state)
 {
 	this->_showImGui = state;
+	this->dirty = true;
 }
 
 /**
@@ -419,4 +1082,937 @@ void Renderer::setColor(float r, float g, float b)
 	this->vertex1.x = r;
 	this->vertex1.y = g;
 	this->vertex1.z = b;
+	this->dirty = true;
+}
+
+/**
+ * Sets the view-projection matrix, applied after the triangle's rotation and
+ * used to cull instances out of view (which is clip space \c -w to \c w in
+ * \c x and \c y, and \c 0 to \c w in \c z).
+ *
+ * \param[in] matrix column-major matrix (or \c null to flatten everything to \c z = 1, the default)
+ */
+void Renderer::setViewProjection(const float* matrix)
+{
+	memcpy(viewProj, (matrix) ? matrix : FLAT_VIEW, sizeof(viewProj));
+	this->dirty = true;
+}
+
+/**
+ * Adds instances of a mesh, all of which are drawn with a single instanced
+ * draw call (per level of detail). For meshes with quantized positions the
+ * stored transforms include the mapping back to the mesh's bounds.
+ *
+ * \param[in] meshId mesh to instance (\c 0 being the triangle)
+ * \param[in] instances per-instance transforms and colours
+ * \return \c false if \a meshId doesn't exist (or the instances couldn't be stored)
+ */
+bool Renderer::addInstances(uint32_t meshId, std::span<const Transform> instances)
+{
+	if (meshId >= batches.size()) {
+		return false;
+	}
+	InstanceBatch& batch = batches[meshId];
+	size_t offset = batch.count * sizeof(Transform);
+	batch.buffer.reserve(*this, offset + instances.size_bytes());
+	if (batch.mesh.isQuantized()) {
+		float dequantize[16];
+		batch.mesh.getDequantize(dequantize);
+		Transform* dst = static_cast<Transform*>(batch.buffer.modify(offset, instances.size_bytes()));
+		if (!dst) {
+			return false;
+		}
+		memcpy(dst, instances.data(), instances.size_bytes());
+		VecMath::multiplyMatrices(dst->matrix, float4x4::load(dequantize), dst->matrix, instances.size(), sizeof(Transform) / sizeof(float));
+	} else if (!batch.buffer.write(offset, instances.data(), instances.size_bytes())) {
+		return false;
+	}
+	batch.count += (uint32_t) instances.size();
+	bvhStale = true;
+	chunksStale = true;
+	dirty = true;
+	return true;
+}
+
+/**
+ * Removes all instances of a mesh (keeping the buffer for reuse).
+ *
+ * \param[in] meshId mesh whose instances to remove
+ */
+void Renderer::clearInstances(uint32_t meshId)
+{
+	if (meshId < batches.size()) {
+		batches[meshId].count = 0;
+		bvhStale = true;
+		chunksStale = true;
+		dirty = true;
+	}
+}
+
+/**
+ * Adds a scene node (see \c #getScene() to move it), optionally positioning a
+ * new instance of a mesh: the instance's matrix then follows the node's world
+ * matrix, updated at the start of each frame only for nodes that moved (or
+ * whose ancestors did).
+ *
+ * \param[in] parent node to attach to (or \c #SCENE_NO_PARENT for a root)
+ * \param[in] meshId mesh to add an instance of (zero for none, since the triangle can't be placed)
+ * \return index of the node (or \c #SCENE_NO_PARENT if \a parent or \a meshId doesn't exist)
+ */
+uint32_t Renderer::addNode(uint32_t parent, uint32_t meshId)
+{
+	if (meshId >= batches.size() || (parent != SCENE_NO_PARENT && parent >= scene.size())) {
+		return SCENE_NO_PARENT;
+	}
+	uint32_t instance = 0;
+	if (meshId > 0) {
+		instance = batches[meshId].count;
+		addInstances(meshId, std::span<const Transform>(&IDENTITY_TRANSFORM, 1));
+	}
+	return scene.add(parent, meshId, instance);
+}
+
+/**
+ * Brings the scene's world matrices up to date, copying those that changed
+ * into their instances (only the matrices, leaving the colours as they are).
+ */
+void Renderer::updateScene()
+{
+	if (!scene.needsUpdate()) {
+		return;
+	}
+	TRACE_SCOPE("Renderer::updateScene");
+	scene.update();
+	uint32_t lastMesh = 0;
+	float4x4 dequantize;
+	for (uint32_t node : scene.getChanged()) {
+		uint32_t meshId = scene.getMesh(node);
+		uint32_t instance = scene.getInstance(node);
+		if (meshId == 0 || meshId >= batches.size() || instance >= batches[meshId].count) {
+			continue;
+		}
+		InstanceBatch& batch = batches[meshId];
+		float* matrix = static_cast<float*>(batch.buffer.modify(instance * sizeof(Transform) + offsetof(Transform, matrix),
+			sizeof(Transform::matrix)));
+		if (!matrix) {
+			continue;
+		}
+		if (batch.mesh.isQuantized()) {
+			if (meshId != lastMesh) {
+				float m[16];
+				batch.mesh.getDequantize(m);
+				dequantize = float4x4::load(m);
+				lastMesh = meshId;
+			}
+			(float4x4::load(scene.getWorld(node)) * dequantize).store(matrix);
+		} else {
+			memcpy(matrix, scene.getWorld(node), sizeof(Transform::matrix));
+		}
+		// moved instances refit the BVH (unless it's being rebuilt anyway)
+		if (!bvhStale && batch.culled) {
+			float bounds[6];
+			float moved[6];
+			batch.mesh.getBounds(bounds, bounds + 3);
+			VecMath::transformBounds(matrix, bounds, bounds + 3, moved, moved + 3, 1);
+			bvh.update(batch.firstObject + instance, moved, moved + 3);
+		}
+	}
+	dirty = true;
+}
+
+/**
+ * Builds the BVH over the world-space bounds of every instance (of meshes
+ * whose bounds are known, i.e. not still being optimized).
+ */
+void Renderer::rebuildBvh()
+{
+	TRACE_SCOPE("Renderer::rebuildBvh");
+	uint32_t total = 0;
+	for (size_t m = 0; m < batches.size(); m++) {
+		InstanceBatch& batch = batches[m];
+		batch.culled = (m == 0 || batch.mesh.getIndexCount() > 0);
+		batch.firstObject = total;
+		if (batch.culled) {
+			total += batch.count;
+		}
+	}
+	objectBatches.resize(total);
+	objectBounds.resize((size_t) total * 6);
+	float* mins = objectBounds.data();
+	float* maxs = objectBounds.data() + (size_t) total * 3;
+	for (size_t m = 0; m < batches.size(); m++) {
+		InstanceBatch& batch = batches[m];
+		if (!batch.culled || batch.count == 0) {
+			continue;
+		}
+		float bounds[6];
+		if (m == 0) {
+			memcpy(bounds, TRIANGLE_BOUNDS, sizeof(bounds));
+		} else {
+			batch.mesh.getBounds(bounds, bounds + 3);
+		}
+		const Transform* instances = reinterpret_cast<const Transform*>(batch.buffer.getData());
+		VecMath::transformBounds(instances->matrix, bounds, bounds + 3, mins + batch.firstObject * 3, maxs + batch.firstObject * 3,
+			batch.count, sizeof(Transform) / sizeof(float));
+		std::fill(objectBatches.begin() + batch.firstObject, objectBatches.begin() + batch.firstObject + batch.count, (uint32_t) m);
+	}
+	bvh.build(mins, maxs, total);
+	bvhStale = false;
+}
+
+/**
+ * Finds the instances inside the view frustum, setting each batch's visible
+ * count and, for batches only partly in view (or drawn at more than one level
+ * of detail), compacting those instances into its \c visible buffer grouped
+ * by level (batches wholly in view at a single level being drawn from their
+ * own). The compacted instances keep their order, so an unchanged view
+ * uploads nothing.
+ *
+ * \param[in] view view-projection matrix the instances are drawn with
+ */
+void Renderer::cullInstances(const float4x4& view)
+{
+	TRACE_SCOPE("Renderer::cullInstances");
+	if (bvhStale) {
+		rebuildBvh();
+	} else if (bvh.needsRefit()) {
+		bvh.refit();
+	}
+	visibleObjects.clear();
+	bvh.cull(Frustum::fromMatrix(view), visibleObjects);
+	std::sort(visibleObjects.begin(), visibleObjects.end());
+	visibleTotal = (uint32_t) visibleObjects.size();
+	visibleTriangles = 0;
+
+	for (auto it = batches.begin(); it != batches.end(); ++it) {
+		it->visibleCount = 0;
+		it->compacted = false;
+		memset(it->lodCounts, 0, sizeof(it->lodCounts));
+	}
+	for (uint32_t object : visibleObjects) {
+		batches[objectBatches[object]].visibleCount++;
+	}
+	// sorted, so each batch's objects are together (copied in runs of consecutive instances at the same level)
+	for (size_t n = 0; n < visibleObjects.size();) {
+		uint32_t m = objectBatches[visibleObjects[n]];
+		InstanceBatch& batch = batches[m];
+		size_t end = n + batch.visibleCount;
+		bool lodded = (m > 0 && batch.mesh.getLodCount() > 1);
+		bool mixed = false;
+		if (lodded) {
+			mixed = selectLods(batch, &visibleObjects[n], view);
+		} else {
+			batch.lodCounts[0] = batch.visibleCount;
+		}
+		for (uint32_t lod = 0; lod < MESH_MAX_LODS; lod++) {
+			visibleTriangles += (uint64_t) batch.lodCounts[lod] * ((m == 0) ? 1 : batch.mesh.getLod(lod).indexCount / 3);
+		}
+		if (batch.visibleCount == batch.count && !mixed) {
+			n = end;
+			continue;
+		}
+		batch.compacted = true;
+		batch.visible.reserve(*this, batch.visibleCount * sizeof(Transform));
+		const Transform* instances = reinterpret_cast<const Transform*>(batch.buffer.getData());
+		uint32_t offsets[MESH_MAX_LODS] = {};
+		for (uint32_t lod = 1; lod < MESH_MAX_LODS; lod++) {
+			offsets[lod] = offsets[lod - 1] + batch.lodCounts[lod - 1];
+		}
+		while (n < end) {
+			uint32_t first = visibleObjects[n] - batch.firstObject;
+			uint32_t lod = (lodded) ? batch.lods[first] : 0;
+			size_t run = 1;
+			while (n + run < end && visibleObjects[n + run] - batch.firstObject == first + run
+					&& (!lodded || batch.lods[first + run] == lod)) {
+				run++;
+			}
+			batch.visible.write(offsets[lod] * sizeof(Transform), instances + first, run * sizeof(Transform));
+			offsets[lod] += (uint32_t) run;
+			n += run;
+		}
+	}
+}
+
+/**
+ * Picks each visible instance's level of detail: the coarsest whose error,
+ * scaled by the instance and projected at the nearest depth of its bounds,
+ * stays under \c #LOD_PIXEL_ERROR on screen. Instances only move to a coarser
+ * level once it's comfortably under (see \c #LOD_HYSTERESIS), so those
+ * hovering around a threshold don't pop back and forth.
+ *
+ * \param[in,out] batch batch whose instances to pick for (setting their \c lods and the \c lodCounts)
+ * \param[in] objects the batch's visible BVH objects (\c visibleCount of them)
+ * \param[in] view view-projection matrix the instances are drawn with
+ * \return \c true if more than one level is drawn
+ */
+bool Renderer::selectLods(InstanceBatch& batch, const uint32_t* objects, const float4x4& view)
+{
+	const Mesh& mesh = batch.mesh;
+	uint32_t lodCount = mesh.getLodCount();
+	batch.lods.resize(batch.count, 0);
+
+	float pixels;
+	float depthScale;
+	getLodScale(view, width, height, pixels, depthScale);
+
+	// the instance matrices include the dequantization, which the errors (in source units) don't want
+	float bounds[6];
+	float dequantize[16];
+	mesh.getBounds(bounds, bounds + 3);
+	mesh.getDequantize(dequantize);
+	float4 centre = float4::set((bounds[0] + bounds[3]) * 0.5f, (bounds[1] + bounds[4]) * 0.5f, (bounds[2] + bounds[5]) * 0.5f, 1.0f);
+	float radius = 0.5f * sqrtf((bounds[3] - bounds[0]) * (bounds[3] - bounds[0])
+		+ (bounds[4] - bounds[1]) * (bounds[4] - bounds[1]) + (bounds[5] - bounds[2]) * (bounds[5] - bounds[2]));
+	float unquantize[3];
+	for (int c = 0; c < 3; c++) {
+		unquantize[c] = 1.0f / (dequantize[c * 5] * dequantize[c * 5]);
+	}
+
+	const Transform* instances = reinterpret_cast<const Transform*>(batch.buffer.getData());
+	for (uint32_t n = 0; n < batch.visibleCount; n++) {
+		uint32_t instance = objects[n] - batch.firstObject;
+		float4x4 model = float4x4::load(instances[instance].matrix);
+		float clip[4];
+		(view * (model * centre)).store(clip);
+		// largest axis scale, of stored positions (for the bounds) and of source positions (for the errors)
+		float stretch = 0.0f;
+		float scale = 0.0f;
+		for (int c = 0; c < 3; c++) {
+			float axis[4];
+			(model.cols[c] * model.cols[c]).store(axis);
+			float length = axis[0] + axis[1] + axis[2];
+			stretch = std::max(stretch, length);
+			scale = std::max(scale, length * unquantize[c]);
+		}
+		float depth = clip[3] - radius * sqrtf(stretch) * depthScale;
+		uint32_t lod = std::min<uint32_t>(batch.lods[instance], lodCount - 1);
+		if (depth <= 0.0f) {
+			lod = 0; // reaching the eye (or behind it), so as close as can be
+		} else {
+			float perUnit = sqrtf(scale) * pixels / depth;
+			while (lod > 0 && mesh.getLod(lod).error * perUnit > LOD_PIXEL_ERROR) {
+				lod--;
+			}
+			while (lod + 1 < lodCount && mesh.getLod(lod + 1).error * perUnit <= LOD_PIXEL_ERROR * LOD_HYSTERESIS) {
+				lod++;
+			}
+		}
+		batch.lods[instance] = (uint8_t) lod;
+		batch.lodCounts[lod]++;
+	}
+	uint32_t levels = 0;
+	for (uint32_t lod = 0; lod < lodCount; lod++) {
+		levels += (batch.lodCounts[lod] > 0) ? 1 : 0;
+	}
+	return levels > 1;
+}
+
+/**
+ * Creates the culling compute pipeline and its bind group layout: the
+ * frustum planes and level of detail scales from the uniform ring, then the
+ * instances, chunks, visible instances and draw arguments.
+ */
+void Renderer::createCullPipeline()
+{
+	WGPUBindGroupLayoutEntry bglEntries[5] = {};
+	for (uint32_t n = 0; n < 5; n++) {
+		bglEntries[n].binding = n;
+		bglEntries[n].visibility = WGPUShaderStage_Compute;
+		bglEntries[n].type = (n == 0) ? WGPUBindingType_UniformBuffer : WGPUBindingType_StorageBuffer;
+	}
+	bglEntries[0].hasDynamicOffset = true;
+
+	WGPUBindGroupLayoutDescriptor bglDesc = {};
+	bglDesc.entryCount = 5;
+	bglDesc.entries = bglEntries;
+	cullGroupLayout = wgpuDeviceCreateBindGroupLayout(device, &bglDesc);
+
+	WGPUPipelineLayoutDescriptor layoutDesc = {};
+	layoutDesc.bindGroupLayoutCount = 1;
+	layoutDesc.bindGroupLayouts = &cullGroupLayout;
+	WGPUPipelineLayout layout = wgpuDeviceCreatePipelineLayout(device, &layoutDesc);
+
+	WGPUComputePipelineDescriptor desc = {};
+	desc.layout = layout;
+	desc.computeStage.module = pipelines.getShaderModule(cull_comp_wgsl);
+	desc.computeStage.entryPoint = "main";
+	cullPipeline = wgpuDeviceCreateComputePipeline(device, &desc);
+
+	wgpuPipelineLayoutRelease(layout);
+}
+
+/**
+ * Splits each batch's instances into chunks for GPU culling, uploading the
+ * chunks and their draw arguments per level of detail (everything bar the
+ * instance counts, which the culling pass writes) and binding them with the
+ * instance buffers. The visible instances get \c #CULL_CHUNK_SIZE slots per
+ * chunk and level, so each draw's instances start where it's bound.
+ */
+void Renderer::rebuildChunks()
+{
+	TRACE_SCOPE("Renderer::rebuildChunks");
+	std::vector<CullChunk> chunks;
+	std::vector<uint32_t> args;
+	for (size_t m = 0; m < batches.size(); m++) {
+		InstanceBatch& batch = batches[m];
+		uint32_t indexCount = (m == 0) ? 3 : batch.mesh.getIndexCount();
+		batch.chunkCount = (indexCount > 0) ? (batch.count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE : 0;
+		if (batch.chunkCount == 0) {
+			continue;
+		}
+		float bounds[6];
+		MeshLod levels[MESH_MAX_LODS] = {};
+		float unquantize[3] = {1.0f, 1.0f, 1.0f};
+		if (m == 0) {
+			memcpy(bounds, TRIANGLE_BOUNDS, sizeof(bounds));
+			batch.cullLods = 1;
+			levels[0] = {0, 3, 0.0f};
+		} else {
+			batch.mesh.getBounds(bounds, bounds + 3);
+			batch.cullLods = batch.mesh.getLodCount();
+			for (uint32_t lod = 0; lod < batch.cullLods; lod++) {
+				levels[lod] = batch.mesh.getLod(lod);
+			}
+			float dequantize[16];
+			batch.mesh.getDequantize(dequantize);
+			for (int c = 0; c < 3; c++) {
+				unquantize[c] = 1.0f / (dequantize[c * 5] * dequantize[c * 5]);
+			}
+		}
+
+		// padded with empty chunks to whole workgroups (each with arguments for every level)
+		uint32_t padded = (batch.chunkCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE * CULL_GROUP_SIZE;
+		chunks.assign(padded, CullChunk());
+		args.assign((size_t) padded * batch.cullLods * 5, 0);
+		for (uint32_t n = 0; n < padded; n++) {
+			CullChunk& chunk = chunks[n];
+			for (int c = 0; c < 3; c++) {
+				chunk.centre[c] = (bounds[c] + bounds[3 + c]) * 0.5f;
+				chunk.extent[c] = (bounds[3 + c] - bounds[c]) * 0.5f;
+				chunk.unquantize[c] = unquantize[c];
+			}
+			for (uint32_t lod = 0; lod < batch.cullLods; lod++) {
+				chunk.errors[lod] = levels[lod].error;
+			}
+			chunk.lodCount = batch.cullLods;
+			if (n < batch.chunkCount) {
+				chunk.first = n * CULL_CHUNK_SIZE;
+				chunk.count = std::min<uint32_t>(CULL_CHUNK_SIZE, batch.count - chunk.first);
+				for (uint32_t lod = 0; lod < batch.cullLods; lod++) {
+					uint32_t* draw = &args[((size_t) n * batch.cullLods + lod) * 5];
+					draw[0] = levels[lod].indexCount;
+					draw[1] = CULL_NOT_RUN;
+					draw[2] = levels[lod].firstIndex;
+				}
+			}
+		}
+		size_t chunkBytes = chunks.size() * sizeof(CullChunk);
+		size_t argBytes   = args.size() * sizeof(uint32_t);
+		if (batch.chunks.getBuffer()) {
+			batch.chunks.reserve(*this, chunkBytes);
+			batch.chunks.write(0, chunks.data(), chunkBytes);
+			batch.drawArgs.reserve(*this, argBytes);
+			batch.drawArgs.write(0, args.data(), argBytes);
+		} else {
+			batch.chunks.create(*this, chunks.data(), chunkBytes, WGPUBufferUsage_Storage);
+			batch.drawArgs.create(*this, args.data(), argBytes,
+				(WGPUBufferUsage) (WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect | WGPUBufferUsage_CopySrc));
+		}
+		batch.visible.reserve(*this, (size_t) batch.chunkCount * batch.cullLods * CULL_CHUNK_SIZE * sizeof(Transform));
+
+		// any of the buffers may have been recreated
+		if (batch.cullGroup) {
+			wgpuBindGroupRelease(batch.cullGroup);
+		}
+		WGPUBindGroupEntry bgEntries[5] = {};
+		bgEntries[0].buffer = uniforms.getBuffer();
+		bgEntries[0].size   = sizeof(CullView);
+		bgEntries[1].buffer = batch.buffer.getBuffer();
+		bgEntries[1].size   = batch.buffer.getSize();
+		bgEntries[2].buffer = batch.chunks.getBuffer();
+		bgEntries[2].size   = batch.chunks.getSize();
+		bgEntries[3].buffer = batch.visible.getBuffer();
+		bgEntries[3].size   = batch.visible.getSize();
+		bgEntries[4].buffer = batch.drawArgs.getBuffer();
+		bgEntries[4].size   = batch.drawArgs.getSize();
+		for (uint32_t n = 0; n < 5; n++) {
+			bgEntries[n].binding = n;
+		}
+		WGPUBindGroupDescriptor bgDesc = {};
+		bgDesc.layout = cullGroupLayout;
+		bgDesc.entryCount = 5;
+		bgDesc.entries = bgEntries;
+		batch.cullGroup = wgpuDeviceCreateBindGroup(device, &bgDesc);
+	}
+	chunksStale = false;
+}
+
+/**
+ * Records the culling compute pass, which writes each chunk's visible
+ * instances, grouped by level of detail, and their counts for the indirect
+ * draws that follow. The CPU cost is per batch, not per instance, so static
+ * scenes of any size cost the same.
+ *
+ * \param[in] encoder encoder for the frame (ahead of the render pass)
+ * \param[in] frustumOffset dynamic offset of the frustum planes and level of detail scales in the uniform ring
+ */
+void Renderer::encodeCulling(WGPUCommandEncoder encoder, uint32_t frustumOffset)
+{
+	if (chunksStale) {
+		rebuildChunks();
+	}
+	WGPUComputePassDescriptor passDesc = {};
+	WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(encoder, &passDesc);
+	wgpuComputePassEncoderSetPipeline(pass, cullPipeline);
+	for (auto it = batches.begin(); it != batches.end(); ++it) {
+		if (it->chunkCount > 0) {
+			wgpuComputePassEncoderSetBindGroup(pass, 0, it->cullGroup, 1, &frustumOffset);
+			wgpuComputePassEncoderDispatch(pass, (it->chunkCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+		}
+	}
+	wgpuComputePassEncoderEndPass(pass);
+	wgpuComputePassEncoderRelease(pass);
+}
+
+/**
+ * Switches between culling on the CPU (against a BVH, drawing each batch
+ * with a single call) and on the GPU (in a compute pass, drawing each chunk
+ * of a batch with an indirect call per level of detail). The culling can be
+ * compared with the CPU's by \c #checkGpuCulling(), which the bench runs on
+ * an adapter executing shaders (see \c lib/README.md).
+ *
+ * \param[in] enabled \c true to cull on the GPU
+ */
+void Renderer::setGpuCulling(bool enabled)
+{
+	if (enabled && !cullPipeline) {
+		createCullPipeline();
+	}
+	if (gpuCulling && !enabled) {
+		// the culling pass wrote the visible instances behind the mirrors' backs
+		for (InstanceBatch& batch : batches) {
+			batch.visible.invalidate();
+		}
+	}
+	gpuCulling = enabled;
+	dirty = true;
+}
+
+/**
+ * Culls the instances in a compute pass against the current view, then reads
+ * back the result and compares it with the same test on the CPU, blocking
+ * until the GPU is done (for testing, so not available on the web). Nothing
+ * is drawn, so this needs no swap chain: the renderer can be given a device
+ * only for this, on an adapter that runs shaders.
+ *
+ * \return number of chunks whose visible instance counts differ (or whose first instances were overwritten), or \c -1 if the culling pass didn't run (GPU culling being off, or the backend not running shaders, as with Dawn's Null backend)
+ */
+int Renderer::checkGpuCulling()
+{
+#ifdef __EMSCRIPTEN__
+	return -1;
+#else
+	if (!gpuCulling) {
+		return -1;
+	}
+	this->updateScene();
+
+	// the uniforms are pushed before anything is encoded, so a full ring can still grow
+	float4x4 view = float4x4::load(viewProj) * float4x4::rotationZ(rotDeg * 3.14159265f / 180.0f);
+	view.store(cullView);
+	CullView cullUniforms;
+	getCullView(view, width, height, cullUniforms);
+	uint32_t frustumOffset;
+	while ((frustumOffset = uniforms.push(&cullUniforms, sizeof(cullUniforms))) == UNIFORM_RING_FULL) {
+		this->growUniforms();
+	}
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, nullptr);
+	this->encodeCulling(encoder, frustumOffset);
+
+	size_t total = 0;
+	for (auto it = batches.begin(); it != batches.end(); ++it) {
+		total += it->chunkCount * it->cullLods * CULL_ARGS_SIZE;
+	}
+
+	// every batch's arguments copied into one buffer to map
+	WGPUBufferDescriptor desc = {};
+	desc.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst;
+	desc.size = std::max<size_t>(total, 4);
+	WGPUBuffer readback = wgpuDeviceCreateBuffer(device, &desc);
+	size_t offset = 0;
+	for (auto it = batches.begin(); it != batches.end(); ++it) {
+		if (it->chunkCount > 0) {
+			wgpuCommandEncoderCopyBufferToBuffer(encoder, it->drawArgs.getBuffer(), 0, readback, offset, it->chunkCount * it->cullLods * CULL_ARGS_SIZE);
+			offset += it->chunkCount * it->cullLods * CULL_ARGS_SIZE;
+		}
+	}
+	WGPUCommandBuffer commands = wgpuCommandEncoderFinish(encoder, nullptr);
+	wgpuCommandEncoderRelease(encoder);
+	this->flushBuffers();
+	wgpuQueueSubmit(queue, 1, &commands);
+	wgpuCommandBufferRelease(commands);
+	if (total == 0) {
+		wgpuBufferRelease(readback);
+		return -1;
+	}
+
+	struct MapResult {
+		bool done;
+		WGPUBufferMapAsyncStatus status;
+	} result = {};
+	wgpuBufferMapAsync(readback, WGPUMapMode_Read, 0, total, [](WGPUBufferMapAsyncStatus status, void* userdata) {
+		MapResult* result = static_cast<MapResult*>(userdata);
+		result->status = status;
+		result->done = true;
+	}, &result);
+	WireTransport* wire = WireTransport::getActive();
+	while (!result.done) {
+		wgpuDeviceTick(device);
+		if (wire) {
+			wire->flush(); // the wire client only gets the map's reply when flushing
+		}
+	}
+
+	int mismatches = -1;
+	if (result.status == WGPUBufferMapAsyncStatus_Success) {
+		const uint32_t* args = static_cast<const uint32_t*>(wgpuBufferGetConstMappedRange(readback, 0, total));
+		Frustum frustum = Frustum::fromMatrix(float4x4::load(cullView));
+		mismatches = 0;
+		for (size_t m = 0; m < batches.size() && mismatches >= 0; m++) {
+			InstanceBatch& batch = batches[m];
+			if (batch.chunkCount == 0) {
+				continue;
+			}
+			float bounds[6];
+			if (m == 0) {
+				memcpy(bounds, TRIANGLE_BOUNDS, sizeof(bounds));
+			} else {
+				batch.mesh.getBounds(bounds, bounds + 3);
+			}
+			const Transform* instances = reinterpret_cast<const Transform*>(batch.buffer.getData());
+			for (uint32_t n = 0; n < batch.chunkCount && mismatches >= 0; n++) {
+				// the levels' instances adding up to those in view (with the first instances left at zero)
+				uint32_t first = n * CULL_CHUNK_SIZE;
+				uint32_t drawn = 0;
+				bool misplaced = false;
+				for (uint32_t lod = 0; lod < batch.cullLods; lod++, args += 5) {
+					uint32_t indexCount = (m == 0) ? 3 : batch.mesh.getLod(lod).indexCount;
+					if (args[0] != indexCount || args[1] == CULL_NOT_RUN) {
+						mismatches = -1; // never written (or never even copied)
+						break;
+					}
+					misplaced |= args[4] != 0;
+					drawn += args[1];
+				}
+				if (mismatches < 0) {
+					break;
+				}
+				uint32_t last  = std::min<uint32_t>(first + CULL_CHUNK_SIZE, batch.count);
+				uint32_t visible = 0;
+				for (uint32_t i = first; i < last; i++) {
+					float box[6];
+					VecMath::transformBounds(instances[i].matrix, bounds, bounds + 3, box, box + 3, 1);
+					visible += (frustum.testBox(box, box + 3) != FRUSTUM_OUTSIDE) ? 1 : 0;
+				}
+				if (misplaced || drawn != visible) {
+					mismatches++;
+				}
+			}
+		}
+		wgpuBufferUnmap(readback);
+	}
+	wgpuBufferRelease(readback);
+	return mismatches;
+#endif
+}
+
+/**
+ * Allocates memory for geometry to be written in place (from JavaScript, a
+ * view onto the WASM heap) then uploaded by \c #commitGeometry(), with no
+ * copies or per-vertex marshalling in between.
+ *
+ * \param[in] size number of bytes
+ * \return ID of the memory (or zero if it couldn't be allocated)
+ */
+uint32_t Renderer::allocGeometry(size_t size)
+{
+	uint8_t* data = static_cast<uint8_t*>(malloc(size ? size : 1));
+	if (!data) {
+		return 0;
+	}
+	for (size_t n = 0; n < geometry.size(); n++) {
+		if (!geometry[n].data) {
+			geometry[n] = {data, size};
+			return (uint32_t) n + 1;
+		}
+	}
+	geometry.push_back({data, size});
+	return (uint32_t) geometry.size();
+}
+
+/**
+ * Memory allocated by \c #allocGeometry().
+ *
+ * \param[in] id ID returned by \c #allocGeometry()
+ * \return start of the memory (or \c null if \a id isn't allocated)
+ */
+uint8_t* Renderer::getGeometry(uint32_t id)
+{
+	return (id - 1 < geometry.size()) ? geometry[id - 1].data : nullptr;
+}
+
+/**
+ * Size of the memory allocated by \c #allocGeometry().
+ *
+ * \param[in] id ID returned by \c #allocGeometry()
+ * \return number of bytes (or zero if \a id isn't allocated)
+ */
+size_t Renderer::getGeometrySize(uint32_t id)
+{
+	return (id - 1 < geometry.size()) ? geometry[id - 1].size : 0;
+}
+
+/**
+ * Uploads geometry written to memory from \c #allocGeometry() as a new mesh,
+ * drawn with the triangle's pipeline and starting with a single untransformed
+ * instance, then frees the memory. The GPU buffers are written straight from
+ * the memory.
+ *
+ * \param[in] id ID returned by \c #allocGeometry()
+ * \param[in] vertexCount number of vertices, each \c #GEOMETRY_VERTEX_SIZE bytes, at the start of the memory
+ * \param[in] indexCount number of 32-bit indices following the vertices (forming triangles)
+ * \return ID of the mesh (for \c #addInstances(), etc.) or \c #RENDERER_INVALID_MESH if the memory is too small or \a id isn't allocated
+ */
+uint32_t Renderer::commitGeometry(uint32_t id, uint32_t vertexCount, uint32_t indexCount)
+{
+	uint8_t* data = getGeometry(id);
+	uint64_t vertexBytes = (uint64_t) vertexCount * GEOMETRY_VERTEX_SIZE;
+	uint64_t indexBytes  = (uint64_t) indexCount * sizeof(uint32_t);
+	if (!data || vertexCount == 0 || indexCount == 0 || indexCount % 3 != 0 || vertexBytes + indexBytes > getGeometrySize(id)) {
+		printf("Invalid geometry %u (%u vertices, %u indices)\n", id, vertexCount, indexCount);
+		return RENDERER_INVALID_MESH;
+	}
+	const void* vertexData = data;
+	Mesh mesh;
+	mesh.upload(*this, VertexLayout().add(MESH_POSITION, MESH_FLOAT, 2).add(MESH_COLOR, MESH_FLOAT, 3),
+		&vertexData, vertexCount, data + vertexBytes, indexCount, WGPUIndexFormat_Uint32);
+	freeGeometry(id);
+	const VertexLayout layout = mesh.getLayout();
+	return addBatch(std::move(mesh), layout);
+}
+
+/**
+ * Frees memory from \c #allocGeometry() without uploading it.
+ *
+ * \param[in] id ID returned by \c #allocGeometry()
+ */
+void Renderer::freeGeometry(uint32_t id)
+{
+	if (id - 1 < geometry.size()) {
+		free(geometry[id - 1].data);
+		geometry[id - 1] = {nullptr, 0};
+	}
+}
+
+/**
+ * Whether every index refers to one of the vertices and every level of detail
+ * to a range of the indices (the optimizer and \c Mesh using them to address
+ * memory on the CPU).
+ *
+ * \param[in] indices triangle list (or null to draw the vertices in order)
+ * \param[in] indexCount number of indices
+ * \param[in] vertexCount number of vertices
+ * \param[in] lods ranges of the indices per level of detail (or null)
+ * \param[in] lodCount number of levels in \a lods
+ * \return \c true if nothing is out of range
+ */
+static bool inRange(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, const MeshLod* lods, size_t lodCount)
+{
+	if (indices) {
+		for (size_t n = 0; n < indexCount; n++) {
+			if (indices[n] >= vertexCount) {
+				return false;
+			}
+		}
+	}
+	for (size_t n = 0; n < lodCount; n++) {
+		if (!lods || (uint64_t) lods[n].firstIndex + lods[n].indexCount > indexCount) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Checks a source mesh holds every vertex of each attribute it has, with the
+ * components \a layout expects of those it stores (optimizing walks each
+ * attribute by its own components, encoding by the layout's).
+ */
+static bool hasVertices(const MeshSource& source, const VertexLayout& layout)
+{
+	for (uint32_t attrib = 0; attrib < MESH_ATTRIB_COUNT; attrib++) {
+		if (layout.has((MeshAttrib) attrib) && source.components[attrib] != layout.getComponents((MeshAttrib) attrib)) {
+			return false;
+		}
+		if (source.attribs[attrib].size() < (size_t) source.vertexCount * source.components[attrib]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Creates a mesh from float data, stored in \a layout's formats (quantized,
+ * split into streams, etc.), starting with a single untransformed instance.
+ * Simplified levels of detail can be generated (see
+ * \c MeshOptimizer::generateLods()), each instance then being drawn at the
+ * coarsest its distance allows (the GPU culling pass picking the same level,
+ * but without \c #LOD_HYSTERESIS, having no memory of previous frames).
+ *
+ * \param[in] data source vertices (\c vertexCount of each attribute in \a layout, with the layout's components) and indices
+ * \param[in] layout vertex layout, which needs positions and colours (the shaders' inputs)
+ * \param[in] lodCount number of levels of detail to generate (including the full detail) if \a data has none
+ * \return ID of the mesh (for \c #addInstances(), etc.) or \c #RENDERER_INVALID_MESH if \a data lacks an attribute of \a layout or an index is out of range
+ */
+uint32_t Renderer::addMesh(const MeshData& data, const VertexLayout& layout, uint32_t lodCount)
+{
+	bool valid = layout.has(MESH_POSITION) && layout.has(MESH_COLOR);
+	for (uint32_t attrib = 0; attrib < MESH_ATTRIB_COUNT; attrib++) {
+		valid &= !layout.has((MeshAttrib) attrib) || data.attribs[attrib] != NULLPTR;
+	}
+	if (!valid || !inRange(data.indices, data.indexCount, data.vertexCount, data.lods, data.lodCount)) {
+		printf("Invalid mesh (%u vertices, %u indices)\n", data.vertexCount, data.indexCount);
+		return RENDERER_INVALID_MESH;
+	}
+	// the levels are appended to a copy of the indices
+	MeshSource lods;
+	MeshData lodded = data;
+	if (lodCount > 1 && data.lodCount == 0 && data.indices) {
+		lods.attribs[MESH_POSITION].assign(data.attribs[MESH_POSITION],
+			data.attribs[MESH_POSITION] + (size_t) data.vertexCount * layout.getComponents(MESH_POSITION));
+		lods.components[MESH_POSITION] = layout.getComponents(MESH_POSITION);
+		lods.indices.assign(data.indices, data.indices + data.indexCount);
+		lods.vertexCount = data.vertexCount;
+		MeshOptimizer::generateLods(lods, lodCount);
+		if (!lods.lods.empty()) {
+			lodded.indices    = lods.indices.data();
+			lodded.indexCount = (uint32_t) lods.indices.size();
+			lodded.lods       = lods.lods.data();
+			lodded.lodCount   = (uint32_t) lods.lods.size();
+		}
+	}
+	Mesh mesh;
+	if (!mesh.create(*this, lodded, layout)) {
+		printf("Invalid mesh (%u vertices, %u indices)\n", data.vertexCount, data.indexCount);
+		return RENDERER_INVALID_MESH;
+	}
+	return addBatch(std::move(mesh), layout);
+}
+
+/**
+ * Uploads every mesh in a scene straight from its memory (the file mapping or
+ * fetched buffer, which can be released once this returns), each starting
+ * with a single untransformed instance tinted by its material.
+ *
+ * \param[in] scene open scene
+ * \return ID of the first mesh (the rest following consecutively) or \c #RENDERER_INVALID_MESH if the scene is empty or a mesh lacks colours
+ */
+uint32_t Renderer::addScene(const SceneFile& scene)
+{
+	uint32_t count = scene.getMeshCount();
+	for (uint32_t n = 0; n < count; n++) {
+		if (!scene.getLayout(n).has(MESH_COLOR)) {
+			printf("Invalid scene (mesh %u has no colours)\n", n);
+			return RENDERER_INVALID_MESH;
+		}
+	}
+	uint32_t firstId = (count > 0) ? (uint32_t) batches.size() : RENDERER_INVALID_MESH;
+	for (uint32_t n = 0; n < count; n++) {
+		Mesh mesh;
+		scene.upload(*this, n, mesh);
+		const VertexLayout layout = mesh.getLayout();
+		uint32_t meshId = addBatch(std::move(mesh), layout);
+		if (const SceneFile::Material* material = scene.getMaterial(n)) {
+			Transform tinted = IDENTITY_TRANSFORM;
+			memcpy(tinted.color, material->color, sizeof(tinted.color));
+			clearInstances(meshId);
+			addInstances(meshId, std::span<const Transform>(&tinted, 1));
+		}
+	}
+	return firstId;
+}
+
+/**
+ * Creates a mesh as \c #addMesh() but first optimizes it on a worker thread
+ * (see \c MeshOptimizer), for large meshes arriving in arbitrary order. The
+ * ID is usable straight away, with instances added before the mesh is ready
+ * drawn once it is.
+ *
+ * \param[in] source source vertices and indices (of which ownership is taken)
+ * \param[in] layout vertex layout, which needs positions and colours (the shaders' inputs)
+ * \param[in] lodCount number of levels of detail to generate on the worker (including the full detail)
+ * \return ID of the mesh or \c #RENDERER_INVALID_MESH if \a layout lacks positions or colours, \a source lacks vertices for its attributes (or has different components to \a layout) or an index is out of range
+ */
+uint32_t Renderer::addMeshOptimized(MeshSource&& source, const VertexLayout& layout, uint32_t lodCount)
+{
+	if (!layout.has(MESH_POSITION) || !layout.has(MESH_COLOR) || !hasVertices(source, layout) ||
+		!inRange(source.indices.data(), source.indices.size(), source.vertexCount, source.lods.data(), source.lods.size())) {
+		printf("Invalid mesh (%u vertices, %u indices)\n", source.vertexCount, (uint32_t) source.indices.size());
+		return RENDERER_INVALID_MESH;
+	}
+	uint32_t meshId = addBatch(Mesh(), layout);
+	pendingMeshes.push_back({meshId, layout, std::make_unique<MeshOptimizer::Job>(std::move(source), lodCount)});
+	return meshId;
+}
+
+/**
+ * Uploads any meshes whose optimization has finished (on the render thread,
+ * since the workers don't touch the device). Instances added while the mesh
+ * was pending get its dequantization applied now it's known.
+ */
+void Renderer::finishMeshes()
+{
+	for (auto it = pendingMeshes.begin(); it != pendingMeshes.end();) {
+		if (!it->job->isFinished()) {
+			++it;
+			continue;
+		}
+		InstanceBatch& batch = batches[it->meshId];
+		if (batch.mesh.create(*this, it->job->getMesh().getData(), it->layout)) {
+			Transform* dst = (batch.mesh.isQuantized() && batch.count > 0)
+				? static_cast<Transform*>(batch.buffer.modify(0, batch.count * sizeof(Transform))) : NULLPTR;
+			if (dst) {
+				float dequantize[16];
+				batch.mesh.getDequantize(dequantize);
+				VecMath::multiplyMatrices(dst->matrix, float4x4::load(dequantize), dst->matrix, batch.count, sizeof(Transform) / sizeof(float));
+			}
+		} else {
+			printf("Invalid mesh %u (%u vertices)\n", it->meshId, it->job->getMesh().vertexCount);
+		}
+		it = pendingMeshes.erase(it);
+		bvhStale = true;
+		chunksStale = true;
+		dirty = true;
+	}
+}
+
+/**
+ * Adds a mesh's instance batch, with the pipeline for its layout and a single
+ * untransformed instance.
+ *
+ * \param[in] mesh mesh to take ownership of (empty if still to be created)
+ * \param[in] layout the mesh's layout
+ * \return ID of the mesh
+ */
+uint32_t Renderer::addBatch(Mesh&& mesh, const VertexLayout& layout)
+{
+	uint32_t meshId = (uint32_t) batches.size();
+	batches.emplace_back();
+	InstanceBatch& batch = batches.back();
+	batch.pipeline = getPipeline(layout);
+	batch.mesh = std::move(mesh);
+	batch.buffer.create(*this, nullptr, INSTANCE_BATCH_SIZE * sizeof(Transform), INSTANCE_USAGE);
+	batch.visible.create(*this, nullptr, INSTANCE_BATCH_SIZE * sizeof(Transform), INSTANCE_USAGE);
+	addInstances(meshId, std::span<const Transform>(&IDENTITY_TRANSFORM, 1));
+	return meshId;
 }
@@ -0,0 +1,180 @@
+#include "Scene.h"
+#include "VecMath.h"
+
+#include <string.h>
+
+/**
+ * Reorders elements of \a stride values each, so that old element \c n moves
+ * to \c remap[n].
+ */
+template<typename T>
+static void permute(std::vector<T>& values, size_t stride, const std::vector<uint32_t>& remap) {
+	std::vector<T> sorted(values.size());
+	for (size_t n = 0; n < remap.size(); n++) {
+		memcpy(&sorted[remap[n] * stride], &values[n * stride], stride * sizeof(T));
+	}
+	values.swap(sorted);
+}
+
+void Scene::reserve(size_t count)
+{
+	parents.reserve(count);
+	translations.reserve(count * 3);
+	rotations.reserve(count * 4);
+	scales.reserve(count * 3);
+	worlds.reserve(count * 16);
+	dirty.reserve(count);
+	meshes.reserve(count);
+	instances.reserve(count);
+}
+
+void Scene::clear()
+{
+	parents.clear();
+	translations.clear();
+	rotations.clear();
+	scales.clear();
+	worlds.clear();
+	dirty.clear();
+	meshes.clear();
+	instances.clear();
+	changed.clear();
+	firstDirty = 0;
+}
+
+uint32_t Scene::add(uint32_t parent, uint32_t mesh, uint32_t instance)
+{
+	if (parent != SCENE_NO_PARENT && parent >= parents.size()) {
+		return SCENE_NO_PARENT;
+	}
+	uint32_t node = (uint32_t) parents.size();
+	parents.push_back(parent);
+	translations.insert(translations.end(), {0.0f, 0.0f, 0.0f});
+	rotations.insert(rotations.end(), {0.0f, 0.0f, 0.0f, 1.0f});
+	scales.insert(scales.end(), {1.0f, 1.0f, 1.0f});
+	worlds.resize(worlds.size() + 16);
+	dirty.push_back(0);
+	meshes.push_back(mesh);
+	instances.push_back(instance);
+	markDirty(node);
+	return node;
+}
+
+void Scene::setTranslation(uint32_t node, float x, float y, float z)
+{
+	float* t = &translations[node * 3];
+	t[0] = x;
+	t[1] = y;
+	t[2] = z;
+	markDirty(node);
+}
+
+void Scene::setRotation(uint32_t node, float x, float y, float z, float w)
+{
+	float* q = &rotations[node * 4];
+	q[0] = x;
+	q[1] = y;
+	q[2] = z;
+	q[3] = w;
+	markDirty(node);
+}
+
+void Scene::setScale(uint32_t node, float x, float y, float z)
+{
+	float* s = &scales[node * 3];
+	s[0] = x;
+	s[1] = y;
+	s[2] = z;
+	markDirty(node);
+}
+
+uint32_t Scene::update()
+{
+	changed.clear();
+	uint32_t count = (uint32_t) parents.size();
+	if (firstDirty >= count) {
+		return 0;
+	}
+	// parents precede children, so a parent's flag is final by the time its children are reached
+	for (uint32_t n = firstDirty; n < count; n++) {
+		uint32_t parent = parents[n];
+		if (!dirty[n] && (parent == SCENE_NO_PARENT || !dirty[parent])) {
+			continue;
+		}
+		dirty[n] = 1;
+		float4x4 local = float4x4::compose(&translations[n * 3], &rotations[n * 4], &scales[n * 3]);
+		if (parent == SCENE_NO_PARENT) {
+			local.store(&worlds[n * 16]);
+		} else {
+			(float4x4::load(&worlds[parent * 16]) * local).store(&worlds[n * 16]);
+		}
+		changed.push_back(n);
+	}
+	memset(&dirty[firstDirty], 0, count - firstDirty);
+	firstDirty = count;
+	return (uint32_t) changed.size();
+}
+
+void Scene::sortByDepth(std::vector<uint32_t>* remap)
+{
+	uint32_t count = (uint32_t) parents.size();
+
+	// children of each node (compressed rows, in index order)
+	std::vector<uint32_t> offsets(count + 1, 0);
+	for (uint32_t n = 0; n < count; n++) {
+		if (parents[n] != SCENE_NO_PARENT) {
+			offsets[parents[n] + 1]++;
+		}
+	}
+	for (uint32_t n = 0; n < count; n++) {
+		offsets[n + 1] += offsets[n];
+	}
+	std::vector<uint32_t> children(offsets[count]);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (uint32_t n = 0; n < count; n++) {
+		if (parents[n] != SCENE_NO_PARENT) {
+			children[fill[parents[n]]++] = n;
+		}
+	}
+
+	// breadth first: the roots, then each placed node's children in turn
+	std::vector<uint32_t> order;
+	order.reserve(count);
+	for (uint32_t n = 0; n < count; n++) {
+		if (parents[n] == SCENE_NO_PARENT) {
+			order.push_back(n);
+		}
+	}
+	for (size_t n = 0; n < order.size(); n++) {
+		order.insert(order.end(), children.begin() + offsets[order[n]], children.begin() + offsets[order[n] + 1]);
+	}
+	std::vector<uint32_t> newIndex(count);
+	for (uint32_t n = 0; n < count; n++) {
+		newIndex[order[n]] = n;
+	}
+
+	for (uint32_t n = 0; n < count; n++) {
+		if (parents[n] != SCENE_NO_PARENT) {
+			parents[n] = newIndex[parents[n]];
+		}
+	}
+	permute(parents, 1, newIndex);
+	permute(translations, 3, newIndex);
+	permute(rotations, 4, newIndex);
+	permute(scales, 3, newIndex);
+	permute(worlds, 16, newIndex);
+	permute(dirty, 1, newIndex);
+	permute(meshes, 1, newIndex);
+	permute(instances, 1, newIndex);
+	changed.clear();
+	firstDirty = count;
+	for (uint32_t n = 0; n < count; n++) {
+		if (dirty[n]) {
+			firstDirty = n;
+			break;
+		}
+	}
+	if (remap) {
+		remap->swap(newIndex);
+	}
+}
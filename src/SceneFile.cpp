@@ -0,0 +1,279 @@
+#include "SceneFile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * File marker (\c DWSC).
+ */
+#define SCENE_FILE_MAGIC 0x43535744
+
+/**
+ * File layout version (bumped whenever \c Header, \c Entry or \c Material
+ * change).
+ */
+#define SCENE_FILE_VERSION 2
+
+/**
+ * Rounds up to the next \c #SCENE_FILE_ALIGN boundary.
+ */
+static uint64_t alignUp(uint64_t offset) {
+	return (offset + (SCENE_FILE_ALIGN - 1)) & ~(uint64_t) (SCENE_FILE_ALIGN - 1);
+}
+
+/**
+ * Whether \a count items of \a size bytes starting at an aligned \a offset fit
+ * within \a limit bytes (without overflowing).
+ */
+static bool inRange(uint64_t offset, uint64_t count, uint64_t size, uint64_t limit) {
+	return offset % SCENE_FILE_ALIGN == 0 && offset <= limit && (size == 0 || count <= (limit - offset) / size);
+}
+
+/**
+ * Bytes of index data (16-bit indices being padded to an even count).
+ */
+static uint64_t indexBytes(uint8_t indexFormat, uint32_t indexCount) {
+	return (indexFormat) ? (uint64_t) indexCount * 4 : (((uint64_t) indexCount + 1) & ~1ull) * 2;
+}
+
+/**
+ * Layout from a table entry's encodings and components.
+ */
+static VertexLayout entryLayout(const SceneFile::Entry& entry) {
+	VertexLayout layout(entry.interleaved != 0);
+	for (uint32_t attrib = 0; attrib < MESH_ATTRIB_COUNT; attrib++) {
+		if (entry.components[attrib]) {
+			layout.add((MeshAttrib) attrib, (MeshEncoding) entry.encodings[attrib], entry.components[attrib]);
+		}
+	}
+	return layout;
+}
+
+bool SceneFile::open(const char* path)
+{
+	close();
+	if (!file.open(path)) {
+		return false;
+	}
+	if (!open(file.data(), file.size())) {
+		printf("Invalid scene file: %s\n", path);
+		file.close();
+		return false;
+	}
+	return true;
+}
+
+bool SceneFile::open(const void* data, size_t size)
+{
+	bytes  = static_cast<const uint8_t*>(data);
+	length = size;
+	if (!validate()) {
+		bytes  = NULLPTR;
+		length = 0;
+		return false;
+	}
+	return true;
+}
+
+void SceneFile::close()
+{
+	file.close();
+	bytes  = NULLPTR;
+	length = 0;
+}
+
+bool SceneFile::validate() const
+{
+	if (length < sizeof(Header) || reinterpret_cast<uintptr_t>(bytes) % 4 != 0) {
+		return false;
+	}
+	const Header& head = header();
+	if (head.magic != SCENE_FILE_MAGIC || head.version != SCENE_FILE_VERSION || head.size > length) {
+		return false;
+	}
+	if (!inRange(head.meshTable, head.meshCount, sizeof(Entry), head.size) ||
+		!inRange(head.materialTable, head.materialCount, sizeof(Material), head.size)) {
+		return false;
+	}
+	// every blob within the file (index values aren't checked, WebGPU's robust access covers those)
+	for (uint32_t n = 0; n < head.meshCount; n++) {
+		const Entry& entry = getEntry(n);
+		if (entry.vertexCount == 0 || entry.indexCount == 0 || entry.indexCount % 3 != 0 || entry.indexFormat > 1 ||
+			(entry.material != UINT32_MAX && entry.material >= head.materialCount) || entry.components[MESH_POSITION] == 0) {
+			return false;
+		}
+		for (uint32_t attrib = 0; attrib < MESH_ATTRIB_COUNT; attrib++) {
+			if (entry.components[attrib] > 4 || entry.encodings[attrib] > MESH_SNORM8) {
+				return false;
+			}
+		}
+		VertexLayout layout = entryLayout(entry);
+		for (uint32_t s = 0; s < layout.getStreamCount(); s++) {
+			if (!inRange(entry.streams[s], entry.vertexCount, layout.getStride(s), head.size)) {
+				return false;
+			}
+		}
+		if (!inRange(entry.indices, 1, indexBytes(entry.indexFormat, entry.indexCount), head.size)) {
+			return false;
+		}
+		// and every level within the indices
+		if (entry.lodCount > MESH_MAX_LODS || (entry.lodCount > 0 && !inRange(entry.lods, entry.lodCount, sizeof(MeshLod), head.size))) {
+			return false;
+		}
+		for (uint32_t level = 0; level < entry.lodCount; level++) {
+			const MeshLod& lod = reinterpret_cast<const MeshLod*>(bytes + entry.lods)[level];
+			if (lod.indexCount == 0 || lod.indexCount % 3 != 0 || (uint64_t) lod.firstIndex + lod.indexCount > entry.indexCount) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+const SceneFile::Entry& SceneFile::getEntry(uint32_t mesh) const
+{
+	return reinterpret_cast<const Entry*>(bytes + header().meshTable)[mesh];
+}
+
+const SceneFile::Material* SceneFile::getMaterial(uint32_t mesh) const
+{
+	uint32_t material = getEntry(mesh).material;
+	return (material < header().materialCount) ? reinterpret_cast<const Material*>(bytes + header().materialTable) + material : NULLPTR;
+}
+
+VertexLayout SceneFile::getLayout(uint32_t mesh) const
+{
+	return entryLayout(getEntry(mesh));
+}
+
+void SceneFile::upload(Renderer& renderer, uint32_t mesh, Mesh& out) const
+{
+	const Entry& entry = getEntry(mesh);
+	VertexLayout layout = entryLayout(entry);
+	const void* streams[MESH_MAX_STREAMS] = {};
+	for (uint32_t s = 0; s < layout.getStreamCount(); s++) {
+		streams[s] = bytes + entry.streams[s];
+	}
+	const MeshLod* lods = (entry.lodCount > 0) ? reinterpret_cast<const MeshLod*>(bytes + entry.lods) : NULLPTR;
+	out.upload(renderer, layout, streams, entry.vertexCount, bytes + entry.indices, entry.indexCount,
+		(entry.indexFormat) ? WGPUIndexFormat_Uint32 : WGPUIndexFormat_Uint16, entry.dequantize, lods, entry.lodCount);
+}
+
+bool SceneFile::write(const char* path, const MeshSource* meshes, const VertexLayout* layouts,
+		const uint32_t* materialIds, uint32_t meshCount, const Material* materials, uint32_t materialCount)
+{
+	// encode everything first, to know where it all goes
+	struct Encoded {
+		std::vector<uint8_t> streams[MESH_MAX_STREAMS];
+		std::vector<uint8_t> indices;
+		std::vector<MeshLod> lods;
+	};
+	std::vector<Encoded> encoded(meshCount);
+	std::vector<Entry> entries(meshCount);
+	for (uint32_t n = 0; n < meshCount; n++) {
+		const MeshSource& mesh = meshes[n];
+		Entry& entry = entries[n];
+		memset(&entry, 0, sizeof(entry));
+		entry.interleaved = layouts[n].isInterleaved();
+		for (uint32_t attrib = 0; attrib < MESH_ATTRIB_COUNT; attrib++) {
+			if (layouts[n].has((MeshAttrib) attrib)) {
+				entry.encodings[attrib]  = (uint8_t) layouts[n].getEncoding((MeshAttrib) attrib);
+				entry.components[attrib] = (uint8_t) layouts[n].getComponents((MeshAttrib) attrib);
+				if (mesh.attribs[attrib].size() < (size_t) mesh.vertexCount * entry.components[attrib]) {
+					return false;
+				}
+			}
+		}
+		if (!Mesh::encodeVertices(mesh.getData(), entryLayout(entry), encoded[n].streams, entry.dequantize)) {
+			return false;
+		}
+
+		// without indices the vertices are drawn in order (the levels of detail being ranges of every index)
+		std::vector<uint32_t> sequential;
+		const uint32_t* indices = mesh.indices.data();
+		uint32_t indexCount = (uint32_t) mesh.indices.size();
+		if (mesh.lods.size() > MESH_MAX_LODS) {
+			return false;
+		}
+		for (const MeshLod& lod : mesh.lods) {
+			if (lod.indexCount == 0 || lod.indexCount % 3 != 0 || (uint64_t) lod.firstIndex + lod.indexCount > indexCount) {
+				return false;
+			}
+		}
+		if (indexCount == 0) {
+			sequential.resize(mesh.vertexCount);
+			for (uint32_t v = 0; v < mesh.vertexCount; v++) {
+				sequential[v] = v;
+			}
+			indices = sequential.data();
+			indexCount = mesh.vertexCount;
+		}
+		if (indexCount % 3 != 0) {
+			return false;
+		}
+		entry.vertexCount = mesh.vertexCount;
+		entry.indexCount  = indexCount;
+		entry.indexFormat = (mesh.vertexCount > MESH_MAX_INDEX16_VERTICES);
+		entry.material    = (materialIds) ? materialIds[n] : UINT32_MAX;
+		entry.lodCount    = (uint8_t) mesh.lods.size();
+		encoded[n].lods   = mesh.lods;
+		encoded[n].indices.assign(indexBytes(entry.indexFormat, indexCount), 0);
+		if (entry.indexFormat) {
+			memcpy(encoded[n].indices.data(), indices, (size_t) indexCount * 4);
+		} else {
+			uint16_t* narrow = reinterpret_cast<uint16_t*>(encoded[n].indices.data());
+			for (uint32_t i = 0; i < indexCount; i++) {
+				narrow[i] = (uint16_t) indices[i];
+			}
+		}
+	}
+
+	// header, tables then each mesh's blobs, all aligned
+	Header head = {};
+	head.magic         = SCENE_FILE_MAGIC;
+	head.version       = SCENE_FILE_VERSION;
+	head.meshCount     = meshCount;
+	head.materialCount = materialCount;
+	head.meshTable     = alignUp(sizeof(Header));
+	head.materialTable = alignUp(head.meshTable + (uint64_t) meshCount * sizeof(Entry));
+	uint64_t offset    = alignUp(head.materialTable + (uint64_t) materialCount * sizeof(Material));
+	for (uint32_t n = 0; n < meshCount; n++) {
+		for (uint32_t s = 0; s < MESH_MAX_STREAMS && !encoded[n].streams[s].empty(); s++) {
+			entries[n].streams[s] = offset;
+			offset = alignUp(offset + encoded[n].streams[s].size());
+		}
+		entries[n].indices = offset;
+		offset = alignUp(offset + encoded[n].indices.size());
+		if (!encoded[n].lods.empty()) {
+			entries[n].lods = offset;
+			offset = alignUp(offset + encoded[n].lods.size() * sizeof(MeshLod));
+		}
+	}
+	head.size = offset;
+
+	MappedFile out;
+	if (!out.create(path, (size_t) head.size)) {
+		return false;
+	}
+	uint8_t* dst = static_cast<uint8_t*>(out.data());
+	memset(dst, 0, (size_t) head.size);
+	memcpy(dst, &head, sizeof(head));
+	if (meshCount > 0) {
+		memcpy(dst + head.meshTable, entries.data(), meshCount * sizeof(Entry));
+	}
+	if (materialCount > 0) {
+		memcpy(dst + head.materialTable, materials, materialCount * sizeof(Material));
+	}
+	for (uint32_t n = 0; n < meshCount; n++) {
+		for (uint32_t s = 0; s < MESH_MAX_STREAMS && !encoded[n].streams[s].empty(); s++) {
+			memcpy(dst + entries[n].streams[s], encoded[n].streams[s].data(), encoded[n].streams[s].size());
+		}
+		memcpy(dst + entries[n].indices, encoded[n].indices.data(), encoded[n].indices.size());
+		if (!encoded[n].lods.empty()) {
+			memcpy(dst + entries[n].lods, encoded[n].lods.data(), encoded[n].lods.size() * sizeof(MeshLod));
+		}
+	}
+	out.flush();
+	return true;
+}
@@ -0,0 +1,134 @@
+#include "Trace.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace {
+/**
+ * Recorded event (timestamp in microseconds, as Chrome expects).
+ */
+struct Event {
+	const char* category;
+	const char* name;
+	double time;
+	uint64_t id;
+	char phase;
+};
+
+/**
+ * Single-producer ring: only the owning thread writes \c events and advances
+ * \c head (publishing each event with a release store); readers load \c head
+ * with acquire and re-check it after copying to discard overwritten slots.
+ */
+struct Ring {
+	Event events[TRACE_RING_SIZE];
+	std::atomic<uint64_t> head = 0;
+	uint32_t tid = 0;
+	Ring* next = NULLPTR;
+};
+
+std::atomic<bool> enabled = false;
+/**
+ * Every thread's ring (pushed onto the front, never removed: events from
+ * finished threads remain until dumped).
+ */
+std::atomic<Ring*> rings = NULLPTR;
+std::atomic<uint32_t> nextTid = 1;
+thread_local Ring* ring = NULLPTR;
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+/**
+ * Lazily creates and registers the calling thread's ring.
+ */
+Ring* getRing() {
+	if (!ring) {
+		ring = new Ring();
+		ring->tid = nextTid.fetch_add(1, std::memory_order_relaxed);
+		Ring* first = rings.load(std::memory_order_relaxed);
+		do {
+			ring->next = first;
+		} while (!rings.compare_exchange_weak(first, ring, std::memory_order_release, std::memory_order_relaxed));
+	}
+	return ring;
+}
+
+/**
+ * Writes \a str as a JSON string (names are mostly identifiers, but Dawn's are
+ * free-form).
+ */
+void writeString(FILE* file, const char* str) {
+	fputc('"', file);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\') {
+			fputc('\\', file);
+		}
+		if (static_cast<unsigned char>(*str) >= 0x20) {
+			fputc(*str, file);
+		}
+	}
+	fputc('"', file);
+}
+}
+
+void Trace::setEnabled(bool on) {
+	enabled.store(on, std::memory_order_relaxed);
+}
+
+bool Trace::isEnabled() {
+	return enabled.load(std::memory_order_relaxed);
+}
+
+double Trace::now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::record(char phase, const char* category, const char* name, double time, uint64_t id) {
+	Ring* r = getRing();
+	uint64_t head = r->head.load(std::memory_order_relaxed);
+	Event& event = r->events[head % TRACE_RING_SIZE];
+	event.category = category;
+	event.name     = name;
+	event.time     = time * 1000000.0;
+	event.id       = id;
+	event.phase    = phase;
+	r->head.store(head + 1, std::memory_order_release);
+}
+
+bool Trace::dump(const char* path) {
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		return false;
+	}
+	fputs("{\"traceEvents\":[", file);
+	bool first = true;
+	std::vector<Event> copy;
+	for (Ring* r = rings.load(std::memory_order_acquire); r; r = r->next) {
+		uint64_t end   = r->head.load(std::memory_order_acquire);
+		uint64_t begin = (end > TRACE_RING_SIZE) ? end - TRACE_RING_SIZE : 0;
+		copy.clear();
+		for (uint64_t n = begin; n < end; n++) {
+			copy.push_back(r->events[n % TRACE_RING_SIZE]);
+		}
+		// anything the owner wrapped over while copying is unreliable
+		uint64_t after = r->head.load(std::memory_order_acquire);
+		uint64_t valid = (after > TRACE_RING_SIZE) ? after - TRACE_RING_SIZE : 0;
+		for (uint64_t n = (valid > begin) ? valid - begin : 0; n < copy.size(); n++) {
+			const Event& event = copy[n];
+			fputs((first) ? "\n{\"name\":" : ",\n{\"name\":", file);
+			writeString(file, event.name);
+			fputs(",\"cat\":", file);
+			writeString(file, event.category);
+			fprintf(file, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u", event.phase, event.time, r->tid);
+			if (event.id) {
+				fprintf(file, ",\"id\":\"0x%llx\"", static_cast<unsigned long long>(event.id));
+			}
+			fputc('}', file);
+			first = false;
+		}
+	}
+	fputs("\n]}\n", file);
+	return fclose(file) == 0;
+}
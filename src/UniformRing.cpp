@@ -0,0 +1,62 @@
+#include "UniformRing.h"
+
+#include <cstdio>
+#include <cstring>
+
+UniformRing::~UniformRing()
+{
+#ifndef __EMSCRIPTEN__
+	release();
+#endif
+}
+
+void UniformRing::create(WGPUDevice device, size_t capacity)
+{
+	release();
+
+	capacity = (capacity + UNIFORM_RING_ALIGNMENT - 1) & ~(size_t) (UNIFORM_RING_ALIGNMENT - 1);
+	staging.assign(capacity, 0);
+	used = 0;
+	overflowed = false;
+
+	WGPUBufferDescriptor desc = {};
+	desc.usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_Uniform;
+	desc.size = capacity;
+	buffer = wgpuDeviceCreateBuffer(device, &desc);
+}
+
+void UniformRing::release()
+{
+	if (buffer) {
+		wgpuBufferRelease(buffer);
+		buffer = NULLPTR;
+	}
+}
+
+uint32_t UniformRing::push(const void* data, size_t size)
+{
+	size_t slot = (size + UNIFORM_RING_ALIGNMENT - 1) & ~(size_t) (UNIFORM_RING_ALIGNMENT - 1);
+	if (used + slot > staging.size()) {
+		// the offsets already handed out may be in commands being encoded, so growing is left to the caller
+		overflowed = true;
+		return UNIFORM_RING_FULL;
+	}
+	uint32_t offset = (uint32_t) used;
+	memcpy(staging.data() + offset, data, size);
+	used += slot;
+	return offset;
+}
+
+void UniformRing::grow(WGPUDevice device)
+{
+	create(device, staging.size() * 2);
+	printf("UniformRing: out of space, grown to %zu bytes\n", staging.size());
+}
+
+void UniformRing::flush(WGPUQueue queue)
+{
+	if (used > 0 && buffer) {
+		wgpuQueueWriteBuffer(queue, buffer, 0, staging.data(), used);
+	}
+	used = 0;
+}
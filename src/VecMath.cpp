@@ -0,0 +1,143 @@
+#include "VecMath.h"
+
+#include <math.h>
+
+float4x4 float4x4::rotationZ(float radians)
+{
+	float cosA = cosf(radians);
+	float sinA = sinf(radians);
+	float4x4 r;
+	r.cols[0] = float4::set( cosA, sinA, 0.0f, 0.0f);
+	r.cols[1] = float4::set(-sinA, cosA, 0.0f, 0.0f);
+	r.cols[2] = float4::set( 0.0f, 0.0f, 1.0f, 0.0f);
+	r.cols[3] = float4::set( 0.0f, 0.0f, 0.0f, 1.0f);
+	return r;
+}
+
+float4x4 float4x4::compose(const float* t, const float* q, const float* s)
+{
+	float x2 = q[0] + q[0], y2 = q[1] + q[1], z2 = q[2] + q[2];
+	float xx = q[0] * x2, yy = q[1] * y2, zz = q[2] * z2;
+	float xy = q[0] * y2, xz = q[0] * z2, yz = q[1] * z2;
+	float wx = q[3] * x2, wy = q[3] * y2, wz = q[3] * z2;
+	float4x4 r;
+	r.cols[0] = float4::set(1.0f - (yy + zz), xy + wz, xz - wy, 0.0f) * float4::splat(s[0]);
+	r.cols[1] = float4::set(xy - wz, 1.0f - (xx + zz), yz + wx, 0.0f) * float4::splat(s[1]);
+	r.cols[2] = float4::set(xz + wy, yz - wx, 1.0f - (xx + yy), 0.0f) * float4::splat(s[2]);
+	r.cols[3] = float4::set(t[0], t[1], t[2], 1.0f);
+	return r;
+}
+
+void Frustum::getPlanes(const float4x4& viewProj, float* planes)
+{
+	// rows of the matrix (x, y, z and w in clip space)
+	float m[16];
+	viewProj.store(m);
+	float rows[4][4];
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			rows[r][c] = m[c * 4 + r];
+		}
+	}
+	// -w <= x <= w, -w <= y <= w, 0 <= z <= w
+	for (int c = 0; c < 4; c++) {
+		planes[ 0 + c] = rows[3][c] + rows[0][c];
+		planes[ 4 + c] = rows[3][c] - rows[0][c];
+		planes[ 8 + c] = rows[3][c] + rows[1][c];
+		planes[12 + c] = rows[3][c] - rows[1][c];
+		planes[16 + c] = rows[2][c];
+		planes[20 + c] = rows[3][c] - rows[2][c];
+	}
+}
+
+Frustum Frustum::fromMatrix(const float4x4& viewProj)
+{
+	// padded with two planes everything passes
+	float planes[8][4] = {};
+	getPlanes(viewProj, planes[0]);
+	planes[6][3] = planes[7][3] = 1.0f;
+	Frustum f;
+	for (int n = 0; n < 2; n++) {
+		const float (*p)[4] = planes + n * 4;
+		f.nx[n] = float4::set(p[0][0], p[1][0], p[2][0], p[3][0]);
+		f.ny[n] = float4::set(p[0][1], p[1][1], p[2][1], p[3][1]);
+		f.nz[n] = float4::set(p[0][2], p[1][2], p[2][2], p[3][2]);
+		f.d [n] = float4::set(p[0][3], p[1][3], p[2][3], p[3][3]);
+		f.ax[n] = vabs(f.nx[n]);
+		f.ay[n] = vabs(f.ny[n]);
+		f.az[n] = vabs(f.nz[n]);
+	}
+	return f;
+}
+
+void VecMath::transformPoints(const float4x4& m, const float* points, float* out, size_t count)
+{
+	for (size_t n = 0; n < count; n++) {
+		(m * float4::load3(points + n * 3, 1.0f)).store3(out + n * 3);
+	}
+}
+
+void VecMath::multiplyMatrices(const float4x4& a, const float* b, float* out, size_t count, size_t stride)
+{
+	for (size_t n = 0; n < count; n++) {
+		(a * float4x4::load(b + n * stride)).store(out + n * stride);
+	}
+}
+
+void VecMath::multiplyMatrices(const float* a, const float4x4& b, float* out, size_t count, size_t stride)
+{
+	for (size_t n = 0; n < count; n++) {
+		(float4x4::load(a + n * stride) * b).store(out + n * stride);
+	}
+}
+
+/**
+ * Loads a point of one to four components (the rest zero).
+ */
+static inline float4 loadPoint(const float* p, size_t components) {
+	if (components == 4) {
+		return float4::load(p);
+	}
+	float tmp[4] = {};
+	memcpy(tmp, p, components * sizeof(float));
+	return float4::load(tmp);
+}
+
+void VecMath::computeBounds(const float* points, size_t count, size_t components, float* min, float* max, size_t stride)
+{
+	if (stride == 0) {
+		stride = components;
+	}
+	float4 lo = loadPoint(points, components);
+	float4 hi = lo;
+	for (size_t n = 1; n < count; n++) {
+		float4 p = loadPoint(points + n * stride, components);
+		lo = vmin(lo, p);
+		hi = vmax(hi, p);
+	}
+	float tmp[4];
+	lo.store(tmp);
+	memcpy(min, tmp, components * sizeof(float));
+	hi.store(tmp);
+	memcpy(max, tmp, components * sizeof(float));
+}
+
+void VecMath::transformBounds(const float* matrices, const float* min, const float* max,
+		float* outMin, float* outMax, size_t count, size_t stride)
+{
+	float4 lo = float4::load3(min, 1.0f);
+	float4 hi = float4::load3(max, 1.0f);
+	float4 half = float4::splat(0.5f);
+	float4 centre = (lo + hi) * half;
+	float4 extent = (hi - lo) * half;
+	float4 ex = extent.broadcast<0>();
+	float4 ey = extent.broadcast<1>();
+	float4 ez = extent.broadcast<2>();
+	for (size_t n = 0; n < count; n++) {
+		float4x4 m = float4x4::load(matrices + n * stride);
+		float4 c = m * centre;
+		float4 e = madd(vabs(m.cols[2]), ez, madd(vabs(m.cols[1]), ey, vabs(m.cols[0]) * ex));
+		(c - e).store3(outMin + n * 3);
+		(c + e).store3(outMax + n * 3);
+	}
+}
@@ -0,0 +1,208 @@
+#include "FileCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <filesystem>
+#include <vector>
+
+/**
+ * Index file marker (\c DWNC).
+ */
+#define FILE_CACHE_MAGIC 0x434E5744
+
+/**
+ * Index file layout version (bumped whenever \c Header or \c Entry change).
+ */
+#define FILE_CACHE_VERSION 1
+
+/**
+ * FNV-1a hash, never returning zero (which marks an empty index slot).
+ */
+static uint64_t hashBytes(const void* data, size_t size) {
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for (size_t n = 0; n < size; n++) {
+		hash ^= static_cast<const uint8_t*>(data)[n];
+		hash *= 0x100000001B3ULL;
+	}
+	return (hash) ? hash : 1;
+}
+
+FileCache::FileCache(const char* cacheDir, const void* fingerprint, size_t fingerprintSize, uint64_t maxSize)
+	: dir(cacheDir)
+	, maxSize(maxSize) {
+	std::error_code err;
+	std::filesystem::create_directories(dir, err);
+	if (!index.create((dir + "/index.bin").c_str(), sizeof(Header) + sizeof(Entry) * FILE_CACHE_MAX_ENTRIES)) {
+		printf("Unable to open shader cache in: %s\n", cacheDir);
+		return;
+	}
+	uint64_t print = hashBytes(fingerprint, fingerprintSize);
+	Header* head = header();
+	if (head->magic != FILE_CACHE_MAGIC || head->version != FILE_CACHE_VERSION || head->capacity != FILE_CACHE_MAX_ENTRIES || head->fingerprint != print) {
+		// new, stale or from an incompatible build: empty it
+		if (head->magic == FILE_CACHE_MAGIC && head->capacity == FILE_CACHE_MAX_ENTRIES) {
+			for (uint32_t n = 0; n < FILE_CACHE_MAX_ENTRIES; n++) {
+				if (entries()[n].hash) {
+					std::filesystem::remove(path(entries()[n].hash), err);
+				}
+			}
+		}
+		memset(index.data(), 0, index.size());
+		head->magic       = FILE_CACHE_MAGIC;
+		head->version     = FILE_CACHE_VERSION;
+		head->fingerprint = print;
+		head->capacity    = FILE_CACHE_MAX_ENTRIES;
+		index.flush();
+	}
+}
+
+FileCache::~FileCache() {
+	index.flush();
+}
+
+FileCache::Header* FileCache::header() {
+	return static_cast<Header*>(index.data());
+}
+
+FileCache::Entry* FileCache::entries() {
+	return reinterpret_cast<Entry*>(header() + 1);
+}
+
+uint32_t FileCache::find(uint64_t hash) {
+	Entry* slots = entries();
+	uint32_t slot = static_cast<uint32_t>(hash % FILE_CACHE_MAX_ENTRIES);
+	while (slots[slot].hash && slots[slot].hash != hash) {
+		slot = (slot + 1) % FILE_CACHE_MAX_ENTRIES;
+	}
+	return slot;
+}
+
+void FileCache::remove(uint32_t slot) {
+	Entry* slots = entries();
+	header()->totalSize -= slots[slot].size;
+	header()->count--;
+	uint32_t next = slot;
+	while (true) {
+		slots[slot] = {};
+		while (true) {
+			next = (next + 1) % FILE_CACHE_MAX_ENTRIES;
+			if (!slots[next].hash) {
+				return;
+			}
+			// move the entry back unless its home lies cyclically in (slot, next]
+			uint32_t home = static_cast<uint32_t>(slots[next].hash % FILE_CACHE_MAX_ENTRIES);
+			if ((slot <= next) ? (home <= slot || home > next) : (home <= slot && home > next)) {
+				break;
+			}
+		}
+		slots[slot] = slots[next];
+		slot = next;
+	}
+}
+
+void FileCache::evict(uint64_t needed) {
+	Header* head = header();
+	Entry* slots = entries();
+	std::error_code err;
+	// keep a free slot so probing always terminates
+	while (head->count > 0 && (head->totalSize + needed > maxSize || head->count >= FILE_CACHE_MAX_ENTRIES - 1)) {
+		uint32_t oldest = 0;
+		uint64_t oldestUse = UINT64_MAX;
+		for (uint32_t n = 0; n < FILE_CACHE_MAX_ENTRIES; n++) {
+			if (slots[n].hash && slots[n].lastUse < oldestUse) {
+				oldest = n;
+				oldestUse = slots[n].lastUse;
+			}
+		}
+		std::filesystem::remove(path(slots[oldest].hash), err);
+		remove(oldest);
+	}
+}
+
+std::string FileCache::path(uint64_t hash) const {
+	char name[24];
+	snprintf(name, sizeof name, "/%016llx.bin", static_cast<unsigned long long>(hash));
+	return dir + name;
+}
+
+/**
+ * Value files hold the key size, the key, then the value.
+ */
+size_t FileCache::LoadData(const WGPUDevice /*device*/, const void* key, size_t keySize, void* valueOut, size_t valueSize) {
+	std::lock_guard<std::mutex> guard(lock);
+	if (!index.isOpen()) {
+		return 0;
+	}
+	uint64_t hash = hashBytes(key, keySize);
+	uint32_t slot = find(hash);
+	Entry& entry = entries()[slot];
+	if (!entry.hash) {
+		return 0;
+	}
+	size_t found = 0;
+	if (FILE* file = fopen(path(hash).c_str(), "rb")) {
+		uint64_t storedSize = 0;
+		if (fread(&storedSize, sizeof storedSize, 1, file) == 1 && storedSize == keySize) {
+			std::vector<uint8_t> storedKey(keySize);
+			if (fread(storedKey.data(), 1, keySize, file) == keySize && memcmp(storedKey.data(), key, keySize) == 0) {
+				if (!valueOut) {
+					found = static_cast<size_t>(entry.size);
+				} else if (valueSize >= entry.size) {
+					found = fread(valueOut, 1, static_cast<size_t>(entry.size), file);
+					if (found != entry.size) {
+						found = 0;
+					}
+				}
+			}
+		}
+		fclose(file);
+	}
+	if (found) {
+		entry.lastUse = ++header()->clock;
+	} else if (!(valueOut && valueSize < entry.size)) {
+		// missing, truncated or colliding with another key: forget it
+		std::error_code err;
+		std::filesystem::remove(path(hash), err);
+		remove(slot);
+	}
+	return found;
+}
+
+void FileCache::StoreData(const WGPUDevice /*device*/, const void* key, size_t keySize, const void* value, size_t valueSize) {
+	std::lock_guard<std::mutex> guard(lock);
+	if (!index.isOpen() || valueSize == 0 || valueSize > maxSize) {
+		return;
+	}
+	uint64_t hash = hashBytes(key, keySize);
+	uint32_t slot = find(hash);
+	if (entries()[slot].hash) {
+		remove(slot);
+	}
+	evict(valueSize);
+	// write to a temporary then rename, so a crash never leaves a partial value
+	std::string dest = path(hash);
+	std::string temp = dest + ".tmp";
+	FILE* file = fopen(temp.c_str(), "wb");
+	if (!file) {
+		return;
+	}
+	uint64_t storedSize = keySize;
+	bool written = fwrite(&storedSize, sizeof storedSize, 1, file) == 1
+		&& fwrite(key,   1, keySize,   file) == keySize
+		&& fwrite(value, 1, valueSize, file) == valueSize;
+	written = (fclose(file) == 0) && written;
+	std::error_code err;
+	if (written) {
+		std::filesystem::rename(temp, dest, err);
+	}
+	if (!written || err) {
+		std::filesystem::remove(temp, err);
+		return;
+	}
+	Entry& entry = entries()[find(hash)];
+	entry.hash    = hash;
+	entry.size    = valueSize;
+	entry.lastUse = ++header()->clock;
+	header()->totalSize += valueSize;
+	header()->count++;
+}
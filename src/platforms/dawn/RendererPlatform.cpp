@@ -0,0 +1,28 @@
+#include "RendererPlatform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Opens the cache on first request. Dawn asks once per device, and the cache
+ * needs to outlive the devices using it, so it stays with the platform (which
+ * lives as long as the Dawn instance). A device with a different fingerprint
+ * (another adapter or backend) goes without, since the cache only holds
+ * results for the first.
+ */
+dawn_platform::CachingInterface* RendererPlatform::GetCachingInterface(const void* fingerprint, size_t fingerprintSize) {
+	if (!cache) {
+		const char* dir = getenv("RENDERER_CACHE_DIR");
+		if (!dir) {
+			dir = RENDERER_CACHE_DIR;
+		}
+		if (!*dir) {
+			return NULLPTR;
+		}
+		cache = std::make_unique<FileCache>(dir, fingerprint, fingerprintSize);
+		cachePrint.assign(static_cast<const uint8_t*>(fingerprint), static_cast<const uint8_t*>(fingerprint) + fingerprintSize);
+	} else if (fingerprintSize != cachePrint.size() || (fingerprintSize > 0 && memcmp(fingerprint, cachePrint.data(), fingerprintSize) != 0)) {
+		return NULLPTR;
+	}
+	return (cache->isOpen()) ? cache.get() : NULLPTR;
+}
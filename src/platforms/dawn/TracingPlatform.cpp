@@ -0,0 +1,50 @@
+#include "TracingPlatform.h"
+#include "Trace.h"
+
+#include <stdlib.h>
+
+/**
+ * Names of Dawn's trace categories, indexed by \c dawn_platform::TraceCategory.
+ */
+static const char* const CATEGORY_NAMES[] = {
+	"Dawn",
+	"Dawn.Validation",
+	"Dawn.Recording",
+	"Dawn.GPUWork",
+};
+
+TracingPlatform::TracingPlatform() {
+	bool enabled = getenv("RENDERER_TRACE") != NULLPTR;
+	for (unsigned n = 0; n < sizeof flags; n++) {
+		flags[n] = enabled;
+	}
+	if (enabled) {
+		Trace::setEnabled(true);
+	}
+}
+
+bool TracingPlatform::dump() {
+	const char* path = getenv("RENDERER_TRACE");
+	return path && Trace::isEnabled() && Trace::dump(path);
+}
+
+const unsigned char* TracingPlatform::GetTraceCategoryEnabledFlag(dawn_platform::TraceCategory category) {
+	unsigned index = static_cast<unsigned>(category);
+	return &flags[(index < sizeof flags) ? index : 0];
+}
+
+double TracingPlatform::MonotonicallyIncreasingTime() {
+	return Trace::now();
+}
+
+/**
+ * Only the event itself is kept (Dawn's trace arguments are ignored).
+ */
+uint64_t TracingPlatform::AddTraceEvent(char phase, const unsigned char* categoryGroupEnabled, const char* name, uint64_t id,
+		double timestamp, int /*numArgs*/, const char** /*argNames*/, const unsigned char* /*argTypes*/, const uint64_t* /*argValues*/,
+		unsigned char /*flags*/) {
+	if (Trace::isEnabled()) {
+		Trace::record(phase, CATEGORY_NAMES[categoryGroupEnabled - flags], name, timestamp, id);
+	}
+	return 0;
+}
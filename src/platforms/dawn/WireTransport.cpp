@@ -0,0 +1,259 @@
+#include "WireTransport.h"
+#include "Trace.h"
+
+#include <stdio.h>
+
+#include <dawn_native/DawnNative.h>
+
+/**
+ * Size of each chunk's header (the chunk's size in bytes, which also keeps
+ * commands 8-byte aligned).
+ */
+#define WIRE_CHUNK_HEADER sizeof(uint64_t)
+
+/**
+ * Header marking the rest of the ring as unused (the next chunk starts at the
+ * beginning).
+ */
+#define WIRE_CHUNK_WRAP UINT64_MAX
+
+/**
+ * No chunk is open.
+ */
+#define WIRE_NO_CHUNK UINT64_MAX
+
+//******************************** WireRing *********************************/
+
+WireRing::WireRing(size_t size, std::atomic<uint32_t>* signal, WireRing* replies)
+	: data(size)
+	, capacity(size)
+	, chunk(WIRE_NO_CHUNK)
+	, signal(signal)
+	, replies(replies) {}
+
+uint64_t& WireRing::header(uint64_t pos) {
+	return *reinterpret_cast<uint64_t*>(&data[pos % capacity]);
+}
+
+void WireRing::waitForSpace(uint64_t size) {
+	while (true) {
+		if (replies) {
+			/*
+			 * The consumer may be blocked writing a reply, so the replies are
+			 * taken out of their ring while waiting, with the consumer bumping
+			 * the replies' signal as it frees space here (hence reading it
+			 * first, so no wake-up is missed).
+			 */
+			uint32_t seen = replies->signal->load(std::memory_order_acquire);
+			if (writePos + size - consumed.load(std::memory_order_acquire) <= capacity) {
+				return;
+			}
+			replies->stash();
+			replies->signal->wait(seen, std::memory_order_acquire);
+		} else {
+			uint64_t done = consumed.load(std::memory_order_acquire);
+			if (writePos + size - done <= capacity) {
+				return;
+			}
+			consumed.wait(done, std::memory_order_acquire);
+		}
+	}
+}
+
+/**
+ * A quarter of the ring, so that a command always fits once the consumer has
+ * caught up (however the free space is split by the end of the ring).
+ */
+size_t WireRing::GetMaximumAllocationSize() const {
+	return static_cast<size_t>(capacity / 4);
+}
+
+void* WireRing::GetCmdSpace(size_t size) {
+	uint64_t need = (size + 7) & ~uint64_t(7);
+	if (need > GetMaximumAllocationSize()) {
+		return NULLPTR;
+	}
+	uint64_t offset = writePos % capacity;
+	if (chunk == WIRE_NO_CHUNK || offset + need > capacity || writePos + need - consumed.load(std::memory_order_acquire) > capacity) {
+		// publish what we have (the consumer can't free the open chunk) and start a new one
+		Flush();
+		if (writePos % capacity + WIRE_CHUNK_HEADER + need > capacity) {
+			waitForSpace(WIRE_CHUNK_HEADER);
+			header(writePos) = WIRE_CHUNK_WRAP;
+			writePos += capacity - writePos % capacity;
+			committed.store(writePos, std::memory_order_release);
+		}
+		waitForSpace(WIRE_CHUNK_HEADER + need);
+		chunk = writePos;
+		writePos += WIRE_CHUNK_HEADER;
+	}
+	void* ptr = &data[writePos % capacity];
+	writePos += need;
+	return ptr;
+}
+
+bool WireRing::Flush() {
+	if (chunk != WIRE_NO_CHUNK) {
+		header(chunk) = writePos - chunk - WIRE_CHUNK_HEADER;
+		chunk = WIRE_NO_CHUNK;
+		committed.store(writePos, std::memory_order_release);
+		if (signal) {
+			signal->fetch_add(1, std::memory_order_release);
+			signal->notify_one();
+		}
+	}
+	return true;
+}
+
+bool WireRing::consume(dawn_wire::CommandHandler& handler) {
+	bool valid = true;
+	if (stashed.size() > 0) {
+		// chunks only hold whole commands so the stash is handled in one go
+		valid = handler.HandleCommands(stashed.data(), stashed.size()) != NULLPTR;
+		stashed.clear();
+	}
+	uint64_t end = committed.load(std::memory_order_acquire);
+	uint64_t pos = consumed.load(std::memory_order_relaxed);
+	while (pos < end) {
+		uint64_t size = header(pos);
+		if (size == WIRE_CHUNK_WRAP) {
+			pos += capacity - pos % capacity;
+		} else {
+			if (valid && size > 0) {
+				valid = handler.HandleCommands(&data[(pos + WIRE_CHUNK_HEADER) % capacity], static_cast<size_t>(size)) != NULLPTR;
+			}
+			pos += WIRE_CHUNK_HEADER + size;
+		}
+		// hand each chunk back as soon as it's done with
+		consumed.store(pos, std::memory_order_release);
+		consumed.notify_one();
+		if (replies) {
+			replies->signal->fetch_add(1, std::memory_order_release);
+			replies->signal->notify_one();
+		}
+	}
+	return valid;
+}
+
+void WireRing::stash() {
+	uint64_t end = committed.load(std::memory_order_acquire);
+	uint64_t pos = consumed.load(std::memory_order_relaxed);
+	while (pos < end) {
+		uint64_t size = header(pos);
+		if (size == WIRE_CHUNK_WRAP) {
+			pos += capacity - pos % capacity;
+		} else {
+			const char* src = &data[(pos + WIRE_CHUNK_HEADER) % capacity];
+			stashed.insert(stashed.end(), src, src + size);
+			pos += WIRE_CHUNK_HEADER + size;
+		}
+	}
+	consumed.store(pos, std::memory_order_release);
+	consumed.notify_one();
+}
+
+//****************************** WireTransport ******************************/
+
+/**
+ * The single active transport, flushed by \c #presentAndFlush().
+ */
+static WireTransport* active = NULLPTR;
+
+/**
+ * Client \c swapChainPresent proc, ending a frame.
+ */
+static WGPUProcSwapChainPresent clientPresent = NULLPTR;
+
+/**
+ * Replacement \c swapChainPresent proc, sending the frame's commands once it
+ * has been recorded.
+ */
+static void presentAndFlush(WGPUSwapChain swapChain) {
+	clientPresent(swapChain);
+	if (active) {
+		active->flush();
+	}
+}
+
+WireTransport::WireTransport(WGPUDevice device, size_t ringSize)
+	: toServer(ringSize, &signal, &toClient)
+	, toClient(ringSize, &clientSignal)
+	, nativeProcs(dawn_native::GetProcs())
+	, clientProcs(dawn_wire::client::GetProcs()) {
+	dawn_wire::WireServerDescriptor serverDesc = {};
+	serverDesc.device     = device;
+	serverDesc.procs      = &nativeProcs;
+	serverDesc.serializer = &toClient;
+	server = std::make_unique<dawn_wire::WireServer>(serverDesc);
+
+	dawn_wire::WireClientDescriptor clientDesc = {};
+	clientDesc.serializer = &toServer;
+	client = std::make_unique<dawn_wire::WireClient>(clientDesc);
+
+	clientPresent = clientProcs.swapChainPresent;
+	clientProcs.swapChainPresent = presentAndFlush;
+	active = this;
+
+	thread = std::thread(&WireTransport::run, this);
+}
+
+WireTransport::~WireTransport() {
+	flush();
+	running.store(false, std::memory_order_release);
+	signal.fetch_add(1, std::memory_order_release);
+	signal.notify_one();
+	// the last commands may return more than the ring holds, so keep taking it
+	while (true) {
+		uint32_t seen = clientSignal.load(std::memory_order_acquire);
+		if (stopped.load(std::memory_order_acquire)) {
+			break;
+		}
+		toClient.stash();
+		clientSignal.wait(seen, std::memory_order_acquire);
+	}
+	thread.join();
+	active = NULLPTR;
+	// the client may still send commands when disconnected, which are dropped
+	client->Disconnect();
+	client.reset();
+	server.reset();
+}
+
+WGPUDevice WireTransport::getDevice() const {
+	return client->GetDevice();
+}
+
+WireTransport* WireTransport::getActive() {
+	return active;
+}
+
+void WireTransport::flush() {
+	TRACE_SCOPE("WireTransport::flush");
+	toServer.Flush();
+	if (!toClient.consume(*client)) {
+		puts("Invalid return commands from the wire server");
+	}
+}
+
+void WireTransport::run() {
+	while (true) {
+		uint32_t seen = signal.load(std::memory_order_acquire);
+		// read before consuming, so the final commands are always decoded
+		bool stop = !running.load(std::memory_order_acquire);
+		{
+			TRACE_SCOPE("WireTransport::run");
+			if (!toServer.consume(*server)) {
+				puts("Invalid commands sent to the wire server");
+			}
+			toClient.Flush();
+		}
+		if (stop) {
+			break;
+		}
+		// sleep until the next flush (or stop)
+		signal.wait(seen, std::memory_order_acquire);
+	}
+	stopped.store(true, std::memory_order_release);
+	clientSignal.fetch_add(1, std::memory_order_release);
+	clientSignal.notify_one();
+}
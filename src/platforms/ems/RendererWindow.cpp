@@ -14,6 +14,26 @@ struct HandleImpl {} DUMMY;
 MouseHandler RendererWindow::mouseClickHandlerClb = NULLPTR;
 ResizeHandler RendererWindow::resizeHandlerClb = NULLPTR;
 KeyHandler RendererWindow::keyHandlerClb = NULLPTR;
+InputQueue* RendererWindow::inputQueue = NULLPTR;
+RedrawQuery RendererWindow::redrawQueryClb = NULLPTR;
+
+/**
+ * Redraw function passed to \c #RendererWindow::loop().
+ */
+static RenderFunc _NULLABLE redrawFunc = NULLPTR;
+
+/**
+ * Whether the animation frame loop was stopped for having nothing to render
+ * (and needs restarting by \c #RendererWindow::wake()).
+ */
+static bool suspended = false;
+
+/**
+ * Whether \c #RendererWindow::wake() was called since the last frame, which
+ * is then rendered regardless of the on-demand query (since input such as the
+ * cursor moving reaches ImGui without the renderer seeing it).
+ */
+static bool woken = false;
 
 //******************************** Public API ********************************/
 /**
@@ -97,27 +117,97 @@ void RendererWindow::show(Handle /*wHnd*/, bool /*show*/)
 }
 
 /**
- * Main application/window loop.
+ * Not supported (the browser runs everything on one thread).
+ */
+bool RendererWindow::threaded(InputQueue* /*queue*/)
+{
+	return false;
+}
+
+/**
+ * Browser event handler waking a suspended loop (leaving the event for GLFW and
+ * the page to handle as normal).
+ */
+template<typename Event>
+static EM_BOOL wakeOnEvent(int /*eventType*/, const Event* /*event*/, void* /*userData*/) {
+	RendererWindow::wake();
+	return EM_FALSE;
+}
+
+/**
+ * Stores the on-demand query, also listening for the page's input so that any
+ * of it restarts a suspended loop.
+ */
+void RendererWindow::onDemand(RedrawQuery func)
+{
+	redrawQueryClb = func;
+	if (func) {
+		const char* target = EMSCRIPTEN_EVENT_TARGET_WINDOW;
+		emscripten_set_mousedown_callback(target, NULLPTR, false, wakeOnEvent<EmscriptenMouseEvent>);
+		emscripten_set_mouseup_callback(target, NULLPTR, false, wakeOnEvent<EmscriptenMouseEvent>);
+		emscripten_set_mousemove_callback(target, NULLPTR, false, wakeOnEvent<EmscriptenMouseEvent>);
+		emscripten_set_wheel_callback(target, NULLPTR, false, wakeOnEvent<EmscriptenWheelEvent>);
+		emscripten_set_keydown_callback(target, NULLPTR, false, wakeOnEvent<EmscriptenKeyboardEvent>);
+		emscripten_set_keyup_callback(target, NULLPTR, false, wakeOnEvent<EmscriptenKeyboardEvent>);
+		emscripten_set_touchstart_callback(target, NULLPTR, false, wakeOnEvent<EmscriptenTouchEvent>);
+		emscripten_set_touchmove_callback(target, NULLPTR, false, wakeOnEvent<EmscriptenTouchEvent>);
+		emscripten_set_touchend_callback(target, NULLPTR, false, wakeOnEvent<EmscriptenTouchEvent>);
+		emscripten_set_resize_callback(target, NULLPTR, false, wakeOnEvent<EmscriptenUiEvent>);
+	}
+}
+
+/**
+ * Animation frame callback (adheres to \c em_request_animation_frame_loop
+ * callbacks, passed the on-demand query as \a userData), stopping the loop
+ * until \c #RendererWindow::wake() when there's nothing to render.
+ */
+static EM_BOOL animationFrame(double time, void* userData) {
+	RedrawQuery query = (RedrawQuery)userData;
+	if (!woken && query && !query()) {
+		suspended = true;
+		return EM_FALSE;
+	}
+	woken = false;
+	//glfwPollEvents();
+
+	//// React to changes in screen size
+	//if (resizeHandlerClb != NULLPTR) {
+	//	int width, height;
+	//	glfwGetFramebufferSize(_window, &width, &height);
+
+	//	if (width != wgpu_swap_chain_width && height != wgpu_swap_chain_height)
+	//	{
+	//		resizeHandlerClb(width, height);
+	//	}
+	//}
+
+	return (EM_BOOL)redrawFunc(time);
+}
+
+/**
+ * Renders the next frame, restarting the animation frame loop if it was
+ * suspended.
+ */
+void RendererWindow::wake()
+{
+	woken = true;
+	if (suspended) {
+		suspended = false;
+		emscripten_request_animation_frame_loop(animationFrame, (void*)redrawQueryClb);
+	}
+}
+
+/**
+ * Main application/window loop. Rendering on demand (see \c #onDemand()) the
+ * animation frame loop stops whenever there's nothing to render, with the
+ * page's input or \c #wake() restarting it.
  */
 void RendererWindow::loop(Handle /*wHnd*/, RenderFunc func)
 {
-	emscripten_request_animation_frame_loop([](double time, void* userData) {
-		//glfwPollEvents();
-
-		//// React to changes in screen size
-		//if (resizeHandlerClb != NULLPTR) {
-		//	int width, height;
-		//	glfwGetFramebufferSize(_window, &width, &height);
-
-		//	if (width != wgpu_swap_chain_width && height != wgpu_swap_chain_height)
-		//	{
-		//		resizeHandlerClb(width, height);
-		//	}
-		//}
-
-		RenderFunc redraw = (RenderFunc)userData;
-		return (EM_BOOL)redraw(time);
-		}, (void*)func);
+	if (func) {
+		redrawFunc = func;
+		emscripten_request_animation_frame_loop(animationFrame, (void*)redrawQueryClb);
+	}
 }
 
 /**
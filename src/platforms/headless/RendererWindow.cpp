@@ -0,0 +1,241 @@
+#include "RendererWindow.h"
+#include "TracingPlatform.h"
+#include "WireTransport.h"
+
+#include <stdlib.h>
+#include <vector>
+
+#include <dawn/dawn_proc.h>
+#include <dawn_native/NullBackend.h>
+
+/**
+ * Number of frames \c #loop() runs when \c RENDERER_HEADLESS_FRAMES is not set
+ * in the environment.
+ */
+#define HEADLESS_FRAMES 1000
+
+/**
+ * Synthetic time step (in seconds) passed to the redraw function each frame.
+ */
+#define HEADLESS_TIMESTEP (1.0 / 60.0)
+
+/**
+ * Temporary dummy window handle (there is no native window to refer to).
+ */
+struct HandleImpl {} DUMMY;
+
+// initialization of static members
+MouseHandler RendererWindow::mouseClickHandlerClb = NULLPTR;
+ResizeHandler RendererWindow::resizeHandlerClb = NULLPTR;
+KeyHandler RendererWindow::keyHandlerClb = NULLPTR;
+InputQueue* RendererWindow::inputQueue = NULLPTR;
+RedrawQuery RendererWindow::redrawQueryClb = NULLPTR;
+
+/*
+ * Null swap chain implementation (see the Windows version for the lifecycle
+ * questions around this struct).
+ */
+static DawnSwapChainImplementation swapImpl;
+
+/**
+ * Optional \c dawn_wire transport (see \c #createDevice()), moving the calls
+ * into Dawn onto a separate GPU thread.
+ */
+static std::unique_ptr<WireTransport> wire;
+
+/**
+ * Finds the Null backend adapter. This is always available in Dawn (unless
+ * explicitly disabled at build time) and needs no GPU, driver or display. The
+ * instance has a \c TracingPlatform installed, persisting compiled shaders
+ * between runs (and collecting Dawn's trace events).
+ *
+ * \return the Null adapter or an empty adapter wrapper
+ */
+static dawn_native::Adapter requestAdapter() {
+	static TracingPlatform platform;
+	static dawn_native::Instance instance;
+	instance.SetPlatform(&platform);
+	instance.DiscoverDefaultAdapters();
+	wgpu::AdapterProperties properties;
+	std::vector<dawn_native::Adapter> adapters = instance.GetAdapters();
+	for (auto it = adapters.begin(); it != adapters.end(); ++it) {
+		it->GetProperties(&properties);
+		if (static_cast<WGPUBackendType>(properties.backendType) == WGPUBackendType_Null) {
+			return *it;
+		}
+	}
+	return dawn_native::Adapter();
+}
+
+/**
+ * Dawn error handling callback (adheres to \c WGPUErrorCallback).
+ *
+ * \param[in] message error string
+ */
+static void printError(WGPUErrorType /*type*/, const char* message, void*) {
+	puts(message);
+}
+
+/**
+ * Function that creates the headless swap chain. Frames are recorded and
+ * submitted as normal but never shown.
+ */
+WGPUSwapChain RendererWindow::createSwapChain(WGPUDevice device) {
+	WGPUSwapChainDescriptor swapDesc = {};
+	swapDesc.implementation = reinterpret_cast<uintptr_t>(&swapImpl);
+	wgpu_swap_chain = wgpuDeviceCreateSwapChain(device, nullptr, &swapDesc);
+	wgpuSwapChainConfigure(wgpu_swap_chain, WGPUTextureFormat_RGBA8Unorm, WGPUTextureUsage_OutputAttachment,
+		wgpu_swap_chain_width, wgpu_swap_chain_height);
+
+	return wgpu_swap_chain;
+}
+
+/**
+ * Function that \e creates a window. No GLFW window is created, only the
+ * frame size is recorded.
+ */
+Handle RendererWindow::create(unsigned winW, unsigned winH, const char* /*name*/) {
+	_window = NULLPTR;
+	wgpu_swap_chain_width  = (winW) ? winW : WINDOW_W;
+	wgpu_swap_chain_height = (winH) ? winH : WINDOW_H;
+
+	return &DUMMY;
+}
+
+/**
+ * Obtaining a WebGPU device from Dawn's Null backend (the requested \a type is
+ * ignored). With \c RENDERER_WIRE set in the environment the returned device
+ * is a \c dawn_wire client, with a \c WireTransport calling Dawn on its own
+ * thread.
+ */
+WGPUDevice RendererWindow::createDevice(Handle /*window*/, WGPUBackendType /*type*/) {
+	wgpu_device = NULL;
+	if (dawn_native::Adapter adapter = requestAdapter()) {
+		wgpu_device = adapter.CreateDevice();
+		if (swapImpl.userData == nullptr) {
+			swapImpl = dawn_native::null::CreateNativeSwapChainImpl();
+		}
+		DawnProcTable procs(dawn_native::GetProcs());
+		procs.deviceSetUncapturedErrorCallback(wgpu_device, printError, nullptr);
+		dawnProcSetProcs(&procs);
+		if (const char* env = getenv("RENDERER_WIRE")) {
+			// a number sets the ring size (a small ring to exercise it filling)
+			size_t ringSize = (size_t) strtoul(env, NULLPTR, 10);
+			// from here on the renderer only sees the client device and procs
+			wire = std::make_unique<WireTransport>(wgpu_device, (ringSize) ? ringSize : WIRE_RING_SIZE);
+			wgpu_device = wire->getDevice();
+			dawnProcSetProcs(&wire->getProcs());
+			wire->getProcs().deviceSetUncapturedErrorCallback(wgpu_device, printError, nullptr);
+		}
+	}
+
+	return wgpu_device;
+}
+
+/**
+ * Destroys the window (nothing to do without one, other than stopping any
+ * wire transport).
+ */
+void RendererWindow::destroy(Handle /*wHnd*/)
+{
+	wire.reset();
+}
+
+/**
+ * Opens the window (nothing to do without one).
+ */
+void RendererWindow::show(Handle /*wHnd*/, bool /*show*/)
+{
+}
+
+/**
+ * Not supported (there's no input to decouple from the frames).
+ */
+bool RendererWindow::threaded(InputQueue* /*queue*/)
+{
+	return false;
+}
+
+/**
+ * Stores the on-demand query, which is ignored: every frame is rendered,
+ * since measuring them is what the headless build is for.
+ */
+void RendererWindow::onDemand(RedrawQuery func)
+{
+	redrawQueryClb = func;
+}
+
+/**
+ * Nothing to wake (the loop never waits).
+ */
+void RendererWindow::wake()
+{
+}
+
+/**
+ * Main application loop. Runs a fixed number of frames as fast as possible
+ * (\c RENDERER_HEADLESS_FRAMES from the environment, or \c #HEADLESS_FRAMES)
+ * with a synthetic clock, returning early if the redraw function does.
+ */
+void RendererWindow::loop(Handle /*wHnd*/, RenderFunc func)
+{
+	unsigned frames = HEADLESS_FRAMES;
+	if (const char* env = getenv("RENDERER_HEADLESS_FRAMES")) {
+		frames = (unsigned) strtoul(env, NULLPTR, 10);
+	}
+
+	// the renderer only learns its size through the resize callback
+	if (resizeHandlerClb != NULLPTR) {
+		resizeHandlerClb(wgpu_swap_chain_width, wgpu_swap_chain_height);
+	}
+
+	double time = 0.0;
+	for (unsigned n = 0; n < frames; n++) {
+		if (func && !func(time)) {
+			break;
+		}
+		// nothing presents, so let Dawn retire the submitted work here
+		wgpuDeviceTick(wgpu_device);
+		time += HEADLESS_TIMESTEP;
+	}
+}
+
+/**
+ * There is no input source, so constants are passed through unchanged.
+ */
+int RendererWindow::convertMouseButton(int button)
+{
+	return button;
+}
+
+/**
+ * There is no input source, so constants are passed through unchanged.
+ */
+int RendererWindow::convertMouseAction(int action)
+{
+	return action;
+}
+
+/**
+ * Stores the mouse click callback (never called without a window).
+ */
+void RendererWindow::mouseClicked(MouseHandler func)
+{
+	mouseClickHandlerClb = func;
+}
+
+/**
+ * Stores the key press callback (never called without a window).
+ */
+void RendererWindow::keyPressed(KeyHandler func)
+{
+	keyHandlerClb = func;
+}
+
+/**
+ * Stores the resize callback.
+ */
+void RendererWindow::resized(ResizeHandler func)
+{
+	resizeHandlerClb = func;
+}
@@ -1,4 +1,6 @@
 #include "RendererWindow.h"
+#include "TracingPlatform.h"
+#include "WireTransport.h"
 
 #if __has_include("d3d12.h") || (_MSC_VER >= 1900)
 #define DAWN_ENABLE_BACKEND_D3D12
@@ -9,6 +11,10 @@
 
 //****************************************************************************/
 
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+
 #include <dawn/dawn_proc.h>
 //#include <dawn/webgpu.h>
 //#include <dawn/webgpu_cpp.h>
@@ -23,6 +29,8 @@
 
 #pragma comment(lib, "dawn_native.dll.lib")
 #pragma comment(lib, "dawn_proc.dll.lib")
+#pragma comment(lib, "dawn_platform.dll.lib")
+#pragma comment(lib, "dawn_wire.dll.lib")
 #ifdef DAWN_ENABLE_BACKEND_VULKAN
 #pragma comment(lib, "vulkan-1.lib")
 #endif
@@ -31,10 +39,24 @@
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3native.h>
 
+/**
+ * Longest (in seconds) an on-demand loop sleeps before asking again whether a
+ * frame is needed (see \c #RendererWindow::onDemand()).
+ */
+#define ON_DEMAND_TIMEOUT 0.5
+
 // initialization of static members
 MouseHandler RendererWindow::mouseClickHandlerClb = NULLPTR;
 ResizeHandler RendererWindow::resizeHandlerClb = NULLPTR;
 KeyHandler RendererWindow::keyHandlerClb = NULLPTR;
+InputQueue* RendererWindow::inputQueue = NULLPTR;
+RedrawQuery RendererWindow::redrawQueryClb = NULLPTR;
+
+/**
+ * Bumped (and waited on by an idle render thread) whenever there may be a new
+ * frame to render.
+ */
+static std::atomic<unsigned> wakeups = 0;
 
 /*
  * Chosen backend type for \c #device.
@@ -67,11 +89,19 @@ static DawnSwapChainImplementation swapImpl;
 */
 static WGPUTextureFormat swapPref;
 
+/**
+ * Optional \c dawn_wire transport (see \c #createDevice()), moving the calls
+ * into Dawn onto a separate GPU thread.
+ */
+static std::unique_ptr<WireTransport> wire;
+
 /**
  * Analogous to the browser's \c GPU.requestAdapter().
  * \n
  * The returned \c Adapter is a wrapper around the underlying Dawn adapter (and
- * owned by the single Dawn instance).
+ * owned by the single Dawn instance). The instance has a \c TracingPlatform
+ * installed, so backend shader compilation results persist between launches
+ * (and Dawn's trace events can be collected).
  *
  * \todo we might be interested in whether the \c AdapterType is discrete or integrated for power-management reasons
  *
@@ -80,7 +110,9 @@ static WGPUTextureFormat swapPref;
  * \return the best choice adapter or an empty adapter wrapper
  */
 static dawn_native::Adapter requestAdapter(WGPUBackendType type1st, WGPUBackendType type2nd = WGPUBackendType_Null) {
+	static TracingPlatform platform;
 	static dawn_native::Instance instance;
+	instance.SetPlatform(&platform);
 	instance.DiscoverDefaultAdapters();
 	wgpu::AdapterProperties properties;
 	std::vector<dawn_native::Adapter> adapters = instance.GetAdapters();
@@ -218,7 +250,9 @@ Handle RendererWindow::create(unsigned /*winW*/, unsigned /*winH*/, const char*
 }
 
 /**
- * Obtaining a WebGPU device based on the available system's backend.
+ * Obtaining a WebGPU device based on the available system's backend. With
+ * \c RENDERER_WIRE set in the environment the returned device is a
+ * \c dawn_wire client, with a \c WireTransport calling Dawn on its own thread.
  */
 WGPUDevice RendererWindow::createDevice(Handle window, WGPUBackendType type) {
 	if (type > WGPUBackendType_OpenGLES) {
@@ -243,6 +277,15 @@ WGPUDevice RendererWindow::createDevice(Handle window, WGPUBackendType type) {
 		DawnProcTable procs(dawn_native::GetProcs());
 		procs.deviceSetUncapturedErrorCallback(wgpu_device, printError, nullptr);
 		dawnProcSetProcs(&procs);
+		if (const char* env = getenv("RENDERER_WIRE")) {
+			// a number sets the ring size (a small ring to exercise it filling)
+			size_t ringSize = (size_t) strtoul(env, NULLPTR, 10);
+			// from here on the renderer only sees the client device and procs
+			wire = std::make_unique<WireTransport>(wgpu_device, (ringSize) ? ringSize : WIRE_RING_SIZE);
+			wgpu_device = wire->getDevice();
+			dawnProcSetProcs(&wire->getProcs());
+			wire->getProcs().deviceSetUncapturedErrorCallback(wgpu_device, printError, nullptr);
+		}
 	}
 
 	if (wgpu_device == NULL) {
@@ -259,6 +302,7 @@ WGPUDevice RendererWindow::createDevice(Handle window, WGPUBackendType type) {
  */
 void RendererWindow::destroy(Handle /*wHnd*/) 
 {
+	wire.reset();
 	glfwDestroyWindow(_window);
 }
 
@@ -271,12 +315,119 @@ void RendererWindow::show(Handle /*wHnd*/, bool /*show*/)
 }
 
 /**
- * Main application/window loop.
+ * Adds an event to \c #inputQueue (from the GLFW callbacks, on the main
+ * thread).
+ */
+static void pushInput(InputQueue* queue, InputEvent::Type type, int button, int action, double x = 0.0, double y = 0.0) {
+	if (queue) {
+		queue->push({type, button, action, x, y});
+		wakeups.fetch_add(1, std::memory_order_release);
+		wakeups.notify_one();
+	}
+}
+
+/**
+ * Switches the GLFW callbacks over to filling the queue (replacing those set
+ * by \c #mouseClicked() and \c #keyPressed()).
+ */
+bool RendererWindow::threaded(InputQueue* queue)
+{
+	inputQueue = queue;
+
+	glfwSetMouseButtonCallback(_window, [](GLFWwindow* window, int button, int action, int /*mods*/) {
+		double xpos, ypos;
+		glfwGetCursorPos(window, &xpos, &ypos);
+		pushInput(inputQueue, InputEvent::MOUSE_BUTTON, convertMouseButton(button), convertMouseAction(action), xpos, ypos);
+	});
+	glfwSetCursorPosCallback(_window, [](GLFWwindow* /*window*/, double xpos, double ypos) {
+		pushInput(inputQueue, InputEvent::MOUSE_MOVE, 0, 0, xpos, ypos);
+	});
+	glfwSetScrollCallback(_window, [](GLFWwindow* /*window*/, double xoffset, double yoffset) {
+		pushInput(inputQueue, InputEvent::MOUSE_SCROLL, 0, 0, xoffset, yoffset);
+	});
+	glfwSetKeyCallback(_window, [](GLFWwindow* /*window*/, int key, int /*scancode*/, int action, int /*mods*/) {
+		pushInput(inputQueue, InputEvent::KEY, key, convertMouseAction(action));
+	});
+	glfwSetCharCallback(_window, [](GLFWwindow* /*window*/, unsigned int c) {
+		pushInput(inputQueue, InputEvent::CHAR, (int) c, 0);
+	});
+	glfwSetFramebufferSizeCallback(_window, [](GLFWwindow* /*window*/, int width, int height) {
+		pushInput(inputQueue, InputEvent::RESIZE, width, height);
+	});
+	return true;
+}
+
+/**
+ * Stores the on-demand query (asked on the render thread in threaded mode).
+ */
+void RendererWindow::onDemand(RedrawQuery func)
+{
+	redrawQueryClb = func;
+}
+
+/**
+ * Wakes both the render thread and the event loop.
+ */
+void RendererWindow::wake()
+{
+	wakeups.fetch_add(1, std::memory_order_release);
+	wakeups.notify_one();
+	glfwPostEmptyEvent();
+}
+
+/**
+ * Main application/window loop. In threaded mode (see \c #threaded()) the
+ * redraw function runs on a render thread, passed the time in seconds, while
+ * this thread only waits for window events. Rendering on demand (see
+ * \c #onDemand()) the render thread sleeps until input is queued or
+ * \c #wake() is called, otherwise the event loop itself waits for events.
  */
 void RendererWindow::loop(Handle /*wHnd*/, RenderFunc func)
 {
+	if (inputQueue) {
+		// report the starting size (changes then arrive as events)
+		int width, height;
+		glfwGetFramebufferSize(_window, &width, &height);
+		pushInput(inputQueue, InputEvent::RESIZE, width, height);
+
+		std::atomic<bool> running = true;
+		std::thread render([func, &running]() {
+			while (running.load(std::memory_order_acquire)) {
+				if (redrawQueryClb) {
+					// read before asking, so a wake-up in between isn't missed
+					unsigned seen = wakeups.load(std::memory_order_acquire);
+					if (!redrawQueryClb()) {
+						wakeups.wait(seen, std::memory_order_acquire);
+						continue;
+					}
+				}
+				if (!func || !func(glfwGetTime())) {
+					running.store(false, std::memory_order_release);
+					glfwPostEmptyEvent();
+				}
+			}
+		});
+		while (running.load(std::memory_order_acquire) && !glfwWindowShouldClose(_window)) {
+			glfwWaitEvents();
+		}
+		running.store(false, std::memory_order_release);
+		wake();
+		render.join();
+		return;
+	}
+
 	while (!glfwWindowShouldClose(_window)) {
-		glfwPollEvents();
+		if (redrawQueryClb && !redrawQueryClb()) {
+			// nothing to show, so sleep until an event arrives (rendering it,
+			// since not all input reaches the handlers) or the timeout passes
+			double start = glfwGetTime();
+			glfwWaitEventsTimeout(ON_DEMAND_TIMEOUT);
+			if (glfwGetTime() - start >= ON_DEMAND_TIMEOUT && !redrawQueryClb()) {
+				continue;
+			}
+		} else {
+			glfwPollEvents();
+		}
 
 		// React to changes in screen size
 		if (resizeHandlerClb != NULLPTR) {
@@ -331,11 +482,15 @@ int RendererWindow::convertMouseAction(int action)
 }
 
 /**
- * Binds mouse click inside the GLFW3 window to the Renderer mouse click handler.
+ * Binds mouse click inside the GLFW3 window to the Renderer mouse click handler
+ * (unless threaded, where clicks go to the input queue).
  */
 void RendererWindow::mouseClicked(MouseHandler func)
 {
 	mouseClickHandlerClb = func;
+	if (inputQueue) {
+		return;
+	}
 
 	glfwSetMouseButtonCallback(_window, [](GLFWwindow* window, int button, int action, int mods) {
 		if (mouseClickHandlerClb != NULLPTR) {
@@ -352,11 +507,15 @@ void RendererWindow::mouseClicked(MouseHandler func)
 }
 
 /**
- * Binds key press inside the GLFW3 window to the Renderer key press handler.
+ * Binds key press inside the GLFW3 window to the Renderer key press handler
+ * (unless threaded, where key presses go to the input queue).
  */
 void RendererWindow::keyPressed(KeyHandler func)
 {
 	keyHandlerClb = func;
+	if (inputQueue) {
+		return;
+	}
 
 	glfwSetKeyCallback(_window, [](GLFWwindow* window, int key, int scancode, int action, int mods) {
 		if (keyHandlerClb != NULLPTR) {			